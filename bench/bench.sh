@@ -0,0 +1,112 @@
+#!/usr/bin/env bash
+# Times ft_nm over a synthetic corpus, one JSON object per line on stdout and appended to
+# $BENCH_OUT so that runs of different commits can be compared.
+#
+# The phases are the ones reported by --stats when $FT_NM was built with `make STATS=1`,
+# otherwise they are estimated from the difference between runs.
+#
+# Environment:
+#   FT_NM          binary to time (./ft_nm)
+#   ELFGEN         corpus generator (bench/elfgen)
+#   BENCH_DIR      where the corpus is generated (bench/corpus)
+#   BENCH_OUT      results file (bench/results.jsonl)
+#   BENCH_SYMBOLS  symbols per object (100000)
+#   BENCH_SECTIONS sections per object (64)
+#   BENCH_RUNS     runs per measure, the minimum and median are kept (5)
+set -eu
+
+FT_NM=${FT_NM:-./ft_nm}
+ELFGEN=${ELFGEN:-bench/elfgen}
+BENCH_DIR=${BENCH_DIR:-bench/corpus}
+BENCH_OUT=${BENCH_OUT:-bench/results.jsonl}
+BENCH_SYMBOLS=${BENCH_SYMBOLS:-100000}
+BENCH_SECTIONS=${BENCH_SECTIONS:-64}
+BENCH_RUNS=${BENCH_RUNS:-5}
+
+FLAGS=("" "-n" "-p" "-r" "-S --size-sort" "-g" "-u" "-a -P")
+
+commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+date=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+mkdir -p "$BENCH_DIR"
+
+# Prints the minimum and median wall time in microseconds of `ft_nm $@`.
+measure() {
+  local times=() start end
+  for ((i = 0; i < BENCH_RUNS; i++)); do
+    start=${EPOCHREALTIME/./}
+    "$FT_NM" "$@" >/dev/null 2>&1 || true
+    end=${EPOCHREALTIME/./}
+    times+=($((end - start)))
+  done
+  mapfile -t times < <(printf '%s\n' "${times[@]}" | sort -n)
+  echo "${times[0]} ${times[$((BENCH_RUNS / 2))]}"
+}
+
+# Prints the median of each phase reported by `ft_nm --stats $@` (a `make STATS=1` build),
+# as `name:us` words.
+measure_stats() {
+  local runs=()
+  for ((i = 0; i < BENCH_RUNS; i++)); do
+    runs+=("$("$FT_NM" --stats "$@" 2>&1 >/dev/null | grep '^nm: stats:' | tail -n 1)")
+  done
+  for phase in open symtab sort display; do
+    local values
+    mapfile -t values < <(printf '%s\n' "${runs[@]}" |
+      sed -n "s/.* ${phase}_us=\([0-9]*\).*/\1/p" | sort -n)
+    echo "$phase:${values[$((BENCH_RUNS / 2))]}"
+  done
+}
+
+emit() {
+  echo "$1"
+  echo "$1" >>"$BENCH_OUT"
+}
+
+for class in 64 32; do
+  for endian in le be; do
+    for type in rel dyn; do
+      for names in uniform cxx; do
+        file="$BENCH_DIR/${class}${endian}-${type}-${names}-${BENCH_SYMBOLS}.o"
+        gen=(--class="$class" --endian="$endian" --type="$type" --names="$names"
+          --symbols="$BENCH_SYMBOLS" --sections="$BENCH_SECTIONS" --output="$file")
+        [ "$type" = dyn ] && gen+=(--versions)
+        [ -f "$file" ] || "$ELFGEN" "${gen[@]}"
+        # Exact phase timings when the binary is instrumented.
+        if [ -z "${stats+set}" ]; then
+          stats=$("$FT_NM" --stats "$file" 2>&1 >/dev/null | grep -m 1 '^nm: stats:' || true)
+        fi
+
+        dynamic=()
+        [ "$type" = dyn ] && dynamic=(-D)
+        meta="\"commit\":\"$commit\",\"date\":\"$date\",\"file\":\"$(basename "$file")\""
+        meta+=",\"class\":$class,\"endian\":\"$endian\",\"type\":\"$type\""
+        meta+=",\"names\":\"$names\",\"symbols\":$BENCH_SYMBOLS"
+
+        declare -A median=()
+        for flags in "${FLAGS[@]}"; do
+          # shellcheck disable=SC2086
+          read -r min med < <(measure "${dynamic[@]}" $flags "$file")
+          median[${flags:-none}]=$med
+          emit "{\"kind\":\"run\",$meta,\"flags\":\"$flags\",\"min_us\":$min,\"median_us\":$med}"
+        done
+
+        if [ -n "$stats" ]; then
+          mapfile -t phases < <(measure_stats "${dynamic[@]}" "$file")
+        else
+          # Phases by difference: a pattern that matches nothing stops every symbol
+          # right after its name is decoded, -p skips the sort.
+          read -r _ decode < <(measure "${dynamic[@]}" --match=$'\x01' "$file")
+          phases=(
+            "map+decode:$decode"
+            "classify+output:$((median[-p] - decode))"
+            "sort:$((median[none] - median[-p]))"
+          )
+        fi
+        for phase in "${phases[@]}"; do
+          emit "{\"kind\":\"phase\",$meta,\"phase\":\"${phase%%:*}\",\"median_us\":${phase#*:}}"
+        done
+        unset median
+      done
+    done
+  done
+done
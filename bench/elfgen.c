@@ -0,0 +1,552 @@
+#include <elf.h>
+#include <nm/opt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Synthetic ELF objects for the benchmarks: a relocatable object with a .symtab, or a
+// shared object with a versioned .dynsym. The output only depends on the options.
+
+typedef enum {
+  NAMES_FIXED,    // Every name is `name_max` long
+  NAMES_UNIFORM,  // Lengths uniformly distributed in [name_min, name_max]
+  NAMES_CXX,      // Mangled-like names sharing long prefixes, the worst case of the sort
+} names_t;
+
+typedef struct {
+  bool is64;
+  bool big;
+  bool dyn;
+  bool versions;
+  size_t symbols;
+  size_t sections;
+  size_t name_min;
+  size_t name_max;
+  names_t names;
+  uint64_t seed;
+  const char* output;
+} gen_opts_t;
+
+typedef struct {
+  uint8_t* data;
+  size_t len;
+  size_t cap;
+  bool big;
+} buf_t;
+
+static uint64_t g_rng;
+
+static uint64_t rnd() {
+  // xorshift64*
+  g_rng ^= g_rng >> 12;
+  g_rng ^= g_rng << 25;
+  g_rng ^= g_rng >> 27;
+  return g_rng * 0x2545F4914F6CDD1Dull;
+}
+
+static size_t rnd_range(const size_t lo, const size_t hi) {
+  return lo + (size_t)(rnd() % (hi - lo + 1));
+}
+
+static void reserve(buf_t* b, const size_t n) {
+  if (b->len + n <= b->cap)
+    return;
+  while (b->len + n > b->cap)
+    b->cap = b->cap ? b->cap * 2 : 4096;
+  if ((b->data = realloc(b->data, b->cap)) == nullptr) {
+    perror("elfgen");
+    exit(1);
+  }
+}
+
+static void put(buf_t* b, const uint64_t v, const size_t size) {
+  reserve(b, size);
+  for (size_t i = 0; i < size; i++) {
+    const auto shift = b->big ? (size - i - 1) * 8 : i * 8;
+    b->data[b->len++] = (uint8_t)(v >> shift);
+  }
+}
+
+static void put_bytes(buf_t* b, const void* data, const size_t len) {
+  reserve(b, len);
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+}
+
+static void align(buf_t* b, const size_t to) {
+  while (b->len % to)
+    put(b, 0, 1);
+}
+
+// Appends a NUL terminated string to a string table, returns its offset.
+static uint32_t put_str(buf_t* strtab, const char* s) {
+  const auto off = (uint32_t)strtab->len;
+  put_bytes(strtab, s, strlen(s) + 1);
+  return off;
+}
+
+static void make_name(const gen_opts_t* o, const size_t index, char* out) {
+  static const char* words[] = {"alloc", "buffer", "detail", "impl",  "node",
+                                "parse", "stream", "vector", "writer", "map"};
+  constexpr size_t nwords = sizeof(words) / sizeof(*words);
+  char suffix[24];
+  const auto slen = (size_t)snprintf(suffix, sizeof(suffix), "_%zx", index);
+
+  auto len = (o->names == NAMES_FIXED) ? o->name_max : rnd_range(o->name_min, o->name_max);
+  if (len < slen + 1)
+    len = slen + 1;
+
+  size_t n = 0;
+  if (o->names == NAMES_CXX) {
+    // A handful of namespaces shared by most symbols.
+    const char* prefix = "_ZN3app";
+    for (; n + slen < len && prefix[n]; n++)
+      out[n] = prefix[n];
+    while (n + slen < len) {
+      const auto w = words[rnd() % (index % 7 == 0 ? nwords : 3)];
+      char piece[16];
+      const auto plen = (size_t)snprintf(piece, sizeof(piece), "%zu%s", strlen(w), w);
+      for (size_t i = 0; i < plen && n + slen < len; i++)
+        out[n++] = piece[i];
+    }
+  } else {
+    for (; n + slen < len; n++)
+      out[n] = "abcdefghijklmnopqrstuvwxyz_"[rnd() % 27];
+  }
+  memcpy(out + n, suffix, slen + 1);
+}
+
+// Section kinds of the user sections, in rotation.
+static const struct {
+  const char* prefix;
+  uint32_t type;
+  uint64_t flags;
+} g_kinds[] = {
+    {".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR},
+    {".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE},
+    {".rodata", SHT_PROGBITS, SHF_ALLOC},
+    {".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE},
+};
+
+typedef struct {
+  uint32_t name;
+  uint32_t type;
+  uint64_t flags;
+  uint64_t addr;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t link;
+  uint32_t info;
+  uint64_t align;
+  uint64_t entsize;
+} shdr_t;
+
+enum { SECTION_DATA = 64 };
+
+static void put_sym(buf_t* b,
+                    const bool is64,
+                    const uint32_t name,
+                    const uint8_t info,
+                    const uint16_t shndx,
+                    const uint64_t value,
+                    const uint64_t size) {
+  put(b, name, 4);
+  if (is64) {
+    put(b, info, 1);
+    put(b, STV_DEFAULT, 1);
+    put(b, shndx, 2);
+    put(b, value, 8);
+    put(b, size, 8);
+  } else {
+    put(b, value, 4);
+    put(b, size, 4);
+    put(b, info, 1);
+    put(b, STV_DEFAULT, 1);
+    put(b, shndx, 2);
+  }
+}
+
+static void put_shdr(buf_t* b, const bool is64, const shdr_t* h) {
+  const size_t word = is64 ? 8 : 4;
+  put(b, h->name, 4);
+  put(b, h->type, 4);
+  put(b, h->flags, word);
+  put(b, h->addr, word);
+  put(b, h->offset, word);
+  put(b, h->size, word);
+  put(b, h->link, 4);
+  put(b, h->info, 4);
+  put(b, h->align, word);
+  put(b, h->entsize, word);
+}
+
+static bool generate(const gen_opts_t* o, buf_t* out) {
+  const auto is64 = o->is64;
+  const size_t word = is64 ? 8 : 4;
+  const size_t ehsize = is64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr);
+  const size_t symsize = is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+  const size_t shsize = is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+
+  buf_t shstr = {.big = o->big};
+  buf_t str = {.big = o->big};
+  buf_t syms = {.big = o->big};
+  buf_t versym = {.big = o->big};
+  buf_t body = {.big = o->big};
+  char* name = malloc(o->name_max + 32);
+  shdr_t* shdrs = calloc(o->sections + 8, sizeof(shdr_t));
+  if (!name || !shdrs)
+    return false;
+
+  put(&shstr, 0, 1);
+  put(&str, 0, 1);
+  size_t nshdrs = 1;
+
+  // User sections, their data directly follows the ELF header.
+  body.len = ehsize;
+  reserve(&body, 0);
+  memset(body.data, 0, ehsize);
+  uint64_t addr = 0x1000;
+  for (size_t i = 0; i < o->sections; i++) {
+    const auto kind = &g_kinds[i % (sizeof(g_kinds) / sizeof(*g_kinds))];
+    char sname[32];
+    snprintf(sname, sizeof(sname), "%s.%zu", kind->prefix, i);
+
+    align(&body, 16);
+    shdrs[nshdrs++] = (shdr_t){
+        .name = put_str(&shstr, sname),
+        .type = kind->type,
+        .flags = kind->flags,
+        .addr = o->dyn ? addr : 0,
+        .offset = body.len,
+        .size = SECTION_DATA,
+        .align = 16,
+    };
+    if (kind->type != SHT_NOBITS) {
+      for (size_t j = 0; j < SECTION_DATA; j++)
+        put(&body, rnd(), 1);
+    }
+    addr += 0x1000;
+  }
+
+  // Locals first, then globals with a few weak and undefined symbols. Like a compiler,
+  // relocatable objects start with the source file and the section symbols.
+  const auto nlocal = o->symbols / 10;
+  put_sym(&syms, is64, 0, 0, SHN_UNDEF, 0, 0);
+  if (o->versions)
+    put(&versym, 0, 2);
+  if (!o->dyn) {
+    put_sym(&syms, is64, put_str(&str, "synth.c"), ELF64_ST_INFO(STB_LOCAL, STT_FILE),
+            SHN_ABS, 0, 0);
+    for (size_t i = 1; i <= o->sections; i++)
+      put_sym(&syms, is64, 0, ELF64_ST_INFO(STB_LOCAL, STT_SECTION), (uint16_t)i, 0, 0);
+  }
+  for (size_t i = 0; i < o->symbols; i++) {
+    make_name(o, i, name);
+
+    const auto roll = rnd() % 100;
+    const auto undefined = i >= nlocal && roll < 10;
+    const uint8_t bind = i < nlocal ? STB_LOCAL : (roll < 15 ? STB_WEAK : STB_GLOBAL);
+    const auto section = o->sections ? 1 + rnd() % o->sections : 0;
+    const auto kind = section ? &g_kinds[(section - 1) % 4] : nullptr;
+    const uint8_t type = (kind && (kind->flags & SHF_EXECINSTR)) ? STT_FUNC : STT_OBJECT;
+    // A few absolute globals with a size, as assembler or linker scripts define them.
+    const auto absolute = i >= nlocal && roll >= 97;
+    const uint16_t shndx = (undefined || !section) ? SHN_UNDEF
+                           : absolute              ? SHN_ABS
+                                                   : (uint16_t)section;
+    const auto base = (o->dyn && shndx && !absolute) ? shdrs[section].addr : 0;
+    const auto value = shndx ? base + rnd() % SECTION_DATA : 0;
+
+    put_sym(&syms, is64, put_str(&str, name), (uint8_t)ELF64_ST_INFO(bind, type), shndx,
+            value, shndx ? rnd() % 256 : 0);
+    if (!o->versions)
+      continue;
+
+    // Defined symbols use one of the two definitions, undefined ones the needed versions.
+    uint16_t version = (bind == STB_LOCAL) ? VER_NDX_LOCAL : (uint16_t)(2 + rnd() % 2);
+    if (undefined)
+      version = (uint16_t)(4 + rnd() % 2);
+    else if (version == 2 && rnd() % 4 == 0)
+      version |= 0x8000;
+    put(&versym, version, 2);
+  }
+
+  const auto symtab_index = (uint32_t)nshdrs++;
+  // Filled last so that the version names are in it.
+  const auto strtab_index = (uint32_t)nshdrs++;
+
+  align(&body, word);
+  shdrs[symtab_index] = (shdr_t){
+      .name = put_str(&shstr, o->dyn ? ".dynsym" : ".symtab"),
+      .type = o->dyn ? SHT_DYNSYM : SHT_SYMTAB,
+      .flags = o->dyn ? SHF_ALLOC : 0,
+      .offset = body.len,
+      .size = syms.len,
+      .link = strtab_index,
+      .info = (uint32_t)(nlocal + 1 + (o->dyn ? 0 : 1 + o->sections)),
+      .align = word,
+      .entsize = symsize,
+  };
+  put_bytes(&body, syms.data, syms.len);
+
+  if (o->versions) {
+    // Definitions: the base (file) version then LIB_1.0 and LIB_2.0.
+    // Needed: GLIBC_2.2.5 and GLIBC_2.34 from libc.so.6.
+    const char* defs[] = {"libsynth.so", "LIB_1.0", "LIB_2.0"};
+    const char* needs[] = {"GLIBC_2.2.5", "GLIBC_2.34"};
+    buf_t vd = {.big = o->big};
+    buf_t vn = {.big = o->big};
+
+    for (size_t i = 0; i < 3; i++) {
+      put(&vd, VER_DEF_CURRENT, 2);
+      put(&vd, i == 0 ? VER_FLG_BASE : 0, 2);
+      put(&vd, i + 1, 2);
+      put(&vd, 1, 2);
+      put(&vd, 0, 4);
+      put(&vd, sizeof(Elf64_Verdef), 4);
+      put(&vd, i == 2 ? 0 : sizeof(Elf64_Verdef) + sizeof(Elf64_Verdaux), 4);
+      put(&vd, put_str(&str, defs[i]), 4);
+      put(&vd, 0, 4);
+    }
+
+    put(&vn, VER_NEED_CURRENT, 2);
+    put(&vn, 2, 2);
+    put(&vn, put_str(&str, "libc.so.6"), 4);
+    put(&vn, sizeof(Elf64_Verneed), 4);
+    put(&vn, 0, 4);
+    for (size_t i = 0; i < 2; i++) {
+      put(&vn, 0, 4);
+      put(&vn, 0, 2);
+      put(&vn, 4 + i, 2);
+      put(&vn, put_str(&str, needs[i]), 4);
+      put(&vn, i == 1 ? 0 : sizeof(Elf64_Vernaux), 4);
+    }
+
+    align(&body, 2);
+    shdrs[nshdrs++] = (shdr_t){
+        .name = put_str(&shstr, ".gnu.version"),
+        .type = SHT_GNU_versym,
+        .flags = SHF_ALLOC,
+        .offset = body.len,
+        .size = versym.len,
+        .link = symtab_index,
+        .align = 2,
+        .entsize = 2,
+    };
+    put_bytes(&body, versym.data, versym.len);
+
+    align(&body, word);
+    shdrs[nshdrs++] = (shdr_t){
+        .name = put_str(&shstr, ".gnu.version_d"),
+        .type = SHT_GNU_verdef,
+        .flags = SHF_ALLOC,
+        .offset = body.len,
+        .size = vd.len,
+        .link = strtab_index,
+        .info = 3,
+        .align = word,
+    };
+    put_bytes(&body, vd.data, vd.len);
+
+    align(&body, word);
+    shdrs[nshdrs++] = (shdr_t){
+        .name = put_str(&shstr, ".gnu.version_r"),
+        .type = SHT_GNU_verneed,
+        .flags = SHF_ALLOC,
+        .offset = body.len,
+        .size = vn.len,
+        .link = strtab_index,
+        .info = 1,
+        .align = word,
+    };
+    put_bytes(&body, vn.data, vn.len);
+
+    free(vd.data);
+    free(vn.data);
+  }
+
+  const auto shstrtab_index = (uint32_t)nshdrs++;
+  shdrs[strtab_index] = (shdr_t){
+      .name = put_str(&shstr, o->dyn ? ".dynstr" : ".strtab"),
+      .type = SHT_STRTAB,
+      .flags = o->dyn ? SHF_ALLOC : 0,
+      .offset = body.len,
+      .size = str.len,
+      .align = 1,
+  };
+  put_bytes(&body, str.data, str.len);
+
+  const auto shstr_name = put_str(&shstr, ".shstrtab");
+  shdrs[shstrtab_index] = (shdr_t){
+      .name = shstr_name,
+      .type = SHT_STRTAB,
+      .offset = body.len,
+      .size = shstr.len,
+      .align = 1,
+  };
+  put_bytes(&body, shstr.data, shstr.len);
+
+  align(&body, word);
+  const auto shoff = body.len;
+  for (size_t i = 0; i < nshdrs; i++)
+    put_shdr(&body, is64, &shdrs[i]);
+
+  // Now that everything is placed, the ELF header.
+  buf_t ehdr = {.big = o->big};
+  const uint8_t ident[EI_NIDENT] = {
+      ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, is64 ? ELFCLASS64 : ELFCLASS32,
+      o->big ? ELFDATA2MSB : ELFDATA2LSB, EV_CURRENT,
+  };
+  put_bytes(&ehdr, ident, sizeof(ident));
+  put(&ehdr, o->dyn ? ET_DYN : ET_REL, 2);
+  put(&ehdr, is64 ? (o->big ? EM_PPC64 : EM_X86_64) : (o->big ? EM_PPC : EM_386), 2);
+  put(&ehdr, EV_CURRENT, 4);
+  put(&ehdr, 0, word);
+  put(&ehdr, 0, word);
+  put(&ehdr, shoff, word);
+  put(&ehdr, 0, 4);
+  put(&ehdr, ehsize, 2);
+  put(&ehdr, 0, 2);
+  put(&ehdr, 0, 2);
+  put(&ehdr, shsize, 2);
+  put(&ehdr, nshdrs, 2);
+  put(&ehdr, shstrtab_index, 2);
+  memcpy(body.data, ehdr.data, ehdr.len);
+
+  *out = body;
+  free(ehdr.data);
+  free(shstr.data);
+  free(str.data);
+  free(syms.data);
+  free(versym.data);
+  free(shdrs);
+  free(name);
+  return true;
+}
+
+enum {
+  OPT_CLASS = 256,
+  OPT_ENDIAN,
+  OPT_TYPE,
+  OPT_SYMBOLS,
+  OPT_SECTIONS,
+  OPT_NAME_LEN,
+  OPT_NAMES,
+  OPT_VERSIONS,
+  OPT_SEED,
+  OPT_OUTPUT,
+};
+
+static const opt_long_t g_long_opts[] = {
+    {.name = "class", .val = OPT_CLASS, .has_arg = true},
+    {.name = "endian", .val = OPT_ENDIAN, .has_arg = true},
+    {.name = "type", .val = OPT_TYPE, .has_arg = true},
+    {.name = "symbols", .val = OPT_SYMBOLS, .has_arg = true},
+    {.name = "sections", .val = OPT_SECTIONS, .has_arg = true},
+    {.name = "name-len", .val = OPT_NAME_LEN, .has_arg = true},
+    {.name = "names", .val = OPT_NAMES, .has_arg = true},
+    {.name = "versions", .val = OPT_VERSIONS},
+    {.name = "seed", .val = OPT_SEED, .has_arg = true},
+    {.name = "output", .val = OPT_OUTPUT, .has_arg = true},
+    {},
+};
+
+static void usage() {
+  fputs(
+      "Usage: elfgen --output=FILE [options]\n"
+      "  --class=32|64        ELF class (64)\n"
+      "  --endian=le|be       Byte order (le)\n"
+      "  --type=rel|dyn       Relocatable object with .symtab or shared object with\n"
+      "                       .dynsym (rel)\n"
+      "  --symbols=N          Number of symbols (10000)\n"
+      "  --sections=N         Number of sections holding them (16)\n"
+      "  --name-len=MIN:MAX   Symbol name length range (8:32)\n"
+      "  --names=D            Name distribution: fixed, uniform or cxx (uniform)\n"
+      "  --versions           Add version tables (dyn only)\n"
+      "  --seed=N             Random seed (1)\n",
+      stderr);
+}
+
+int main(int argc, char** argv) {
+  gen_opts_t o = {
+      .is64 = true,
+      .symbols = 10000,
+      .sections = 16,
+      .name_min = 8,
+      .name_max = 32,
+      .names = NAMES_UNIFORM,
+      .seed = 1,
+  };
+
+  auto opt = nm_opt("", g_long_opts);
+  int flag;
+  while ((flag = opt_next(&opt, argc, argv)) != OPT_END) {
+    switch (flag) {
+      case OPT_CLASS:
+        o.is64 = strcmp(opt.arg, "32") != 0;
+        break;
+      case OPT_ENDIAN:
+        o.big = strcmp(opt.arg, "be") == 0;
+        break;
+      case OPT_TYPE:
+        o.dyn = strcmp(opt.arg, "dyn") == 0;
+        break;
+      case OPT_SYMBOLS:
+        o.symbols = strtoull(opt.arg, nullptr, 10);
+        break;
+      case OPT_SECTIONS:
+        o.sections = strtoull(opt.arg, nullptr, 10);
+        break;
+      case OPT_NAME_LEN:
+        if (sscanf(opt.arg, "%zu:%zu", &o.name_min, &o.name_max) != 2 ||
+            o.name_min > o.name_max) {
+          usage();
+          return 1;
+        }
+        break;
+      case OPT_NAMES:
+        if (strcmp(opt.arg, "fixed") == 0)
+          o.names = NAMES_FIXED;
+        else if (strcmp(opt.arg, "cxx") == 0)
+          o.names = NAMES_CXX;
+        else
+          o.names = NAMES_UNIFORM;
+        break;
+      case OPT_VERSIONS:
+        o.versions = true;
+        break;
+      case OPT_SEED:
+        o.seed = strtoull(opt.arg, nullptr, 10);
+        break;
+      case OPT_OUTPUT:
+        o.output = opt.arg;
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  // Section indices are 16 bits and there is no extended numbering here.
+  if (!o.output || o.sections > 0xfe00) {
+    usage();
+    return 1;
+  }
+  o.versions = o.versions && o.dyn;
+  g_rng = o.seed ? o.seed : 1;
+
+  buf_t elf;
+  if (!generate(&o, &elf)) {
+    perror("elfgen");
+    return 1;
+  }
+
+  FILE* f = fopen(o.output, "wb");
+  if (!f || fwrite(elf.data, 1, elf.len, f) != elf.len || fclose(f) != 0) {
+    perror(o.output);
+    return 1;
+  }
+  free(elf.data);
+  return 0;
+}
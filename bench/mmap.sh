@@ -0,0 +1,96 @@
+#!/usr/bin/env bash
+# Compares the --mmap hints on a large synthetic object, cold and warm page cache. One
+# JSON object per line on stdout and appended to $BENCH_OUT, with the time to the first
+# symbol (first line read from the output pipe), the total time and, when $FT_NM was built
+# with `make STATS=1`, the page faults of the run.
+#
+# The cache is made cold by dropping the pages of the object (`dd iflag=nocache`), which
+# needs no privilege but is only honoured for pages nobody else maps.
+#
+# Environment:
+#   FT_NM         binary to time (./ft_nm)
+#   ELFGEN        corpus generator (bench/elfgen)
+#   BENCH_DIR     where the object is generated (bench/corpus)
+#   BENCH_OUT     results file (bench/results.jsonl)
+#   MMAP_SYMBOLS  symbols of the object (2000000)
+#   MMAP_FLAGS    ft_nm flags of the listing ("")
+#   BENCH_RUNS    runs per measure, the median is kept (5)
+set -eu
+
+FT_NM=${FT_NM:-./ft_nm}
+ELFGEN=${ELFGEN:-bench/elfgen}
+BENCH_DIR=${BENCH_DIR:-bench/corpus}
+BENCH_OUT=${BENCH_OUT:-bench/results.jsonl}
+MMAP_SYMBOLS=${MMAP_SYMBOLS:-2000000}
+MMAP_FLAGS=${MMAP_FLAGS:-}
+BENCH_RUNS=${BENCH_RUNS:-5}
+
+HINTS=("" populate willneed hugepage "willneed,hugepage")
+
+commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+date=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+mkdir -p "$BENCH_DIR"
+
+file="$BENCH_DIR/64le-rel-uniform-$MMAP_SYMBOLS.o"
+[ -f "$file" ] || "$ELFGEN" --symbols="$MMAP_SYMBOLS" --sections=64 --output="$file"
+
+stats=()
+if "$FT_NM" --stats "$file" 2>&1 >/dev/null | grep -q '^nm: stats:'; then
+  stats=(--stats)
+fi
+log=$(mktemp)
+trap 'rm -f "$log"' EXIT
+
+# Prints `first_us total_us minflt majflt` for one run of `ft_nm $@`, the faults are
+# `null` without --stats.
+run() {
+  local start first end
+  start=${EPOCHREALTIME/./}
+  {
+    IFS= read -r _ || true
+    first=${EPOCHREALTIME/./}
+    cat >/dev/null
+  } < <("$FT_NM" "${stats[@]}" "$@" 2>"$log")
+  end=${EPOCHREALTIME/./}
+
+  local minflt majflt
+  minflt=$(sed -n 's/^nm: stats:.* minflt=\([0-9]*\).*/\1/p' "$log")
+  majflt=$(sed -n 's/^nm: stats:.* majflt=\([0-9]*\).*/\1/p' "$log")
+  echo "$((first - start)) $((end - start)) ${minflt:-null} ${majflt:-null}"
+}
+
+# Prints the median of each column over the runs.
+median() {
+  local column values
+  for column in 1 2 3 4; do
+    mapfile -t values < <(cut -d ' ' -f "$column" <<<"$1" | sort -n)
+    printf '%s ' "${values[$((${#values[@]} / 2))]}"
+  done
+  echo
+}
+
+for cache in warm cold; do
+  for hint in "${HINTS[@]}"; do
+    args=()
+    [ -n "$hint" ] && args+=(--mmap="$hint")
+    # shellcheck disable=SC2206
+    args+=($MMAP_FLAGS "$file")
+
+    # A first run to warm the cache up.
+    [ "$cache" = warm ] && run "${args[@]}" >/dev/null
+    runs=""
+    for ((i = 0; i < BENCH_RUNS; i++)); do
+      [ "$cache" = cold ] && dd if="$file" iflag=nocache count=0 status=none
+      runs+="$(run "${args[@]}")"$'\n'
+    done
+    read -r first total minflt majflt < <(median "${runs%$'\n'}")
+
+    line="{\"kind\":\"mmap\",\"commit\":\"$commit\",\"date\":\"$date\""
+    line+=",\"file\":\"$(basename "$file")\",\"symbols\":$MMAP_SYMBOLS"
+    line+=",\"flags\":\"$MMAP_FLAGS\",\"hint\":\"${hint:-none}\",\"cache\":\"$cache\""
+    line+=",\"first_symbol_us\":$first,\"median_us\":$total"
+    line+=",\"minflt\":$minflt,\"majflt\":$majflt}"
+    echo "$line"
+    echo "$line" >>"$BENCH_OUT"
+  done
+done
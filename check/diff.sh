@@ -0,0 +1,225 @@
+#!/usr/bin/env bash
+# Differential check against binutils nm: every object of the corpus is listed by both
+# with every combination of the supported flags, the standard outputs have to be
+# byte-identical and the exit statuses equal. Diagnostics on stderr are not compared, the
+# README doesn't promise them.
+#
+# The corpus is made of system objects (relocatable objects, shared libraries and
+# executables), the crt*.o startup files, an object compiled with -g, and synthetic ones
+# from bench/elfgen covering both classes, both endians, .symtab and versioned .dynsym.
+#
+# Each ft_nm binary of $FT_NM (e.g. a default and an `OPT=1` build) is checked in two
+# modes: a plain listing, and --limit which must print the head of nm's listing. The
+# whole corpus is then listed in a single invocation, with and without --dedup, which
+# goes through the read ahead of the files.
+#
+# -l only reads .debug_line: nm also locates the data symbols through .debug_info and the
+# undefined ones through the relocations, so only the locations of code are compared.
+#
+# Environment:
+#   FT_NM        space separated ft_nm binaries to check (./ft_nm)
+#   NM           reference nm (nm)
+#   ELFGEN       corpus generator (bench/elfgen)
+#   CHECK_DIR    where the synthetic corpus is generated (check/corpus)
+#   CHECK_FILES  space separated objects replacing the system ones
+#   CHECK_SYSTEM number of system objects sampled (40)
+#   CHECK_JOBS   parallel jobs (nproc)
+#   CHECK_LIMIT  symbols kept in the --limit mode (25)
+#   CXX          compiler of the -g object, skipped if missing (c++)
+set -eu
+
+FT_NM=${FT_NM:-./ft_nm}
+NM=${NM:-nm}
+ELFGEN=${ELFGEN:-bench/elfgen}
+CHECK_DIR=${CHECK_DIR:-check/corpus}
+CHECK_SYSTEM=${CHECK_SYSTEM:-40}
+CHECK_JOBS=${CHECK_JOBS:-$(nproc)}
+CHECK_LIMIT=${CHECK_LIMIT:-25}
+CXX=${CXX:-c++}
+export FT_NM NM CHECK_LIMIT LC_ALL=C
+
+# Prints the flag combinations, one per line.
+flag_sets() {
+  for dynamic in "" -D; do
+    for sort in "" -n -p --size-sort; do
+      for reverse in "" -r; do
+        for filter in "" -a -g -u; do
+          for output in "" -S -P "-P -S"; do
+            # Not echo, it would take -n for its own flag.
+            # shellcheck disable=SC2086
+            set -- $dynamic $sort $reverse $filter $output
+            printf '%s\n' "$*"
+          done
+        done
+      done
+    done
+  done
+
+  # The other outputs, with fewer combinations.
+  for output in -C -l --format=sysv "-C --format=sysv" "-C -l"; do
+    for dynamic in "" -D; do
+      for sort in "" -n -p --size-sort; do
+        for filter in "" -a -u; do
+          # shellcheck disable=SC2086
+          set -- $dynamic $sort $filter $output
+          printf '%s\n' "$*"
+        done
+      done
+    done
+  done
+}
+
+# Drops the -l location of the lines that are not code symbols (see above).
+code_locations() {
+  sed -E 's/^([0-9a-f]{8}|[0-9a-f]{16}| {8}| {16}) ([^TtWi]) ([^\t]*)\t.*/\1 \2 \3/'
+}
+
+# Runs `$@`, prints its standard output followed by its exit status.
+run() {
+  local status=0
+  "$@" 2>/dev/null || status=$?
+  echo "exit $status"
+}
+
+# Checks one object, prints a `DIFF` line followed by the start of the diff for each
+# divergence.
+check_one() {
+  local file=$1 expected actual filter head
+  # The flag sets come on their own descriptor, nothing in the loop can consume them.
+  while read -r -u 3 flags; do
+    filter=cat
+    case " $flags " in *" -l "*) filter=code_locations ;; esac
+    # --limit counts symbols, the SysV table starts with 6 lines of header.
+    head=$CHECK_LIMIT
+    case " $flags " in *" --format=sysv "*) head=$((CHECK_LIMIT + 6)) ;; esac
+
+    # shellcheck disable=SC2086
+    expected=$(run "$NM" $flags "$file" | $filter)
+    for bin in $FT_NM; do
+      # shellcheck disable=SC2086
+      actual=$(run "$bin" $flags "$file" | $filter)
+      if [ "$expected" != "$actual" ]; then
+        echo "DIFF $bin [$flags] $file"
+        diff <(echo "$expected") <(echo "$actual") | head -n 6 | sed 's/^/  /'
+      fi
+
+      # The head of the listing, and the same status.
+      # shellcheck disable=SC2086
+      actual=$(run "$bin" --limit="$CHECK_LIMIT" $flags "$file" | $filter)
+      if [ "$(echo "$expected" | head -n -1 | head -n "$head")" != \
+        "$(echo "$actual" | head -n -1)" ] ||
+        [ "$(echo "$expected" | tail -n 1)" != "$(echo "$actual" | tail -n 1)" ]; then
+        echo "DIFF $bin [--limit=$CHECK_LIMIT $flags] $file"
+      fi
+    done
+  done 3< <(flag_sets) </dev/null
+}
+
+# Lists all the objects at once, each of them twice so that --dedup replays them.
+check_many() {
+  local expected actual
+  for flags in "" -D "-S --size-sort" -P --format=sysv; do
+    # shellcheck disable=SC2086
+    expected=$(run "$NM" $flags "$@" "$@")
+    for bin in $FT_NM; do
+      for mode in "" --dedup; do
+        # shellcheck disable=SC2086
+        actual=$(run "$bin" $mode $flags "$@" "$@")
+        if [ "$expected" != "$actual" ]; then
+          echo "DIFF $bin [${mode:+$mode }$flags] all the objects"
+          diff <(echo "$expected") <(echo "$actual") | head -n 6 | sed 's/^/  /'
+        fi
+      done
+    done
+  done
+}
+
+if [ "${1:-}" = --one ]; then
+  check_one "$2"
+  exit 0
+fi
+
+is_elf() {
+  [ "$(head -c 4 "$1" 2>/dev/null | od -An -c | tr -d ' ')" = '177ELF' ]
+}
+
+files=()
+if [ -n "${CHECK_FILES:-}" ]; then
+  read -r -a files <<<"$CHECK_FILES"
+else
+  # A deterministic sample, spread over the sorted candidates.
+  mapfile -t candidates < <(find /usr/lib /usr/bin -maxdepth 3 -type f \
+    \( -name '*.o' -o -name '*.so*' -o -perm -u+x \) 2>/dev/null | sort)
+  elves=()
+  for f in "${candidates[@]}"; do
+    is_elf "$f" && elves+=("$f")
+  done
+  step=$(((${#elves[@]} + CHECK_SYSTEM - 1) / CHECK_SYSTEM))
+  for ((i = 0; i < ${#elves[@]}; i += step > 0 ? step : 1)); do
+    files+=("${elves[$i]}")
+  done
+fi
+
+# The startup files, with their section, file and absolute symbols.
+mapfile -t crt < <(find /usr/lib -maxdepth 5 -type f -name 'crt*.o' 2>/dev/null | sort)
+files+=("${crt[@]}")
+
+mkdir -p "$CHECK_DIR"
+if command -v "$CXX" >/dev/null; then
+  out="$CHECK_DIR/debug.o"
+  if [ ! -f "$out" ]; then
+    cat >"$CHECK_DIR/debug.cpp" <<'EOF'
+#include <cstdio>
+
+template <class T>
+struct Box {
+  T value;
+  T get() const { return value; }
+};
+
+static int twice(int x) {
+  return x * 2;
+}
+
+int counter;
+const char* const greeting = "hello";
+
+int run(int n) {
+  Box<int> box{n};
+  for (int i = 0; i < n; i++)
+    counter += twice(i);
+  std::printf("%s %d\n", greeting, box.get());
+  return counter;
+}
+EOF
+    "$CXX" -g -O0 -c "$CHECK_DIR/debug.cpp" -o "$out"
+  fi
+  files+=("$out")
+fi
+
+for class in 32 64; do
+  for endian in le be; do
+    for type in rel dyn; do
+      for names in uniform cxx; do
+        out="$CHECK_DIR/${class}${endian}-${type}-${names}.o"
+        gen=(--class="$class" --endian="$endian" --type="$type" --names="$names"
+          --symbols=2000 --sections=24 --output="$out")
+        [ "$type" = dyn ] && gen+=(--versions)
+        [ -f "$out" ] || "$ELFGEN" "${gen[@]}"
+        files+=("$out")
+      done
+    done
+  done
+done
+
+echo "checking ${#files[@]} objects, $(flag_sets | wc -l) flag sets, binaries: $FT_NM"
+report=$(
+  printf '%s\0' "${files[@]}" | xargs -0 -n 1 -P "$CHECK_JOBS" "$0" --one
+  check_many "${files[@]}"
+)
+if [ -n "$report" ]; then
+  echo "$report"
+  echo "$(echo "$report" | grep -c '^DIFF') divergence(s)"
+  exit 1
+fi
+echo "no divergence"
@@ -0,0 +1,167 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <nm/elfu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Fuzz target for elfu: every reader that touches the object bytes is driven from the
+// input. Built with libFuzzer by default, with NM_FUZZ_MAIN it gets its own main() that
+// replays files (AFL, or reproducing a crash without libFuzzer).
+
+// Reads every byte of a returned string, so that the sanitizers see the whole range.
+static size_t touch(const char* s) {
+  return s ? strlen(s) : 0;
+}
+
+static void fuzz_symbols(const elfu_t* e, const elfu_section_t* symtab) {
+  elfu_sym_iter_t iter;
+  if (!elfu_get_sym_iter(e, symtab, &iter))
+    return;
+
+  elfu_hash_t hash;
+  const auto has_hash = elfu_get_hash(e, &hash);
+
+  elfu_sym_t sym;
+  size_t n = 0;
+  while (elfu_sym_iter_next(&iter, &sym)) {
+    touch(sym.name);
+    touch(sym.version);
+
+    // The hash walk is bounded by the chain, a few lookups are enough to cover it.
+    size_t found[4];
+    if (has_hash && n++ < 64)
+      elfu_hash_lookup(&hash, symtab, sym.name, found, 4);
+  }
+
+  if (elfu_sym_iter_seek(&iter, iter.total / 2))
+    elfu_sym_iter_next(&iter, &sym);
+}
+
+static void fuzz_lines(const elfu_t* e, const elfu_section_t* symtab) {
+  elfu_lines_t lines = {};
+  if (!elfu_get_lines(e, &lines))
+    return;
+
+  elfu_sym_iter_t iter;
+  elfu_sym_t sym;
+  elfu_line_t line;
+  if (elfu_get_sym_iter(e, symtab, &iter)) {
+    while (elfu_sym_iter_next(&iter, &sym)) {
+      if (elfu_lines_find(&lines, &sym.sym, &line)) {
+        touch(line.comp_dir);
+        touch(line.dir);
+        touch(line.file);
+      }
+    }
+  }
+  elfu_lines_destroy(&lines);
+}
+
+static void fuzz_object(const elfu_t* e) {
+  elfu_ehdr_t ehdr;
+  if (!elfu_get_ehdr(e, &ehdr))
+    return;
+
+  elfu_section_t section;
+  for (size_t i = 0; i < ehdr.e_shnum; i++) {
+    touch(elfu_get_section_name(e, i));
+    if (elfu_get_section(e, i, &section) && section.hdr.sh_type == SHT_STRTAB)
+      touch(elfu_strptr(e, i, 1));
+  }
+
+  elfu_phdr_t phdr;
+  for (size_t i = 0; i < ehdr.e_phnum; i++)
+    elfu_get_phdr(e, i, &phdr);
+
+  elfu_dynamic_t dynamic;
+  elfu_dyn_t dyn;
+  u64 value, offset;
+  if (elfu_get_dynamic(e, &dynamic)) {
+    for (size_t i = 0; elfu_dynamic_get(&dynamic, i, &dyn); i++)
+      ;
+    if (elfu_dynamic_find(&dynamic, DT_SYMTAB, &value))
+      elfu_vaddr_to_offset(e, value, &offset);
+  }
+
+  if (elfu_get_symtab(e, &section)) {
+    fuzz_symbols(e, &section);
+    fuzz_lines(e, &section);
+  }
+  if (elfu_get_dynsymtab(e, &section))
+    fuzz_symbols(e, &section);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, const size_t size) {
+  // The input is read in place, a read past its end is caught by ASan.
+  auto e = elfu_new_from_memory(data, size);
+  if (e) {
+    fuzz_object(e);
+    elfu_destroy(&e);
+  }
+  elfu_reset_err();
+  return 0;
+}
+
+#ifdef NM_FUZZ_MAIN
+
+// Read straight from the descriptor: AFL rewrites stdin between the persistent runs, a
+// FILE would stay at its end of file.
+static bool run_file(const int fd) {
+  size_t cap = 1 << 16;
+  size_t len = 0;
+  uint8_t* data = malloc(cap);
+
+  while (data) {
+    const auto n = read(fd, data + len, cap - len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      free(data);
+      return false;
+    }
+    if (n == 0)
+      break;
+    len += (size_t)n;
+    if (len == cap)
+      data = realloc(data, cap *= 2);
+  }
+  // Exactly sized, like libFuzzer's inputs, so that reads past the end are reported.
+  if (data && len)
+    data = realloc(data, len);
+  if (!data)
+    return false;
+
+  LLVMFuzzerTestOneInput(data, len);
+  free(data);
+  return true;
+}
+
+int main(int argc, char** argv) {
+#ifdef __AFL_LOOP
+  // Persistent mode, the input comes on stdin.
+  while (__AFL_LOOP(10000)) {
+    if (!run_file(STDIN_FILENO))
+      return 1;
+  }
+  return 0;
+#endif
+
+  if (argc < 2)
+    return run_file(STDIN_FILENO) ? 0 : 1;
+
+  for (int i = 1; i < argc; i++) {
+    const auto fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || !run_file(fd)) {
+      perror(argv[i]);
+      return 1;
+    }
+    close(fd);
+  }
+  return 0;
+}
+
+#endif
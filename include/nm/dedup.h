@@ -0,0 +1,69 @@
+#ifndef NM_DEDUP_H
+#define NM_DEDUP_H
+
+#include <stddef.h>
+
+#include "elfu.h"
+#include "out.h"
+
+// Listing cache of --dedup, see dedup.c. The output of an object is recorded once, and
+// replayed for the byte-identical objects listed after it.
+
+// Past this much recorded output, new objects are listed without being recorded.
+#define NM_DEDUP_MAX_SIZE ((size_t)256 << 20)
+
+typedef struct {
+  u64 hash;
+  size_t size;
+} nm_dedup_key_t;
+
+typedef struct {
+  u8* data;
+  size_t len;
+  int status;  // What the listing returned, replayed with the output
+} nm_dedup_entry_t;
+
+typedef struct _nm_dedup_t nm_dedup_t;
+
+/*!
+ * Hash the \a size bytes of \a data, 8 bytes at a time on four independent lanes.
+ */
+u64 nm_hash(const void* data, size_t size);
+
+nm_dedup_t* nm_dedup_new();
+
+/*!
+ * The key of the whole content of \a obj.
+ */
+nm_dedup_key_t nm_dedup_key(const elfu_t* obj);
+
+/*!
+ * Find the recorded output of the object \a obj, of key \a key. The file it was
+ * recorded from is compared with \a obj, a hash collision or a file rewritten since
+ * is a miss.
+ * @return The entry, \c nullptr if there is none.
+ */
+const nm_dedup_entry_t* nm_dedup_find(const nm_dedup_t* d,
+                                      nm_dedup_key_t key,
+                                      const elfu_t* obj);
+
+/*!
+ * Start recording output for \a key: the returned sink forwards everything to \a next,
+ * and keeps a copy for \c nm_dedup_commit.
+ * @param path The file of the object, it must outlive the cache.
+ * @return The sink, \c nullptr if the cache is full: the output then has to go to
+ * \a next directly.
+ */
+const nm_sink_t* nm_dedup_record(nm_dedup_t* d,
+                                 nm_dedup_key_t key,
+                                 const char* path,
+                                 const nm_sink_t* next);
+
+/*!
+ * Keep the output recorded since \c nm_dedup_record, with the \a status of the listing.
+ * @param keep Whether the listing completed, the recording is discarded otherwise.
+ */
+void nm_dedup_commit(nm_dedup_t* d, int status, bool keep);
+void nm_dedup_destroy(nm_dedup_t** d);
+
+#endif
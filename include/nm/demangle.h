@@ -0,0 +1,22 @@
+#ifndef NM_DEMANGLE_H
+#define NM_DEMANGLE_H
+
+#include "nm.h"
+
+// Itanium C++ ABI demangler. Names are parsed into a node pool and printed into a
+// buffer, both owned by the demangler and reused from one name to the next: demangling
+// a name never allocates. The results are memoized, so that names repeated within or
+// across symbol tables are only demangled once.
+typedef struct _nm_demangler_t nm_demangler_t;
+
+nm_demangler_t* nm_demangler_new();
+
+/*!
+ * Demangle \a name like \c c++filt does.
+ * @return The demangled name, valid until the next call. \a name itself if it is not a
+ * mangled C++ name or can't be demangled.
+ */
+const char* nm_demangle(nm_demangler_t* d, const char* name);
+void nm_demangler_destroy(nm_demangler_t** d);
+
+#endif
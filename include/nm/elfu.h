@@ -71,6 +71,8 @@ typedef struct {
 
 static_assert(sizeof(elf_ident_t) == EI_NIDENT);
 
+void _elfu_seterr(elfu_err_t err);
+
 #endif
 
 typedef struct {
@@ -91,6 +93,8 @@ typedef struct {
 
 typedef Elf64_Shdr elfu_shdr_t;
 typedef Elf64_Sym elfu_isym_t;
+typedef Elf64_Phdr elfu_phdr_t;
+typedef Elf64_Dyn elfu_dyn_t;
 
 typedef struct {
   const char* name;
@@ -116,16 +120,31 @@ typedef struct _elfu_t {
 
   elfu_ehdr_t ehdr;  // The ELF header
 
-  // The raw object bytes, mapped from the file.
+  // The raw object bytes, mapped from the file or borrowed from the caller.
   uint8_t* raw;
   size_t fsize;
   size_t offset;
 
+  u32 map_flags;  // ELFU_MAP_*
+
   struct {
     bool ehdr : 1;
+    bool mapped : 1;  // raw is our own mapping, unmapped on destruction
   } flags;
 } elfu_t;
 
+// Mapping hints for large objects, none of them changes what is read. Each one is a
+// best effort, a hint the kernel or the filesystem doesn't support is ignored.
+enum {
+  // Prefault the whole object when it is mapped (MAP_POPULATE).
+  ELFU_MAP_POPULATE = 1 << 0,
+  // Read ahead the symbol, string and version tables once an iterator is created over
+  // them (MADV_WILLNEED), rather than faulting them in page by page.
+  ELFU_MAP_WILLNEED = 1 << 1,
+  // Back the mapping with transparent huge pages, it is aligned on their size.
+  ELFU_MAP_HUGEPAGE = 1 << 2,
+};
+
 enum {
   ELFU_VER_NONE = 0,
   ELFU_VER_NEED = 1,
@@ -136,10 +155,35 @@ typedef struct {
   elfu_section_t versym;
   elfu_section_t verneed;
   elfu_section_t verdef;
+  elfu_section_t strtab;  // The string table of the version names
 
   u8 flags;
 } elfu_version_t;
 
+// The \c PT_DYNAMIC segment of an object.
+typedef struct {
+  const u8* data;
+  size_t count;  // Number of entries, up to the \c DT_NULL terminator
+
+  const elfu_t* elf;
+} elfu_dynamic_t;
+
+// A symbol hash table, either \c SHT_GNU_HASH or \c SHT_HASH.
+typedef struct {
+  elfu_section_t section;
+  bool gnu;
+
+  u32 nbuckets;
+  u32 symoffset;    // GNU only, index of the first symbol covered by the table
+  u32 bloom_size;   // GNU only, in words of the object class size
+  u32 bloom_shift;  // GNU only
+  size_t nchain;    // Number of chain entries within the section bounds
+
+  const u8* bloom;
+  const u8* buckets;
+  const u8* chain;
+} elfu_hash_t;
+
 typedef struct {
   size_t total;
   size_t cursor;
@@ -149,8 +193,61 @@ typedef struct {
 
   const elfu_t* elf;
   const elfu_section_t* symtab;
+  elfu_section_t strtab;
+
+  // Optional, the symbols whose name it rejects are skipped before their version or
+  // section is looked up.
+  bool (*filter)(const char* name, const void* ctx);
+  const void* filter_ctx;
 } elfu_sym_iter_t;
 
+typedef struct {
+  const char* comp_dir;  // nullptr if unknown, it is only known since DWARF 5
+  const char* dir;       // nullptr if unknown or if it is the compilation directory
+  const char* name;
+} elfu_line_file_t;
+
+typedef struct {
+  u64 addr;
+  u32 file;  // Index in the files, UINT32_MAX if unknown or at the end of a sequence
+  u32 line;
+} elfu_line_row_t;
+
+// A run of contiguous rows, the last one is the address past the end of the sequence.
+typedef struct {
+  u64 low;
+  u64 high;
+  size_t first;  // Index of the first row
+  size_t count;
+} elfu_line_seq_t;
+
+// Address to source line table, built from all the line programs of .debug_line.
+// Consecutive rows mapping to the same line are merged.
+typedef struct {
+  elfu_line_file_t* files;
+  size_t nfiles;
+  elfu_line_row_t* rows;
+  size_t nrows;
+  elfu_line_seq_t* seqs;  // Sorted by address
+  size_t nseqs;
+
+  // Relocatable objects only: the address each section is placed at, so that the
+  // sections don't overlap (UINT64_MAX for the sections that are not loaded), and the
+  // relocated copy of .debug_line.
+  u64* bases;
+  size_t nbases;
+  u8* relocated;
+} elfu_lines_t;
+
+// The source path is made of up to three components: `comp_dir/dir/file`. The missing
+// ones are nullptr.
+typedef struct {
+  const char* comp_dir;
+  const char* dir;
+  const char* file;
+  u32 line;
+} elfu_line_t;
+
 /*!
  * This function will allocate a new \c elfu_t object and map the passed object in memory.
  * @param fd The file descriptor of the ELF object.
@@ -159,6 +256,22 @@ typedef struct {
  */
 elfu_t* elfu_new(int fd);
 
+/*!
+ * Same as \c elfu_new, mapping the object with the \c ELFU_MAP_* hints in \a map_flags.
+ */
+elfu_t* elfu_new_with_flags(int fd, u32 map_flags);
+
+/*!
+ * This function will allocate a new \c elfu_t object reading the object from memory,
+ * without copying it.
+ * @param data The bytes of the ELF object, owned by the caller. They must stay valid and
+ * unchanged until the object is destroyed.
+ * @param size The size of \c data in bytes.
+ * @return A new \c elfu_t object on success. \c nullptr on failure, and sets the
+ * appropriate error that can be retrieved with \c elfu_get_err.
+ */
+elfu_t* elfu_new_from_memory(const void* data, size_t size);
+
 /*!
  * Retrieve the ELF object header.
  * @param e The \c elfu_t object.
@@ -188,13 +301,85 @@ bool elfu_get_section(const elfu_t* e, size_t index, elfu_section_t* section);
 bool elfu_get_symtab(const elfu_t* e, elfu_section_t* symtab);
 
 /*!
- * Retrieve the first \c SHT_DYNSYM section in the object.
+ * Retrieve the first \c SHT_DYNSYM section in the object. When there is none, because the
+ * section headers are stripped or corrupted, the table is located through the
+ * \c DT_SYMTAB entry of the dynamic segment instead. Such a section has no header: its
+ * \c sh_link is \c SHN_UNDEF and its size is derived from the hash tables.
  * @param e The \c elfu_t object.
  * @param dynsymtab[out] The \c elfu_section_t to fill once found.
  * @return \c true if found, \c false otherwise. It will also return \c false on error.
  */
 bool elfu_get_dynsymtab(const elfu_t* e, elfu_section_t* dynsymtab);
 
+/*!
+ * Retrieve a program header by its index.
+ * @param e The \c elfu_t object.
+ * @param index The program header index.
+ * @param phdr[out] The \c elfu_phdr_t to fill.
+ * @return Whether the operation was successful.
+ */
+bool elfu_get_phdr(const elfu_t* e, size_t index, elfu_phdr_t* phdr);
+
+/*!
+ * Translate a virtual address to a file offset through the \c PT_LOAD segments.
+ * @param e The \c elfu_t object.
+ * @param vaddr The virtual address.
+ * @param offset[out] The file offset.
+ * @return \c false if no segment maps \a vaddr from the file.
+ */
+bool elfu_vaddr_to_offset(const elfu_t* e, u64 vaddr, u64* offset);
+
+/*!
+ * Retrieve the dynamic table of the object from its \c PT_DYNAMIC segment.
+ * @param e The \c elfu_t object.
+ * @param dynamic[out] The \c elfu_dynamic_t to fill once found.
+ * @return \c true if found, \c false otherwise. It will also return \c false on error.
+ */
+bool elfu_get_dynamic(const elfu_t* e, elfu_dynamic_t* dynamic);
+
+/*!
+ * Retrieve an entry of the dynamic table by its index.
+ * @param dynamic The \c elfu_dynamic_t table.
+ * @param index The entry index.
+ * @param dyn[out] The \c elfu_dyn_t to fill.
+ * @return Whether the operation was successful.
+ */
+bool elfu_dynamic_get(const elfu_dynamic_t* dynamic, size_t index, elfu_dyn_t* dyn);
+
+/*!
+ * Retrieve the value of the first entry tagged \a tag in the dynamic table.
+ * @param dynamic The \c elfu_dynamic_t table.
+ * @param tag The \c DT_* tag.
+ * @param value[out] The entry value.
+ * @return \c true if found, \c false otherwise.
+ */
+bool elfu_dynamic_find(const elfu_dynamic_t* dynamic, int64_t tag, u64* value);
+
+/*!
+ * Retrieve the symbol hash table of the object, \c SHT_GNU_HASH is preferred over
+ * \c SHT_HASH when both are present.
+ * @param e The \c elfu_t object.
+ * @param hash[out] The \c elfu_hash_t to fill once found.
+ * @return \c true if found, \c false otherwise. It will also return \c false on error.
+ */
+bool elfu_get_hash(const elfu_t* e, elfu_hash_t* hash);
+
+/*!
+ * Look up the symbols named \a name through the hash table, without iterating over the
+ * symbol table. Undefined symbols are never reported.
+ * @param hash The \c elfu_hash_t to search.
+ * @param symtab The symbol table indexed by \a hash (its \c sh_link).
+ * @param name The symbol name, without version.
+ * @param out[out] Filled with up to \a max matching symbol indices.
+ * @param max The capacity of \a out.
+ * @return The number of matching symbols written to \a out.
+ */
+size_t elfu_hash_lookup(const elfu_hash_t* hash,
+                        const elfu_section_t* symtab,
+                        const char* name,
+                        size_t* out,
+                        size_t max);
+
 /*!
  * Retrieve the name associated to the given section index.
  * @param e The \c elfu_t object.
@@ -229,6 +414,47 @@ bool elfu_get_sym_iter(const elfu_t* e, const elfu_section_t* symtab, elfu_sym_i
  */
 bool elfu_sym_iter_next(elfu_sym_iter_t* i, elfu_sym_t* sym);
 
+/*!
+ * Move the symbol iterator, the next call to \c elfu_sym_iter_next will retrieve the
+ * symbol at \a index.
+ * @param i The \c elfu_sym_iter_t iterator.
+ * @param index The symbol index in the table.
+ * @return Whether the operation was successful. \c false if \a index is out of bounds.
+ */
+bool elfu_sym_iter_seek(elfu_sym_iter_t* i, size_t index);
+
+/*!
+ * Whether the object of the iterator defines the version \a name (\c SHT_GNU_verdef).
+ * Linkers emit an \c SHN_ABS symbol named after each version they define.
+ * @param i The \c elfu_sym_iter_t iterator, over the dynamic symbol table.
+ * @param name The version name.
+ */
+bool elfu_sym_iter_defines_version(const elfu_sym_iter_t* i, const char* name);
+
+/*!
+ * Run every line program of the \c .debug_line section (DWARF 2 to 5) once and build the
+ * address to line table. Only \c .debug_line and the string sections it refers to are
+ * read.
+ * @param e The \c elfu_t object.
+ * @param lines[out] The \c elfu_lines_t to fill, destroy it with \c elfu_lines_destroy.
+ * @return \c true if the object has line information, \c false otherwise. It will also
+ * return \c false on error.
+ */
+bool elfu_get_lines(const elfu_t* e, elfu_lines_t* lines);
+
+/*!
+ * Find the source line of the address of \a sym, with a binary search over the
+ * sequences then over the rows of the one containing it.
+ * @param lines The table built by \c elfu_get_lines.
+ * @param sym A symbol of the object the table was built from.
+ * @param line[out] The \c elfu_line_t to fill.
+ * @return Whether a line was found, the symbol must be defined in a section.
+ */
+bool elfu_lines_find(const elfu_lines_t* lines,
+                     const elfu_isym_t* sym,
+                     elfu_line_t* line);
+void elfu_lines_destroy(elfu_lines_t* lines);
+
 /*!
  * @return Whether the library is in an error state or not.
  */
@@ -245,7 +471,8 @@ elfu_err_t elfu_get_err();
 void elfu_reset_err();
 
 /*!
- * Destroy an \c elfu_t object and unmap the object from memory.
+ * Destroy an \c elfu_t object and unmap the object from memory. The bytes passed to
+ * \c elfu_new_from_memory are left untouched.
  * @param e A pointer to an \c elfu_t object pointer to destroy. Set to \c nullptr after destruction.
  */
 void elfu_destroy(elfu_t** e);
@@ -0,0 +1,122 @@
+#ifndef NM_FORMAT_H
+#define NM_FORMAT_H
+
+#include "demangle.h"
+#include "nm.h"
+#include "out.h"
+
+typedef enum {
+  NM_FORMAT_BSD = 0,
+  NM_FORMAT_POSIX,
+  NM_FORMAT_SYSV,
+  NM_FORMAT_JSON,
+  NM_FORMAT_BINARY,
+} nm_format_t;
+
+// Everything a formatter needs to know about the object being listed, computed once
+// per object so the per symbol paths only format.
+typedef struct {
+  const char* file;
+  const nm_sections_t* sections;
+
+  bool print_filename;  // Several objects are listed
+  bool undefined_only;  // -u, changes the sysv header
+  bool size_as_value;   // --size-sort, bsd shows the size in the value column
+  bool print_size;      // -S
+  bool print_section;   // --print-section
+
+  nm_demangler_t* demangler;  // -C, nullptr to print the names as they are
+  const elfu_lines_t* lines;  // -l, nullptr if not requested or without line information
+  size_t width;  // Hex digits of the value and size columns
+} nm_fmt_ctx_t;
+
+typedef struct {
+  const char* name;
+
+  // Written before the symbols of each object, may be nullptr.
+  void (*header)(nm_out_t* out, const nm_fmt_ctx_t* ctx);
+  // Write one symbol, nullptr for the formats written in a single batch.
+  void (*symbol)(nm_out_t* out, const nm_fmt_ctx_t* ctx, const nm_symbol_t* s);
+} nm_formatter_t;
+
+extern const nm_formatter_t nm_formatters[];
+
+/*!
+ * Retrieve a formatter by its \c --format name.
+ * @return The format, \c -1 if unknown.
+ */
+int nm_format_by_name(const char* name);
+
+/*!
+ * Write one symbol in \a format. The batched formats have no per symbol output, single
+ * symbols are written like bsd.
+ */
+void nm_format_symbol(nm_out_t* out,
+                      const nm_fmt_ctx_t* ctx,
+                      nm_format_t format,
+                      const nm_symbol_t* s);
+
+// Binary listing, one blob per object, laid out to be used in place once mapped:
+//
+//  nm_bin_header_t header
+//  nm_bin_record_t records[count]
+//  char strings[strings_size]      NUL terminated strings
+//
+// All the fields are in the byte order of the host that produced the blob, consumers
+// can detect a foreign byte order by checking `version`. Blobs are 8 bytes aligned and
+// can be concatenated, `total_size` gives the offset of the next one.
+
+#define NM_BIN_MAGIC "FTNMSYMS"
+#define NM_BIN_VERSION 1
+#define NM_BIN_NO_STRING UINT32_MAX
+
+enum {
+  NM_BIN_OBJECT_64 = 1 << 0,  // The object is ELFCLASS64
+};
+
+enum {
+  NM_BIN_SYM_VERSION_HIDDEN = 1 << 0,  // `name@version` rather than `name@@version`
+  NM_BIN_SYM_UNDEFINED = 1 << 1,       // The value is meaningless
+};
+
+typedef struct {
+  char magic[8];
+  u32 version;
+  u32 record_size;  // sizeof(nm_bin_record_t)
+  u64 count;
+  u64 strings_offset;  // From the start of the header
+  u64 strings_size;
+  u64 total_size;  // Header, records, strings and padding
+  u32 file;        // Offset of the object path in the strings
+  u32 flags;
+} nm_bin_header_t;
+
+typedef struct {
+  u64 value;
+  u64 size;
+  u32 name;     // Offset in the strings
+  u32 version;  // Offset in the strings, NM_BIN_NO_STRING if none
+  u8 type;      // The nm symbol type character
+  u8 flags;
+  u8 info;  // The ELF st_info (type & binding)
+  u8 other;
+  u16 shndx;
+  u16 _reserved;
+} nm_bin_record_t;
+
+static_assert(sizeof(nm_bin_header_t) == 56);
+static_assert(sizeof(nm_bin_record_t) == 32);
+
+/*!
+ * Write the binary blob of an object listing.
+ * @param order The keys of the symbols to write, in output order.
+ * @return Whether the strings fit the 32 bits offsets of the records, nothing is
+ * written otherwise.
+ */
+bool nm_format_binary(nm_out_t* out,
+                      const nm_fmt_ctx_t* ctx,
+                      const nm_symbol_t* symbols,
+                      const nm_key_t* order,
+                      size_t count);
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef NM_LIST_H
+#define NM_LIST_H
+
+#include <ad/collections.h>
+#include <sys/types.h>
+
+#include "demangle.h"
+#include "format.h"
+#include "nm.h"
+#include "out.h"
+
+// The listing engine behind ft_nm. It keeps no global state: listings with their own
+// options (and demangler) can run concurrently, on the same object as well.
+
+typedef struct {
+  const char* file;     // Name of the object in the headers and the json/binary output
+  bool print_filename;  // Several objects are listed, bsd and posix print headers
+
+  bool dynamic;          // -D, list .dynsym instead of .symtab
+  bool no_filter;        // -a
+  bool only_external;    // -g
+  bool only_undefined;   // -u
+  bool no_sort;          // -p
+  bool numeric_sort;     // -n
+  bool size_sort;        // --size-sort
+  bool reverse_sort;     // -r
+  bool print_size;       // -S
+  bool print_section;    // --print-section
+  bool line_numbers;     // -l
+  size_t limit;          // --limit, SIZE_MAX to list every symbol
+  nm_format_t format;    // --format
+  bool no_header;        // The header is written apart, with nm_list_header
+
+  const nm_match_t* match;    // --match, nullptr to keep every name
+  nm_demangler_t* demangler;  // -C, nullptr to print the names as they are. A demangler
+                              // is not thread safe, concurrent listings need their own.
+} nm_list_opts_t;
+
+// Lists every symbol sorted by name in the bsd format, `file` still has to be set.
+#define NM_LIST_OPTS_DEFAULT {.limit = SIZE_MAX}
+
+typedef enum {
+  NM_LIST_OK = 0,
+  NM_LIST_NO_SYMBOLS,     // The selected symbol table is missing or empty
+  NM_LIST_OUT_OF_MEMORY,  // Whatever was listed so far has been written to the sink
+  NM_LIST_SINK_FAILED,    // The sink refused some output, the rest was discarded
+  NM_LIST_TOO_LARGE,      // The symbol strings don't fit the binary format, none written
+} nm_list_err_t;
+
+// The per object state the listing modes share.
+typedef struct {
+  nm_sections_t sections;
+  elfu_lines_t lines;
+  nm_fmt_ctx_t fmt;
+} nm_list_ctx_t;
+
+/*!
+ * List the symbols of \a obj like ft_nm does, the output (headers included) is written
+ * to \a sink in chunks of up to \c NM_OUT_SIZE bytes.
+ * @param obj The object, only read: several listings can share it.
+ * @param opts The listing options.
+ * @param sink Where the output goes.
+ * @return \c NM_LIST_OK on success, the reason of the failure otherwise.
+ */
+nm_list_err_t nm_list(const elfu_t* obj,
+                      const nm_list_opts_t* opts,
+                      const nm_sink_t* sink);
+
+/*!
+ * Write the header \c nm_list writes before the symbols of \a obj, if the format has one.
+ * @return Whether the operation was successful.
+ */
+bool nm_list_header(const elfu_t* obj,
+                    const nm_list_opts_t* opts,
+                    const nm_sink_t* sink);
+
+/*!
+ * Build the section table, and the line table if \c opts->line_numbers, of \a obj.
+ * @return Whether the operation was successful, it only fails on allocation failure.
+ */
+bool nm_list_ctx_init(nm_list_ctx_t* ctx, const elfu_t* obj, const nm_list_opts_t* opts);
+void nm_list_ctx_destroy(nm_list_ctx_t* ctx);
+
+/*!
+ * Retrieve the symbol table selected by \c opts->dynamic.
+ */
+bool nm_list_symtab(const elfu_t* obj,
+                    const nm_list_opts_t* opts,
+                    elfu_section_t* symtab);
+
+/*!
+ * Build the listed form of the symbol \a s, found at \a pos in its table.
+ */
+nm_symbol_t nm_make_symbol(const elfu_t* obj,
+                           const nm_sections_t* sections,
+                           const elfu_sym_t* s,
+                           size_t pos);
+
+/*!
+ * Process the given \a symtab ELF section and push the symbols kept by \a opts to
+ * \a symbols.
+ * @param names When not \c nullptr, the names are interned for the sort keys.
+ * @param has_symbols[out] Whether the table has any symbol, listed or not.
+ * @return The number of entries in the table, \c -1 on allocation failure.
+ */
+ssize_t nm_process_symtab(const elfu_t* obj,
+                          const nm_sections_t* sections,
+                          const nm_list_opts_t* opts,
+                          const elfu_section_t* symtab,
+                          vector(nm_symbol_t) * symbols,
+                          nm_intern_t* names,
+                          bool* has_symbols);
+
+#endif
@@ -53,6 +53,14 @@ typedef enum {
 
 #include "elfu.h"
 
+// Fixed-size sort key computed once per symbol when collecting, so that the sort only
+// touches the string tables when two different names share the same 8 bytes prefix.
+typedef struct {
+  u64 prefix;  // The first 8 bytes of the name, big endian, zero padded
+  u32 id;      // The interned name id, identical names share the same id
+  u32 index;   // The symbol index in the collected symbols
+} nm_key_t;
+
 typedef struct {
   const char* name;
   const char* version;
@@ -63,21 +71,266 @@ typedef struct {
 
   elfu_isym_t internal;  // The original symbol
   size_t pos;            // The symbol position in the table
+
+  nm_key_t key;
 } nm_symbol_t;
 
-typedef int (*cmp_fn)(const nm_symbol_t*, const nm_symbol_t*);
-void heapsort(nm_symbol_t* arr, size_t n, cmp_fn cmp);
+// Per section metadata, computed once per object so that classifying and displaying a
+// symbol never goes back to the section headers.
+typedef struct {
+  const char* name;    // "" if it can't be retrieved
+  u64 addr;            // sh_addr
+  u64 size;            // sh_size
+  nm_sym_type_t type;  // Local type of the symbols defined in the section
+} nm_section_t;
+
+// A \c PT_LOAD or \c PT_TLS segment, symbols are classified by address when there are no
+// sections.
+typedef struct {
+  u64 addr;    // p_vaddr, 0 for PT_TLS whose symbols are offsets in the segment
+  u64 filesz;  // p_filesz
+  u64 memsz;   // p_memsz
+  u32 flags;   // p_flags
+  bool tls;
+} nm_segment_t;
+
+typedef struct {
+  nm_section_t* entries;
+  size_t count;
+
+  nm_segment_t* segments;
+  size_t nsegments;  // Only set when none of the sections can be read
+} nm_sections_t;
+
+/*!
+ * Build the section table of \a obj, sections that can't be read are kept with an
+ * \c SYM_UNKNOWN type. When none can, the loadable segments are recorded instead.
+ * @return Whether the operation was successful, it only fails on allocation failure.
+ */
+bool nm_sections_build(const elfu_t* obj, nm_sections_t* sections);
+
+/*!
+ * Retrieve the local type of the symbols defined in the section \a index.
+ */
+nm_sym_type_t nm_sections_type(const nm_sections_t* sections, size_t index);
+
+/*!
+ * Retrieve the local type of the symbols defined at \a addr, from the loadable segments.
+ * Thread local symbols (\a tls) are looked up in the \c PT_TLS segment.
+ */
+nm_sym_type_t nm_segments_type(const nm_sections_t* sections, u64 addr, bool tls);
+void nm_sections_destroy(nm_sections_t* sections);
+
+typedef struct {
+  const char* name;
+  u32 hash;
+  u32 len;
+} nm_interned_t;
+
+// Name interning table, ids are dense and index `entries`.
+typedef struct {
+  u32* slots;
+  nm_interned_t* entries;
+  size_t count;
+  size_t cap;
+} nm_intern_t;
+
+/*!
+ * Retrieve the id of \a name, inserting it if it was never seen before.
+ * @param t The interning table, zero initialized before the first call.
+ * @param name The name to intern, it must outlive the table.
+ * @param id[out] The name id.
+ * @return Whether the operation was successful, it only fails on allocation failure.
+ */
+bool nm_intern(nm_intern_t* t, const char* name, u32* id);
+void nm_intern_destroy(nm_intern_t* t);
+
+/*!
+ * Pack the first 8 bytes of \a s into a big endian integer, padded with zeroes.
+ * Comparing two prefixes as integers gives the same order as \c strcmp on those bytes.
+ */
+u64 nm_strprefix(const char* s);
+
+/*!
+ * \c strcmp equivalent comparing 16/32 bytes per step when SIMD is available.
+ * Vector loads never cross a page boundary, so it is safe on mmapped string tables.
+ */
+int nm_strcmp(const char* a, const char* b);
+
+/*!
+ * Hash \a s (FNV-1a) and compute its length in the same pass.
+ */
+u32 nm_strhash(const char* s, u32* len);
+
+/*!
+ * Search the \a len bytes of \a needle, which has no NUL, in \a s. Positions where
+ * both its first and last bytes match are found 16/32 at a time when SIMD is available,
+ * with the same page rules as \c nm_strcmp.
+ * @return Whether \a s contains \a needle.
+ */
+bool nm_strfind(const char* s, const char* needle, size_t len);
+
+// A compiled --match pattern. Patterns with glob metacharacters (`*`, `?` or `[`) must
+// match the whole name, the others match the names containing them.
+typedef struct {
+  const char* pattern;
+  bool glob;
+  // Run of plain characters every matching name contains, searched first so that most
+  // names are rejected without running the glob.
+  const char* literal;
+  size_t literal_len;
+} nm_match_t;
+
+/*!
+ * Compile \a pattern, which must outlive \a m.
+ */
+void nm_match_compile(nm_match_t* m, const char* pattern);
+
+/*!
+ * @return Whether \a name matches the compiled pattern \a m.
+ */
+bool nm_match(const nm_match_t* m, const char* name);
+
+typedef int (*cmp_fn)(const nm_key_t*, const nm_key_t*, const void* ctx);
+void heapsort(nm_key_t* arr, size_t n, cmp_fn cmp, const void* ctx);
+
+/*!
+ * Arrange \a arr as a min-heap in O(n), the smallest elements can then be retrieved in
+ * order with \c heap_pop, each in O(log n).
+ */
+void heap_build(nm_key_t* arr, size_t n, cmp_fn cmp, const void* ctx);
+
+/*!
+ * Remove and return the smallest element of the min-heap \a arr.
+ * @param n[in,out] The heap size, must be greater than 0. Decremented by one.
+ */
+nm_key_t heap_pop(nm_key_t* arr, size_t* n, cmp_fn cmp, const void* ctx);
+
+typedef struct {
+  u64 value;
+  u32 index;
+} nm_rkey_t;
+
+/*!
+ * Stable LSD radix sort of \a arr on the 64 bits \c value, 8 bits per pass. Passes on
+ * digits shared by every key are skipped.
+ * @return Whether the operation was successful, it only fails on allocation failure.
+ */
+bool radixsort(nm_rkey_t* arr, size_t n);
+
+typedef struct {
+  u64 start;
+  u64 size;
+  const nm_symbol_t* symbol;
+} nm_range_t;
+
+// Address to symbol index over the defined functions and objects.
+typedef struct {
+  u64* starts;         // Range starts, in Eytzinger order (1-based)
+  u32* ranks;          // Sorted position of each Eytzinger slot
+  nm_range_t* ranges;  // Ranges sorted by start
+  size_t count;
+} nm_addr_index_t;
+
+/*!
+ * Build an address index over the defined \c STT_FUNC and \c STT_OBJECT symbols.
+ * @param idx[out] The index to initialize.
+ * @param symbols The symbols, they must outlive the index.
+ * @return Whether the operation was successful, it only fails on allocation failure.
+ */
+bool nm_addr_index_build(nm_addr_index_t* idx, const nm_symbol_t* symbols, size_t n);
+
+/*!
+ * Find the symbol containing \a addr, the closest range starting at or before it.
+ * Zero-sized symbols only match their exact address.
+ * @return The range, \c nullptr if no symbol contains \a addr.
+ */
+const nm_range_t* nm_addr_index_find(const nm_addr_index_t* idx, u64 addr);
+void nm_addr_index_destroy(nm_addr_index_t* idx);
+
+typedef enum {
+  NM_SYMMAP_REF,       // Undefined reference
+  NM_SYMMAP_DEF,       // Strong definition
+  NM_SYMMAP_WEAK_DEF,  // Weak or common definition, never conflicts
+} nm_symmap_kind_t;
+
+typedef struct {
+  const char* name;
+  u32 len;
+
+  u32 nrefs;
+  u32 first_ref;  // Smallest referencing file index, \c UINT32_MAX if none
+  u32 nweak;
+  u32 ndefs;
+  u32* defs;  // File indices of the strong definitions, in insertion order
+} nm_symmap_entry_t;
+
+// Concurrent global name table, see symmap.c.
+typedef struct _nm_symmap_t nm_symmap_t;
+
+nm_symmap_t* nm_symmap_new();
+
+/*!
+ * Record a reference to or a definition of \a name by \a file. Thread safe.
+ * @return Whether the operation was successful, it only fails on allocation failure.
+ */
+bool nm_symmap_add(nm_symmap_t* map, const char* name, u32 file, nm_symmap_kind_t kind);
+
+/*!
+ * Collect the entries of the table, valid until the table is destroyed. Not thread safe.
+ * @param count[out] The number of entries.
+ * @return An array to free, \c nullptr on allocation failure.
+ */
+nm_symmap_entry_t** nm_symmap_entries(const nm_symmap_t* map, size_t* count);
+void nm_symmap_destroy(nm_symmap_t** map);
+
+#ifdef NM_STATS
+#define NM_STATS_USAGE \
+  "      --stats     Report per file phase timings and counters on stderr\n"
+#else
+#define NM_STATS_USAGE ""
+#endif
 
 #define NM_COMMAND_USAGE                                                  \
   "Usage: ft_nm [option(s)] [file(s)]\n"                                  \
   " List symbols in [file(s)] (a.out by default).\n"                      \
   " The options are:\n"                                                   \
   "  -a              Display all symbols (no filter)\n"                   \
+  "  -C, --demangle  Decode the mangled C++ symbol names\n"               \
   "  -D              Display dynamic symbols instead of normal symbols\n" \
   "  -g              Display only external symbols\n"                     \
+  "  -l, --line-numbers\n"                                                \
+  "                  Print the source FILE:LINE of defined symbols\n"     \
+  "  -n              Sort symbols numerically by address\n"               \
   "  -p              Do not sort the symbols\n"                           \
+  "  -P              Use the POSIX output format\n"                       \
   "  -r              Reverse the sort order of the symbols\n"             \
+  "  -R DIR          Display the symbols of every ELF file under DIR\n"   \
+  "  -S              Print the size of defined symbols\n"                 \
   "  -u              Display only undefined symbols\n"                    \
+  "      --size-sort Sort symbols by size\n"                              \
+  "      --print-section\n"                                               \
+  "                  Print the section of each symbol\n"                  \
+  "      --limit=N   Display only the first N symbols\n"                  \
+  "      --match=PAT Display only the symbols whose name contains PAT,\n" \
+  "                  or matches it if PAT is a glob (*, ? or [...])\n"    \
+  "      --lookup    Resolve the addresses read from stdin to symbols\n"  \
+  "      --find=NAME Display only the symbols named NAME[@VERSION],\n"    \
+  "                  found through the hash table when available\n"      \
+  "      --resolve   Report the undefined and multiply defined global\n"  \
+  "                  symbols across all [file(s)]\n"                      \
+  "      --diff      Compare the symbols of two [file(s)], OLD and NEW\n" \
+  "      --format=F  Use the output format F: bsd, posix, sysv,\n"        \
+  "                  json or binary\n"                                    \
+  "      --mmap=HINTS\n"                                                  \
+  "                  Map the objects with the comma separated HINTS:\n"   \
+  "                  populate, willneed and hugepage\n"                   \
+  "      --prefetch=N\n"                                                  \
+  "                  Read up to N of the [file(s)] ahead (16), 0 to\n"    \
+  "                  open each one when it is listed\n"                   \
+  "      --dedup     Decode identical [file(s)] once, and replay the\n"   \
+  "                  listing for the copies (bsd, posix and sysv)\n"      \
+  NM_STATS_USAGE                                                          \
   "  -h              Display this help message\n"
 
 #endif
@@ -6,13 +6,25 @@
 #define OPT_END (-1)
 #define OPT_UNKNOWN (-2)
 
+// Long options are matched as `--name`, `--name=value` or `--name value`.
+typedef struct {
+  const char* name;  // The option name, without the leading `--`
+  int val;           // The value returned by `opt_next` when matched
+  bool has_arg;
+} opt_long_t;
+
 typedef struct {
   bool lut[UINT8_MAX];
+  bool lut_arg[UINT8_MAX];  // Short options taking an argument, `-Rvalue` or `-R value`
   int argc;
   int argp;
+
+  const opt_long_t* longs;  // Terminated by an entry with a null name
+  const char* arg;          // The argument of the last matched option
 } opt_t;
 
-opt_t nm_opt(const char* flags);
+// A flag followed by `:` in \a flags takes an argument, like with getopt.
+opt_t nm_opt(const char* flags, const opt_long_t* longs);
 int opt_next(opt_t* o, int argc, char** argv);
 
 #endif
@@ -0,0 +1,48 @@
+#ifndef NM_OUT_H
+#define NM_OUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "elfu.h"
+
+#define NM_OUT_SIZE (64 * 1024)
+
+// Destination of the buffered data when it isn't a file descriptor.
+typedef struct {
+  // Consume `len` bytes of `data`, returns whether they were.
+  bool (*write)(void* ctx, const void* data, size_t len);
+  void* ctx;
+} nm_sink_t;
+
+// Buffered writer, the formatters write whole records into it and the data only reaches
+// the file descriptor (or the sink) once the buffer is full or explicitly flushed.
+typedef struct {
+  int fd;
+  const nm_sink_t* sink;  // Written to instead of fd when set
+  bool failed;  // A write failed, the following output is discarded
+  size_t len;
+  char data[NM_OUT_SIZE];
+} nm_out_t;
+
+/*!
+ * Sink writing to a file descriptor, \a ctx points to the \c int descriptor.
+ */
+bool nm_sink_fd(void* ctx, const void* data, size_t len);
+
+void nm_out_write(nm_out_t* out, const void* data, size_t len);
+void nm_out_puts(nm_out_t* out, const char* s);
+
+/*!
+ * Write the buffered data to the file descriptor.
+ * @return Whether the operation was successful.
+ */
+bool nm_out_flush(nm_out_t* out);
+
+static inline void nm_out_putc(nm_out_t* out, const char c) {
+  if (out->len == NM_OUT_SIZE && !nm_out_flush(out))
+    return;
+  out->data[out->len++] = c;
+}
+
+#endif
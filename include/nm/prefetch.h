@@ -0,0 +1,49 @@
+#ifndef NM_PREFETCH_H
+#define NM_PREFETCH_H
+
+#include <stddef.h>
+
+#include "elfu.h"
+
+// Read-ahead of the files of a multi-file run, see prefetch.c. While a file is being
+// listed, the next ones are opened, sized and read in the background through io_uring,
+// or synchronously with pread when io_uring is unavailable.
+
+#define NM_PREFETCH_DEPTH 16
+// Larger files are only opened, they are mapped as usual.
+#define NM_PREFETCH_MAX_SIZE ((size_t)4 << 20)
+
+typedef struct {
+  const char* name;
+  int err;  // errno of the failed open or read, 0 on success
+
+  int fd;     // -1 if the open failed
+  u8* data;   // The whole file, nullptr if it wasn't read ahead (not a regular file,
+              // empty or larger than NM_PREFETCH_MAX_SIZE): it has to be mapped from fd
+  size_t size;
+} nm_prefetched_t;
+
+typedef struct _nm_prefetch_t nm_prefetch_t;
+
+/*!
+ * Start reading ahead \a files, up to \a depth of them at a time.
+ * @param files The paths, they must outlive the pipeline.
+ * @return A new pipeline, \c nullptr on allocation failure.
+ */
+nm_prefetch_t* nm_prefetch_new(char** files, size_t nfiles, size_t depth);
+
+/*!
+ * Wait for the next file, in the order of \c files, and take it from the pipeline. The
+ * slot it occupied is used to read ahead a following file.
+ * @param file[out] The file, to release with \c nm_prefetched_release.
+ * @return Whether there was a next file.
+ */
+bool nm_prefetch_next(nm_prefetch_t* p, nm_prefetched_t* file);
+
+/*!
+ * Close and free a file taken from the pipeline.
+ */
+void nm_prefetched_release(nm_prefetched_t* file);
+void nm_prefetch_destroy(nm_prefetch_t** p);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef NM_STATS_H
+#define NM_STATS_H
+
+#include <stdint.h>
+
+// Instrumentation behind --stats. It is only compiled with `-DNM_STATS` (`make STATS=1`),
+// otherwise every macro below expands to nothing and the default build pays nothing.
+
+typedef enum {
+  NM_PHASE_OPEN,     // open + elfu_new
+  NM_PHASE_SYMTAB,   // nm_process_symtab, decoding and classifying the symbols
+  NM_PHASE_SORT,
+  NM_PHASE_DISPLAY,  // formatting and writing
+  NM_PHASE_COUNT,
+} nm_phase_t;
+
+typedef struct {
+  uint64_t phase_ns[NM_PHASE_COUNT];
+  uint64_t get_section;  // elfu_get_section calls
+  uint64_t strptr;       // String table lookups, elfu_strptr included
+  uint64_t compares;     // Name comparisons performed by the sort
+  uint64_t written;      // Bytes written to the output
+} nm_stats_t;
+
+#ifdef NM_STATS
+
+extern thread_local nm_stats_t g_nm_stats;
+
+uint64_t nm_stats_now();
+
+/*!
+ * Write the counters of \a file on stderr as `key=value` pairs, then reset them.
+ */
+void nm_stats_report(const char* file);
+
+#define NM_STAT_INC(counter) (g_nm_stats.counter++)
+#define NM_STAT_ADD(counter, n) (g_nm_stats.counter += (n))
+#define NM_PHASE_BEGIN(phase) const uint64_t nm_phase_##phase = nm_stats_now()
+#define NM_PHASE_END(phase) \
+  (g_nm_stats.phase_ns[phase] += nm_stats_now() - nm_phase_##phase)
+
+#else
+
+#define NM_STAT_INC(counter) ((void)0)
+#define NM_STAT_ADD(counter, n) ((void)0)
+#define NM_PHASE_BEGIN(phase) ((void)0)
+#define NM_PHASE_END(phase) ((void)0)
+
+#endif
+
+#endif
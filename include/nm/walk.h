@@ -0,0 +1,25 @@
+#ifndef NM_WALK_H
+#define NM_WALK_H
+
+#include <ad/collections.h>
+
+#include "nm.h"
+
+// Recursive collection of the objects under a directory, for -R.
+
+// Called for each path that could not be walked, with the errno of the failure.
+typedef void (*nm_walk_warn_fn)(const char* path, int err);
+
+/*!
+ * Append the paths of the ELF files found under the directory \a dir to \a files. The
+ * order is deterministic: the entries of a directory are sorted by name, and a
+ * subdirectory is walked where it sorts. Symbolic links are not followed, and files are
+ * recognized from their first bytes whatever their name.
+ * @param files[in,out] The paths, to free with \c nm_walk_destroy.
+ * @param warn Reports the directories that can't be read, and allocation failures.
+ * @return Whether the whole tree was walked, the files found are kept either way.
+ */
+bool nm_walk(const char* dir, vector(char*) * files, nm_walk_warn_fn warn);
+void nm_walk_destroy(vector(char*) * files);
+
+#endif
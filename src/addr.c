@@ -0,0 +1,95 @@
+#include <nm/nm.h>
+#include <stdlib.h>
+
+// The starts are stored in Eytzinger (BFS) order: the search only walks down an
+// implicit binary tree, the first levels stay hot in cache and the children of a
+// node are contiguous, which allows prefetching several levels ahead.
+
+static size_t eytzinger_fill(nm_addr_index_t* idx,
+                             const nm_rkey_t* sorted,
+                             size_t i,
+                             const size_t k) {
+  if (k <= idx->count) {
+    i = eytzinger_fill(idx, sorted, i, 2 * k);
+    idx->starts[k] = sorted[i].value;
+    idx->ranks[k] = i++;
+    i = eytzinger_fill(idx, sorted, i, 2 * k + 1);
+  }
+  return i;
+}
+
+bool nm_addr_index_build(nm_addr_index_t* idx, const nm_symbol_t* symbols, const size_t n) {
+  *idx = (nm_addr_index_t){};
+
+  nm_rkey_t* sorted = malloc(n * sizeof(nm_rkey_t));
+  if (n && !sorted)
+    return false;
+
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    const auto s = &symbols[i];
+    const auto type = ELF64_ST_TYPE(s->internal.st_info);
+
+    if (s->internal.st_shndx == SHN_UNDEF || (type != STT_FUNC && type != STT_OBJECT))
+      continue;
+    sorted[count++] = (nm_rkey_t){.value = s->value, .index = i};
+  }
+
+  if (!radixsort(sorted, count))
+    goto err;
+
+  // Slot 0 is unused, the tree is rooted at 1.
+  idx->count = count;
+  idx->starts = malloc((count + 1) * sizeof(u64));
+  idx->ranks = malloc((count + 1) * sizeof(u32));
+  idx->ranges = malloc(count * sizeof(nm_range_t));
+  if (!idx->starts || !idx->ranks || (count && !idx->ranges))
+    goto err;
+
+  for (size_t i = 0; i < count; i++) {
+    const auto s = &symbols[sorted[i].index];
+    idx->ranges[i] = (nm_range_t){
+        .start = s->value,
+        .size = s->internal.st_size,
+        .symbol = s,
+    };
+  }
+  eytzinger_fill(idx, sorted, 0, 1);
+
+  free(sorted);
+  return true;
+
+err:
+  free(sorted);
+  nm_addr_index_destroy(idx);
+  return false;
+}
+
+const nm_range_t* nm_addr_index_find(const nm_addr_index_t* idx, const u64 addr) {
+  const auto n = idx->count;
+
+  size_t k = 1;
+  while (k <= n) {
+    // 16 u64 per two cache lines, the great-grandchildren of `k` start at 16k.
+    __builtin_prefetch(idx->starts + 16 * k);
+    k = 2 * k + (idx->starts[k] <= addr);
+  }
+  // Strip the trailing right turns, `k` is now the first start strictly above `addr`.
+  k >>= __builtin_ffsll((long long)~k);
+
+  const size_t above = (k == 0) ? n : idx->ranks[k];
+  if (above == 0)
+    return nullptr;
+
+  const auto r = &idx->ranges[above - 1];
+  if (addr == r->start || addr - r->start < r->size)
+    return r;
+  return nullptr;
+}
+
+void nm_addr_index_destroy(nm_addr_index_t* idx) {
+  free(idx->starts);
+  free(idx->ranks);
+  free(idx->ranges);
+  *idx = (nm_addr_index_t){};
+}
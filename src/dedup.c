@@ -0,0 +1,260 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <nm/dedup.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Objects are keyed by a 64 bits hash of their whole content and their size, a build id
+// would not do: strip keeps it while removing the symbols. The recorded outputs are kept
+// in an open addressing table, probed linearly. A hash is no proof, on a hit the file
+// the output was recorded from is read back and compared with the object.
+
+#define NM_DEDUP_READ_SIZE (64 * 1024)
+
+#define P1 0x9e3779b185ebca87ull
+#define P2 0xc2b2ae3d27d4eb4full
+#define P3 0x165667b19e3779f9ull
+#define P4 0x85ebca77c2b2ae63ull
+#define P5 0x27d4eb2f165667c5ull
+
+typedef struct {
+  bool used;
+  nm_dedup_key_t key;
+  const char* path;  // The file the output was recorded from
+  nm_dedup_entry_t entry;
+} dedup_slot_t;
+
+struct _nm_dedup_t {
+  dedup_slot_t* slots;
+  size_t capacity;  // A power of two
+  size_t count;
+  size_t total;  // Bytes recorded, including the recording in progress
+
+  // The recording in progress
+  bool recording;
+  bool dropped;  // Past NM_DEDUP_MAX_SIZE or out of memory, it won't be kept
+  nm_dedup_key_t key;
+  const char* path;
+  const nm_sink_t* next;
+  nm_sink_t sink;
+  u8* data;
+  size_t len;
+  size_t size;
+};
+
+static u64 rotl(const u64 v, const int n) {
+  return (v << n) | (v >> (64 - n));
+}
+
+static u64 hash_round(u64 acc, const u64 v) {
+  acc += v * P2;
+  return rotl(acc, 31) * P1;
+}
+
+static u64 load64(const u8* p) {
+  u64 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+u64 nm_hash(const void* data, const size_t size) {
+  const u8* p = data;
+  const u8* const end = p + size;
+  u64 h;
+
+  if (size >= 32) {
+    u64 v[4] = {P1 + P2, P2, 0, -P1};
+    for (; end - p >= 32; p += 32) {
+      for (size_t i = 0; i < 4; i++)
+        v[i] = hash_round(v[i], load64(p + i * 8));
+    }
+    h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+    for (size_t i = 0; i < 4; i++)
+      h = (h ^ hash_round(0, v[i])) * P1 + P4;
+  } else
+    h = P5;
+
+  h += size;
+  for (; end - p >= 8; p += 8)
+    h = rotl(h ^ hash_round(0, load64(p)), 27) * P1 + P4;
+  for (; p < end; p++)
+    h = rotl(h ^ (*p * P5), 11) * P1;
+
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  return h ^ (h >> 32);
+}
+
+nm_dedup_key_t nm_dedup_key(const elfu_t* obj) {
+  return (nm_dedup_key_t){.hash = nm_hash(obj->raw, obj->fsize), .size = obj->fsize};
+}
+
+nm_dedup_t* nm_dedup_new() {
+  return calloc(1, sizeof(nm_dedup_t));
+}
+
+static dedup_slot_t* dedup_slot(const nm_dedup_t* d, const nm_dedup_key_t key) {
+  const auto mask = d->capacity - 1;
+  for (auto i = key.hash & mask;; i = (i + 1) & mask) {
+    const auto slot = &d->slots[i];
+    if (!slot->used || (slot->key.hash == key.hash && slot->key.size == key.size))
+      return slot;
+  }
+}
+
+// Whether the file \a path holds exactly the \a size bytes of \a data.
+static bool dedup_same(const char* path, const u8* data, const size_t size) {
+  const auto fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  u8 buffer[NM_DEDUP_READ_SIZE];
+  size_t done = 0;
+  bool same = true;
+  while (same) {
+    const auto rd = read(fd, buffer, sizeof(buffer));
+    if (rd < 0 && errno == EINTR)
+      continue;
+    if (rd <= 0) {
+      same = rd == 0 && done == size;
+      break;
+    }
+    same = (size_t)rd <= size - done && memcmp(buffer, data + done, (size_t)rd) == 0;
+    done += (size_t)rd;
+  }
+
+  close(fd);
+  return same;
+}
+
+const nm_dedup_entry_t* nm_dedup_find(const nm_dedup_t* d,
+                                      const nm_dedup_key_t key,
+                                      const elfu_t* obj) {
+  if (d->count == 0)
+    return nullptr;
+  const auto slot = dedup_slot(d, key);
+  if (!slot->used || !dedup_same(slot->path, obj->raw, obj->fsize))
+    return nullptr;
+  return &slot->entry;
+}
+
+// Keep the table at most half full.
+static bool dedup_reserve(nm_dedup_t* d) {
+  if ((d->count + 1) * 2 <= d->capacity)
+    return true;
+
+  const auto old = *d;
+  d->capacity = old.capacity ? old.capacity * 2 : 64;
+  if ((d->slots = calloc(d->capacity, sizeof(dedup_slot_t))) == nullptr) {
+    d->slots = old.slots;
+    d->capacity = old.capacity;
+    return false;
+  }
+
+  for (size_t i = 0; i < old.capacity; i++) {
+    if (old.slots[i].used)
+      *dedup_slot(d, old.slots[i].key) = old.slots[i];
+  }
+  free(old.slots);
+  return true;
+}
+
+static void dedup_drop(nm_dedup_t* d) {
+  d->total -= d->len;
+  free(d->data);
+  d->data = nullptr;
+  d->len = 0;
+  d->size = 0;
+  d->dropped = true;
+}
+
+static bool dedup_write(void* ctx, const void* data, const size_t len) {
+  nm_dedup_t* d = ctx;
+
+  if (!d->next->write(d->next->ctx, data, len))
+    return false;
+  if (d->dropped)
+    return true;
+
+  if (d->total + len > NM_DEDUP_MAX_SIZE) {
+    dedup_drop(d);
+    return true;
+  }
+  if (d->len + len > d->size) {
+    auto size = d->size ? d->size : NM_OUT_SIZE;
+    while (size < d->len + len)
+      size *= 2;
+    u8* grown = realloc(d->data, size);
+    if (!grown) {
+      dedup_drop(d);
+      return true;
+    }
+    d->data = grown;
+    d->size = size;
+  }
+
+  memcpy(d->data + d->len, data, len);
+  d->len += len;
+  d->total += len;
+  return true;
+}
+
+const nm_sink_t* nm_dedup_record(nm_dedup_t* d,
+                                 const nm_dedup_key_t key,
+                                 const char* path,
+                                 const nm_sink_t* next) {
+  if (d->total >= NM_DEDUP_MAX_SIZE)
+    return nullptr;
+
+  d->recording = true;
+  d->dropped = false;
+  d->key = key;
+  d->path = path;
+  d->next = next;
+  d->sink = (nm_sink_t){.write = dedup_write, .ctx = d};
+  return &d->sink;
+}
+
+void nm_dedup_commit(nm_dedup_t* d, const int status, const bool keep) {
+  if (!d->recording)
+    return;
+  d->recording = false;
+
+  if (!keep || d->dropped || !dedup_reserve(d)) {
+    if (!d->dropped)
+      dedup_drop(d);
+    return;
+  }
+
+  const auto slot = dedup_slot(d, d->key);
+  if (slot->used)
+    free(slot->entry.data);
+  else
+    d->count++;
+  *slot = (dedup_slot_t){
+      .used = true,
+      .key = d->key,
+      .path = d->path,
+      .entry = {.data = d->data, .len = d->len, .status = status},
+  };
+
+  d->data = nullptr;
+  d->len = 0;
+  d->size = 0;
+}
+
+void nm_dedup_destroy(nm_dedup_t** d) {
+  if (!d || !*d)
+    return;
+
+  const auto dd = *d;
+  for (size_t i = 0; i < dd->capacity; i++)
+    free(dd->slots[i].entry.data);
+  free(dd->slots);
+  free(dd->data);
+  free(dd);
+  *d = nullptr;
+}
@@ -0,0 +1,2437 @@
+#include <nm/demangle.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A name is parsed into a tree of nodes following the Itanium C++ ABI grammar, then
+// printed the way libiberty (c++filt, nm -C) does. Substitutions and template
+// parameters refer to nodes parsed earlier, the tree is a DAG. Everything lives in the
+// demangler: names needing more nodes or a longer output are left mangled.
+
+#define DM_MAX_NODES 8192
+#define DM_MAX_SUBS 1024
+#define DM_MAX_FORWARD 32
+#define DM_MAX_DEPTH 256
+#define DM_MAX_STEPS (1 << 20)
+#define DM_MAX_OUTPUT (32 * 1024)
+
+#define DM_CACHE_SLOTS 4096
+#define DM_CACHE_SIZE (1024 * 1024)
+
+typedef enum {
+  DM_NAME,          // str
+  DM_BUILTIN,       // str, `n` is the builtin code
+  DM_NESTED,        // a::b
+  DM_TEMPLATE,      // a<b>
+  DM_LIST,          // a, b (next)
+  DM_STD,           // Standard substitution, `n` indexes g_std
+  DM_ABI_TAG,       // a[abi:str]
+  DM_CTOR,          // a
+  DM_DTOR,          // ~a
+  DM_OPERATOR,      // operator str
+  DM_CONVERSION,    // operator a
+  DM_LOCAL,         // a::b
+  DM_SPECIAL,       // str a
+  DM_CTOR_VTABLE,   // construction vtable for a-in-b
+  DM_ENCODING,      // c a(b) quals
+  DM_CLONE,         // a [clone str]
+  DM_QUAL,          // a quals
+  DM_POINTER,       // a*
+  DM_LREF,          // a&
+  DM_RREF,          // a&&
+  DM_FUNCTION,      // c (b) quals
+  DM_ARRAY,         // a [b]
+  DM_PTRMEM,        // b a::*
+  DM_POSTFIX,       // a str
+  DM_PACK,          // a, the elements of a template argument pack
+  DM_EXPANSION,     // a, expanded for each element of the pack it refers to
+  DM_TPARAM,        // a, the template argument it refers to in the arguments list c
+  DM_LAMBDA,        // {lambda(b)#n}
+  DM_UNNAMED,       // {unnamed type#n}
+  DM_DEFAULT_ARG,   // {default arg#n}::a
+  DM_LITERAL,       // (a)str
+  DM_UNARY,         // str a
+  DM_BINARY,        // a str b
+  DM_TERNARY,       // a ? b : c
+  DM_CAST,          // (a)b, or (a)(b) for an expression list (n)
+  DM_CALL,          // a(b)
+  DM_FUNCTION_PARAM,  // {parm#n}
+  DM_SIZEOF_PACK,   // sizeof...(a), the length of a when known
+  DM_WRAPPED,       // str(a)
+} dm_kind_t;
+
+enum {
+  DM_CONST = 1 << 0,
+  DM_VOLATILE = 1 << 1,
+  DM_RESTRICT = 1 << 2,
+  DM_NEGATIVE = 1 << 3,  // DM_LITERAL
+  DM_EXPANDED = 1 << 4,  // DM_STD, prints the full template
+  DM_NOEXCEPT = 1 << 5,  // DM_FUNCTION
+  DM_PINNED = 1 << 6,    // DM_TPARAM, referred to, keeps its arguments when substituted
+};
+
+typedef struct _dm_node_t {
+  u8 kind;
+  u8 flags;
+  u8 ref;  // 1 for `&`, 2 for `&&`
+  u32 n;
+  const char* str;
+  size_t len;
+  struct _dm_node_t* a;
+  struct _dm_node_t* b;
+  struct _dm_node_t* c;
+} dm_node_t;
+
+// What the encoding needs to know about its name.
+typedef struct {
+  u8 flags;  // cv-qualifiers of a member function
+  u8 ref;
+  bool template_args;  // The name ends with template arguments
+  bool ctor_dtor_conv;
+} dm_name_state_t;
+
+typedef struct {
+  u32 hash;
+  u32 generation;
+  u32 offset;  // "mangled\0demangled\0" in the arena
+  u32 len;     // Mangled name length
+} dm_cache_slot_t;
+
+typedef struct _nm_demangler_t {
+  const char* p;
+  const char* end;
+  size_t depth;
+
+  dm_node_t nodes[DM_MAX_NODES];
+  size_t nnodes;
+  dm_node_t* subs[DM_MAX_SUBS];
+  size_t nsubs;
+  dm_node_t* tparams;  // DM_LIST of the template arguments T_ refers to
+  dm_node_t* forward[DM_MAX_FORWARD];
+  size_t nforward;
+
+  char out[DM_MAX_OUTPUT];
+  size_t len;
+  char last;  // Last character printed, kept when a separator is rolled back
+  bool failed;
+  int pack_index;
+  u32 lambda_args;  // Printing the parameters of a closure, T_ is `auto:1`
+  size_t steps;
+
+  u32 generation;
+  size_t used;
+  dm_cache_slot_t slots[DM_CACHE_SLOTS];
+  char arena[DM_CACHE_SIZE];
+} nm_demangler_t;
+
+static const struct {
+  char code;
+  const char* name;
+  const char* expanded;
+  const char* base;
+} g_std[] = {
+    {'a', "std::allocator", "std::allocator", "allocator"},
+    {'b', "std::basic_string", "std::basic_string", "basic_string"},
+    {'s', "std::string", "std::basic_string<char, std::char_traits<char>, std::allocator<char> >",
+     "basic_string"},
+    {'i', "std::istream", "std::basic_istream<char, std::char_traits<char> >",
+     "basic_istream"},
+    {'o', "std::ostream", "std::basic_ostream<char, std::char_traits<char> >",
+     "basic_ostream"},
+    {'d', "std::iostream", "std::basic_iostream<char, std::char_traits<char> >",
+     "basic_iostream"},
+};
+
+static const char* g_builtins[26] = {
+    ['a' - 'a'] = "signed char",
+    ['b' - 'a'] = "bool",
+    ['c' - 'a'] = "char",
+    ['d' - 'a'] = "double",
+    ['e' - 'a'] = "long double",
+    ['f' - 'a'] = "float",
+    ['g' - 'a'] = "__float128",
+    ['h' - 'a'] = "unsigned char",
+    ['i' - 'a'] = "int",
+    ['j' - 'a'] = "unsigned int",
+    ['l' - 'a'] = "long",
+    ['m' - 'a'] = "unsigned long",
+    ['n' - 'a'] = "__int128",
+    ['o' - 'a'] = "unsigned __int128",
+    ['s' - 'a'] = "short",
+    ['t' - 'a'] = "unsigned short",
+    ['v' - 'a'] = "void",
+    ['w' - 'a'] = "wchar_t",
+    ['x' - 'a'] = "long long",
+    ['y' - 'a'] = "unsigned long long",
+    ['z' - 'a'] = "...",
+};
+
+// `D` prefixed builtins.
+static const char* g_dbuiltins[26] = {
+    ['a' - 'a'] = "auto",
+    ['c' - 'a'] = "decltype(auto)",
+    ['d' - 'a'] = "decimal64",
+    ['e' - 'a'] = "decimal128",
+    ['f' - 'a'] = "decimal32",
+    ['h' - 'a'] = "half",
+    ['i' - 'a'] = "char32_t",
+    ['n' - 'a'] = "decltype(nullptr)",
+    ['s' - 'a'] = "char16_t",
+    ['u' - 'a'] = "char8_t",
+};
+
+static const struct {
+  char code[3];
+  const char* name;
+  u8 arity;
+} g_operators[] = {
+    {"aN", "&=", 2},      {"aS", "=", 2},        {"aa", "&&", 2},      {"ad", "&", 1},
+    {"an", "&", 2},       {"at", "alignof ", 1}, {"aw", "co_await ", 1}, {"az", "alignof ", 1},
+    {"cl", "()", 2},      {"cm", ",", 2},        {"co", "~", 1},       {"dV", "/=", 2},
+    {"da", "delete[] ", 1}, {"de", "*", 1},      {"dl", "delete ", 1}, {"ds", ".*", 2},
+    {"dt", ".", 2},       {"dv", "/", 2},        {"eO", "^=", 2},      {"eo", "^", 2},
+    {"eq", "==", 2},      {"ge", ">=", 2},       {"gt", ">", 2},       {"ix", "[]", 2},
+    {"lS", "<<=", 2},     {"le", "<=", 2},       {"ls", "<<", 2},      {"lt", "<", 2},
+    {"mI", "-=", 2},      {"mL", "*=", 2},       {"mi", "-", 2},       {"ml", "*", 2},
+    {"mm", "--", 1},      {"na", "new[]", 3},    {"ne", "!=", 2},      {"ng", "-", 1},
+    {"nt", "!", 1},       {"nw", "new", 3},      {"oR", "|=", 2},      {"oo", "||", 2},
+    {"or", "|", 2},       {"pL", "+=", 2},       {"pl", "+", 2},       {"pm", "->*", 2},
+    {"pp", "++", 1},      {"ps", "+", 1},        {"pt", "->", 2},      {"qu", "?", 3},
+    {"rM", "%=", 2},      {"rS", ">>=", 2},      {"rm", "%", 2},       {"rs", ">>", 2},
+    {"ss", "<=>", 2},     {"st", "sizeof ", 1},  {"sz", "sizeof ", 1}, {"te", "typeid ", 1},
+    {"ti", "typeid ", 1}, {"tw", "throw ", 1},
+};
+
+#define dm_peek(d) (((d)->p < (d)->end) ? *(d)->p : 0)
+#define dm_peek2(d) (((d)->p + 1 < (d)->end) ? (d)->p[1] : 0)
+#define dm_is_digit(c) ((c) >= '0' && (c) <= '9')
+#define dm_is_lower(c) ((c) >= 'a' && (c) <= 'z')
+
+static bool dm_consume(nm_demangler_t* d, const char c) {
+  if (dm_peek(d) != c)
+    return false;
+  d->p++;
+  return true;
+}
+
+static dm_node_t* dm_new(nm_demangler_t* d, const dm_kind_t kind) {
+  if (d->nnodes == DM_MAX_NODES)
+    return nullptr;
+  const auto node = &d->nodes[d->nnodes++];
+  *node = (dm_node_t){.kind = (u8)kind};
+  return node;
+}
+
+static dm_node_t* dm_make(nm_demangler_t* d, const dm_kind_t kind, dm_node_t* a, dm_node_t* b) {
+  if (!a)
+    return nullptr;
+  const auto node = dm_new(d, kind);
+  if (node) {
+    node->a = a;
+    node->b = b;
+  }
+  return node;
+}
+
+static dm_node_t* dm_name(nm_demangler_t* d, const char* str, const size_t len) {
+  const auto node = dm_new(d, DM_NAME);
+  if (node) {
+    node->str = str;
+    node->len = len;
+  }
+  return node;
+}
+
+static dm_node_t* dm_special(nm_demangler_t* d, const char* prefix, dm_node_t* a) {
+  const auto node = dm_make(d, DM_SPECIAL, a, nullptr);
+  if (node) {
+    node->str = prefix;
+    node->len = strlen(prefix);
+  }
+  return node;
+}
+
+static bool dm_push_sub(nm_demangler_t* d, dm_node_t* node) {
+  if (!node || d->nsubs == DM_MAX_SUBS)
+    return false;
+  d->subs[d->nsubs++] = node;
+  return true;
+}
+
+// Append `node` to the list ending at `*tail`.
+static bool dm_append(nm_demangler_t* d, dm_node_t** head, dm_node_t** tail, dm_node_t* node) {
+  const auto item = dm_make(d, DM_LIST, node, nullptr);
+  if (!item)
+    return false;
+  if (*tail)
+    (*tail)->b = item;
+  else
+    *head = item;
+  *tail = item;
+  return true;
+}
+
+/* parser */
+
+static dm_node_t* dm_parse_type(nm_demangler_t* d);
+static dm_node_t* dm_parse_encoding(nm_demangler_t* d);
+static dm_node_t* dm_parse_name(nm_demangler_t* d, dm_name_state_t* st);
+static dm_node_t* dm_parse_expression(nm_demangler_t* d);
+static dm_node_t* dm_parse_template_args(nm_demangler_t* d, bool tag);
+
+static bool dm_parse_number(nm_demangler_t* d, size_t* n, bool* negative) {
+  const auto neg = dm_consume(d, 'n');
+  if (negative)
+    *negative = neg;
+  else if (neg)
+    return false;
+
+  if (!dm_is_digit(dm_peek(d)))
+    return false;
+
+  size_t v = 0;
+  while (dm_is_digit(dm_peek(d))) {
+    if (v > (SIZE_MAX - 9) / 10)
+      return false;
+    v = v * 10 + (size_t)(*d->p++ - '0');
+  }
+  *n = v;
+  return true;
+}
+
+// Digits span of a number, kept as text for printing.
+static dm_node_t* dm_parse_number_name(nm_demangler_t* d) {
+  const auto start = d->p;
+  size_t n;
+  if (!dm_parse_number(d, &n, nullptr))
+    return nullptr;
+  return dm_name(d, start, (size_t)(d->p - start));
+}
+
+// <seq-id> _, base 36 with digits and upper case letters. `_` alone is 0.
+static bool dm_parse_seq_id(nm_demangler_t* d, size_t* id) {
+  if (dm_consume(d, '_')) {
+    *id = 0;
+    return true;
+  }
+
+  size_t v = 0;
+  for (;;) {
+    const auto c = dm_peek(d);
+    if (dm_is_digit(c))
+      v = v * 36 + (size_t)(c - '0');
+    else if (c >= 'A' && c <= 'Z')
+      v = v * 36 + (size_t)(c - 'A' + 10);
+    else
+      break;
+    if (v > DM_MAX_SUBS)
+      return false;
+    d->p++;
+  }
+  if (!dm_consume(d, '_'))
+    return false;
+  *id = v + 1;
+  return true;
+}
+
+static dm_node_t* dm_parse_source_name(nm_demangler_t* d) {
+  size_t len;
+  if (!dm_parse_number(d, &len, nullptr) || len == 0 || (size_t)(d->end - d->p) < len)
+    return nullptr;
+
+  const auto name = d->p;
+  d->p += len;
+
+  // GCC's anonymous namespaces, `_GLOBAL_.N`, `_GLOBAL__N` or `_GLOBAL_$N`.
+  if (len >= 10 && memcmp(name, "_GLOBAL_", 8) == 0 &&
+      (name[8] == '.' || name[8] == '_' || name[8] == '$') && name[9] == 'N') {
+    constexpr char anonymous[] = "(anonymous namespace)";
+    return dm_name(d, anonymous, sizeof(anonymous) - 1);
+  }
+  return dm_name(d, name, len);
+}
+
+// Template parameters are printed with the arguments of the function template they
+// appear in, a substitution of a type using them may refer to other arguments than when
+// it was parsed. Copies the parts of the tree that must be bound to the current ones.
+static dm_node_t* dm_rebind(nm_demangler_t* d, dm_node_t* node, const size_t depth) {
+  if (!node || depth > DM_MAX_DEPTH || ++d->steps > DM_MAX_STEPS)
+    return node;
+
+  if (node->kind == DM_TPARAM) {
+    if (node->c == d->tparams || !d->tparams || (node->flags & DM_PINNED))
+      return node;
+
+    auto arg = d->tparams;
+    for (size_t i = 0; arg && i < node->n; i++)
+      arg = arg->b;
+    if (!arg)
+      return node;
+
+    const auto copy = dm_new(d, DM_TPARAM);
+    if (!copy)
+      return node;
+    *copy = *node;
+    copy->a = arg->a;
+    copy->c = d->tparams;
+    return copy;
+  }
+
+  // Function templates bind their own parameters.
+  if (node->kind == DM_ENCODING && node->a->kind == DM_TEMPLATE)
+    return node;
+
+  const auto a = dm_rebind(d, node->a, depth + 1);
+  const auto b = dm_rebind(d, node->b, depth + 1);
+  const auto c = dm_rebind(d, node->c, depth + 1);
+  if (a == node->a && b == node->b && c == node->c)
+    return node;
+
+  const auto copy = dm_new(d, (dm_kind_t)node->kind);
+  if (!copy)
+    return node;
+  *copy = *node;
+  copy->a = a;
+  copy->b = b;
+  copy->c = c;
+  return copy;
+}
+
+static dm_node_t* dm_parse_substitution(nm_demangler_t* d) {
+  if (!dm_consume(d, 'S'))
+    return nullptr;
+
+  const auto c = dm_peek(d);
+  if (dm_is_lower(c)) {
+    for (size_t i = 0; i < sizeof(g_std) / sizeof(g_std[0]); i++) {
+      if (g_std[i].code == c) {
+        d->p++;
+        const auto node = dm_new(d, DM_STD);
+        if (node)
+          node->n = (u32)i;
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+  size_t id;
+  if (!dm_parse_seq_id(d, &id) || id >= d->nsubs)
+    return nullptr;
+  return dm_rebind(d, d->subs[id], 0);
+}
+
+// T_ is the first template argument, T<n>_ the (n + 2)th.
+static dm_node_t* dm_parse_template_param(nm_demangler_t* d) {
+  if (!dm_consume(d, 'T'))
+    return nullptr;
+
+  size_t index = 0;
+  if (!dm_consume(d, '_')) {
+    if (!dm_parse_number(d, &index, nullptr) || !dm_consume(d, '_'))
+      return nullptr;
+    index++;
+  }
+
+  const auto node = dm_new(d, DM_TPARAM);
+  if (!node)
+    return nullptr;
+  node->n = (u32)index;
+  node->c = d->tparams;
+
+  auto arg = d->tparams;
+  for (size_t i = 0; arg && i < index; i++)
+    arg = arg->b;
+  if (arg)
+    node->a = arg->a;
+  else {
+    // A forward reference, the conversion operator of a function template refers to
+    // arguments that come after it. Resolved once they are parsed.
+    if (d->nforward == DM_MAX_FORWARD)
+      return nullptr;
+    d->forward[d->nforward++] = node;
+  }
+  return node;
+}
+
+static void dm_resolve_forward(nm_demangler_t* d) {
+  size_t kept = 0;
+  for (size_t i = 0; i < d->nforward; i++) {
+    const auto node = d->forward[i];
+
+    auto arg = d->tparams;
+    for (size_t j = 0; arg && j < node->n; j++)
+      arg = arg->b;
+    if (arg) {
+      node->a = arg->a;
+      node->c = d->tparams;
+    } else
+      d->forward[kept++] = node;
+  }
+  d->nforward = kept;
+}
+
+static dm_node_t* dm_parse_template_arg(nm_demangler_t* d) {
+  switch (dm_peek(d)) {
+    case 'X': {
+      d->p++;
+      const auto expr = dm_parse_expression(d);
+      return (expr && dm_consume(d, 'E')) ? expr : nullptr;
+    }
+    case 'L':
+      return dm_parse_expression(d);
+    case 'J': {
+      d->p++;
+      dm_node_t* head = nullptr;
+      dm_node_t* tail = nullptr;
+      while (!dm_consume(d, 'E')) {
+        const auto arg = dm_parse_template_arg(d);
+        if (!arg || !dm_append(d, &head, &tail, arg))
+          return nullptr;
+      }
+      const auto pack = dm_new(d, DM_PACK);
+      if (pack)
+        pack->a = head;
+      return pack;
+    }
+    default:
+      return dm_parse_type(d);
+  }
+}
+
+// When `tag` is set, these are the arguments of the encoding's name and the template
+// parameters refer to them.
+static dm_node_t* dm_parse_template_args(nm_demangler_t* d, const bool tag) {
+  if (!dm_consume(d, 'I'))
+    return nullptr;
+
+  // The arguments themselves refer to the enclosing template.
+  dm_node_t* head = nullptr;
+  dm_node_t* tail = nullptr;
+  while (!dm_consume(d, 'E')) {
+    const auto arg = dm_parse_template_arg(d);
+    if (!arg || !dm_append(d, &head, &tail, arg))
+      return nullptr;
+  }
+  if (!head)
+    return nullptr;
+
+  if (tag) {
+    d->tparams = head;
+    dm_resolve_forward(d);
+  }
+  return head;
+}
+
+static dm_node_t* dm_parse_operator(nm_demangler_t* d, dm_name_state_t* st) {
+  const auto c0 = dm_peek(d);
+  const auto c1 = dm_peek2(d);
+
+  if (c0 == 'c' && c1 == 'v') {
+    d->p += 2;
+    if (st)
+      st->ctor_dtor_conv = true;
+    return dm_make(d, DM_CONVERSION, dm_parse_type(d), nullptr);
+  }
+  if (c0 == 'l' && c1 == 'i') {
+    d->p += 2;
+    const auto name = dm_parse_source_name(d);
+    const auto node = dm_make(d, DM_OPERATOR, name, nullptr);
+    if (node) {
+      node->str = "\"\" ";
+      node->len = 3;
+    }
+    return node;
+  }
+  if (c0 == 'v' && dm_is_digit(c1)) {
+    d->p += 2;
+    const auto name = dm_parse_source_name(d);
+    const auto node = dm_make(d, DM_OPERATOR, name, nullptr);
+    if (node) {
+      node->str = " ";
+      node->len = 1;
+    }
+    return node;
+  }
+
+  for (size_t i = 0; i < sizeof(g_operators) / sizeof(g_operators[0]); i++) {
+    if (g_operators[i].code[0] == c0 && g_operators[i].code[1] == c1) {
+      d->p += 2;
+      const auto node = dm_new(d, DM_OPERATOR);
+      if (node) {
+        node->str = g_operators[i].name;
+        node->len = strlen(node->str);
+      }
+      return node;
+    }
+  }
+  return nullptr;
+}
+
+// The name constructors and destructors are printed with.
+static dm_node_t* dm_base_name(nm_demangler_t* d, dm_node_t* node) {
+  while (node) {
+    switch (node->kind) {
+      case DM_NESTED:
+        // Unnamed types and closures are named after the enclosing scope.
+        node = (node->b->kind == DM_UNNAMED || node->b->kind == DM_LAMBDA) ? node->a
+                                                                             : node->b;
+        break;
+      case DM_LOCAL:
+        node = node->b;
+        break;
+      case DM_TEMPLATE:
+      case DM_ABI_TAG:
+        node = node->a;
+        break;
+      case DM_STD:
+        return dm_name(d, g_std[node->n].base, strlen(g_std[node->n].base));
+      default:
+        return node;
+    }
+  }
+  return nullptr;
+}
+
+// {lambda(params)#n} and {unnamed type#n}, the number is absent for the first one.
+static bool dm_parse_discriminator_number(nm_demangler_t* d, u32* n) {
+  size_t v = 0;
+  if (!dm_consume(d, '_')) {
+    if (!dm_parse_number(d, &v, nullptr) || !dm_consume(d, '_'))
+      return false;
+    v++;
+  }
+  *n = (u32)v + 1;
+  return true;
+}
+
+static dm_node_t* dm_parse_unnamed(nm_demangler_t* d) {
+  d->p++;  // U
+
+  if (dm_consume(d, 't')) {
+    const auto node = dm_new(d, DM_UNNAMED);
+    if (!node || !dm_parse_discriminator_number(d, &node->n))
+      return nullptr;
+    return node;
+  }
+  if (!dm_consume(d, 'l'))
+    return nullptr;
+
+  dm_node_t* head = nullptr;
+  dm_node_t* tail = nullptr;
+  if (dm_peek(d) == 'v' && dm_peek2(d) == 'E')
+    d->p++;
+  while (!dm_consume(d, 'E')) {
+    const auto type = dm_parse_type(d);
+    if (!type || !dm_append(d, &head, &tail, type))
+      return nullptr;
+  }
+
+  const auto node = dm_new(d, DM_LAMBDA);
+  if (!node || !dm_parse_discriminator_number(d, &node->n))
+    return nullptr;
+  node->b = head;
+  return node;
+}
+
+static dm_node_t* dm_parse_unqualified_name(nm_demangler_t* d,
+                                            dm_name_state_t* st,
+                                            dm_node_t* scope) {
+  dm_node_t* node = nullptr;
+
+  // Internal linkage, GCC extension
+  dm_consume(d, 'L');
+
+  const auto c = dm_peek(d);
+  const auto c1 = dm_peek2(d);
+  if (dm_is_digit(c))
+    node = dm_parse_source_name(d);
+  else if (c == 'C' || (c == 'D' && c1 >= '0' && c1 <= '5')) {
+    if (!scope)
+      return nullptr;
+    d->p++;
+    const auto inheriting = (c == 'C') && dm_consume(d, 'I');
+    if (!(dm_peek(d) >= '0' && dm_peek(d) <= '5'))
+      return nullptr;
+    d->p++;
+    if (inheriting && !dm_parse_type(d))
+      return nullptr;
+
+    node = dm_make(d, (c == 'C') ? DM_CTOR : DM_DTOR, dm_base_name(d, scope), nullptr);
+    if (st)
+      st->ctor_dtor_conv = true;
+  } else if (c == 'U')
+    node = dm_parse_unnamed(d);
+  else if (c == 'D' && c1 == 'C') {
+    // Structured binding, [a, b]
+    d->p += 2;
+    dm_node_t* head = nullptr;
+    dm_node_t* tail = nullptr;
+    while (!dm_consume(d, 'E')) {
+      const auto name = dm_parse_source_name(d);
+      if (!name || !dm_append(d, &head, &tail, name))
+        return nullptr;
+    }
+    node = dm_make(d, DM_WRAPPED, head, nullptr);
+    if (node) {
+      node->str = "[";
+      node->len = 1;
+    }
+  } else if (dm_is_lower(c))
+    node = dm_parse_operator(d, st);
+
+  while (node && dm_consume(d, 'B')) {
+    const auto tag = dm_parse_source_name(d);
+    if (!tag)
+      return nullptr;
+    node = dm_make(d, DM_ABI_TAG, node, nullptr);
+    if (node) {
+      node->str = tag->str;
+      node->len = tag->len;
+    }
+  }
+  return node;
+}
+
+static dm_node_t* dm_parse_decltype(nm_demangler_t* d) {
+  d->p += 2;  // Dt or DT
+  const auto expr = dm_parse_expression(d);
+  if (!expr || !dm_consume(d, 'E'))
+    return nullptr;
+
+  const auto node = dm_make(d, DM_WRAPPED, expr, nullptr);
+  if (node) {
+    node->str = "decltype (";
+    node->len = 10;
+  }
+  return node;
+}
+
+static dm_node_t* dm_parse_nested_name(nm_demangler_t* d, dm_name_state_t* st) {
+  if (!dm_consume(d, 'N'))
+    return nullptr;
+
+  u8 flags = 0;
+  if (dm_consume(d, 'r'))
+    flags |= DM_RESTRICT;
+  if (dm_consume(d, 'V'))
+    flags |= DM_VOLATILE;
+  if (dm_consume(d, 'K'))
+    flags |= DM_CONST;
+  u8 ref = 0;
+  if (dm_consume(d, 'R'))
+    ref = 1;
+  else if (dm_consume(d, 'O'))
+    ref = 2;
+  if (st) {
+    st->flags = flags;
+    st->ref = ref;
+  }
+
+  dm_node_t* name = nullptr;
+  bool pushed = false;
+  while (!dm_consume(d, 'E')) {
+    const auto c = dm_peek(d);
+    pushed = false;
+
+    if (c == 'M') {
+      // Closure prefix of a lambda in a data member initializer.
+      if (!name)
+        return nullptr;
+      d->p++;
+      continue;
+    }
+
+    if (c == 'S') {
+      if (name)
+        return nullptr;
+      if (dm_peek2(d) == 't') {
+        d->p += 2;
+        name = dm_name(d, "std", 3);
+      } else if ((name = dm_parse_substitution(d)) != nullptr && name->kind == DM_STD) {
+        // Constructors of the abbreviated templates show the full template.
+        const auto next = dm_peek(d);
+        if (next == 'C' || (next == 'D' && dm_peek2(d) >= '0' && dm_peek2(d) <= '5')) {
+          const auto expanded = dm_new(d, DM_STD);
+          if (!expanded)
+            return nullptr;
+          *expanded = *name;
+          expanded->flags |= DM_EXPANDED;
+          name = expanded;
+        }
+      }
+      if (!name)
+        return nullptr;
+      continue;
+    }
+
+    if (c == 'I') {
+      if (!name)
+        return nullptr;
+      const auto args = dm_parse_template_args(d, st != nullptr);
+      name = dm_make(d, DM_TEMPLATE, name, args);
+      if (!args || !name)
+        return nullptr;
+      if (st)
+        st->template_args = true;
+    } else if (c == 'T') {
+      if (name)
+        return nullptr;
+      name = dm_parse_template_param(d);
+    } else if (c == 'D' && (dm_peek2(d) == 't' || dm_peek2(d) == 'T')) {
+      if (name)
+        return nullptr;
+      name = dm_parse_decltype(d);
+    } else {
+      const auto component = dm_parse_unqualified_name(d, st, name);
+      name = name ? dm_make(d, DM_NESTED, name, component) : component;
+      if (!component || !name)
+        return nullptr;
+      if (st)
+        st->template_args = false;
+    }
+
+    if (!dm_push_sub(d, name))
+      return nullptr;
+    pushed = true;
+  }
+
+  // The complete name is not a substitution candidate, only its prefixes.
+  if (!name)
+    return nullptr;
+  if (pushed)
+    d->nsubs--;
+  return name;
+}
+
+// Digits, possibly none.
+static size_t dm_parse_digits(nm_demangler_t* d) {
+  size_t v = 0;
+  while (dm_is_digit(dm_peek(d)) && v <= (SIZE_MAX - 9) / 10)
+    v = v * 10 + (size_t)(*d->p++ - '0');
+  return v;
+}
+
+// _ <digit> | __ <number> _, libiberty accepts a missing number.
+static bool dm_parse_discriminator(nm_demangler_t* d) {
+  if (!dm_consume(d, '_'))
+    return true;
+
+  const auto wide = dm_consume(d, '_');
+  if (dm_parse_digits(d) >= 10 && wide)
+    return dm_consume(d, '_');
+  return true;
+}
+
+static dm_node_t* dm_parse_local_name(nm_demangler_t* d, dm_name_state_t* st) {
+  if (!dm_consume(d, 'Z'))
+    return nullptr;
+
+  const auto encoding = dm_parse_encoding(d);
+  if (!encoding || !dm_consume(d, 'E'))
+    return nullptr;
+
+  dm_node_t* entity;
+  if (dm_consume(d, 's')) {
+    entity = dm_name(d, "string literal", 14);
+    if (!dm_parse_discriminator(d))
+      return nullptr;
+  } else {
+    // Entity in the scope of a default argument, numbered from the last parameter.
+    dm_node_t* arg = nullptr;
+    if (dm_consume(d, 'd')) {
+      size_t n = 0;
+      if (!dm_consume(d, '_')) {
+        if (!dm_parse_number(d, &n, nullptr) || !dm_consume(d, '_'))
+          return nullptr;
+        n++;
+      }
+      if ((arg = dm_new(d, DM_DEFAULT_ARG)) == nullptr)
+        return nullptr;
+      arg->n = (u32)(n + 1);
+    }
+    entity = dm_parse_name(d, st);
+    if (!entity || !dm_parse_discriminator(d))
+      return nullptr;
+    if (arg) {
+      arg->a = entity;
+      entity = arg;
+    }
+  }
+
+  // The return type of the enclosing function is not printed.
+  if (encoding->kind == DM_ENCODING)
+    encoding->c = nullptr;
+  return dm_make(d, DM_LOCAL, encoding, entity);
+}
+
+static dm_node_t* dm_parse_name(nm_demangler_t* d, dm_name_state_t* st) {
+  if (++d->depth > DM_MAX_DEPTH)
+    return nullptr;
+
+  dm_node_t* name = nullptr;
+  const auto c = dm_peek(d);
+
+  if (c == 'N')
+    name = dm_parse_nested_name(d, st);
+  else if (c == 'Z')
+    name = dm_parse_local_name(d, st);
+  else if (c == 'S' && dm_peek2(d) != 't') {
+    // A substitution can only name a template here.
+    const auto sub = dm_parse_substitution(d);
+    const auto args = dm_parse_template_args(d, st != nullptr);
+    name = dm_make(d, DM_TEMPLATE, sub, args);
+    if (!args)
+      name = nullptr;
+    if (st)
+      st->template_args = true;
+  } else {
+    if (c == 'S') {
+      d->p += 2;
+      const auto std = dm_name(d, "std", 3);
+      name = dm_make(d, DM_NESTED, std, dm_parse_unqualified_name(d, st, nullptr));
+      if (name && !name->b)
+        name = nullptr;
+    } else
+      name = dm_parse_unqualified_name(d, st, nullptr);
+
+    if (st)
+      st->template_args = false;
+    if (name && dm_peek(d) == 'I') {
+      if (!dm_push_sub(d, name))
+        return nullptr;
+      const auto args = dm_parse_template_args(d, st != nullptr);
+      name = args ? dm_make(d, DM_TEMPLATE, name, args) : nullptr;
+      if (st)
+        st->template_args = true;
+    }
+  }
+
+  d->depth--;
+  return name;
+}
+
+static dm_node_t* dm_parse_function_type(nm_demangler_t* d) {
+  if (!dm_consume(d, 'F'))
+    return nullptr;
+  dm_consume(d, 'Y');
+
+  const auto node = dm_new(d, DM_FUNCTION);
+  if (!node || (node->c = dm_parse_type(d)) == nullptr)
+    return nullptr;
+
+  dm_node_t* tail = nullptr;
+  for (;;) {
+    const auto c = dm_peek(d);
+    if (c == 'E')
+      break;
+    if ((c == 'R' || c == 'O') && dm_peek2(d) == 'E') {
+      node->ref = (c == 'R') ? 1 : 2;
+      d->p++;
+      break;
+    }
+    if (c == 'v' && dm_peek2(d) == 'E') {
+      d->p++;
+      continue;
+    }
+
+    const auto param = dm_parse_type(d);
+    if (!param || !dm_append(d, &node->b, &tail, param))
+      return nullptr;
+  }
+
+  return dm_consume(d, 'E') ? node : nullptr;
+}
+
+static dm_node_t* dm_parse_array_type(nm_demangler_t* d) {
+  if (!dm_consume(d, 'A'))
+    return nullptr;
+
+  dm_node_t* dimension = nullptr;
+  if (dm_is_digit(dm_peek(d)))
+    dimension = dm_parse_number_name(d);
+  else if (dm_peek(d) != '_')
+    dimension = dm_parse_expression(d);
+  else
+    dimension = dm_name(d, "", 0);
+  if (!dimension || !dm_consume(d, '_'))
+    return nullptr;
+
+  const auto node = dm_new(d, DM_ARRAY);
+  if (!node || (node->a = dm_parse_type(d)) == nullptr)
+    return nullptr;
+  node->b = dimension;
+  return node;
+}
+
+static dm_node_t* dm_parse_qualified_type(nm_demangler_t* d) {
+  u8 flags = 0;
+  if (dm_consume(d, 'r'))
+    flags |= DM_RESTRICT;
+  if (dm_consume(d, 'V'))
+    flags |= DM_VOLATILE;
+  if (dm_consume(d, 'K'))
+    flags |= DM_CONST;
+  if (dm_peek(d) == 'D' && dm_peek2(d) == 'o') {
+    d->p += 2;
+    flags |= DM_NOEXCEPT;
+  }
+
+  // The qualifiers of a function type are part of it, the unqualified type is not a
+  // substitution of its own.
+  const auto inner = (dm_peek(d) == 'F') ? dm_parse_function_type(d) : dm_parse_type(d);
+  if (!inner)
+    return nullptr;
+
+  // Qualifiers of a function type are the member function qualifiers.
+  if (inner->kind == DM_FUNCTION) {
+    const auto node = dm_new(d, DM_FUNCTION);
+    if (node) {
+      *node = *inner;
+      node->flags |= flags;
+    }
+    return node;
+  }
+
+  const auto node = dm_make(d, DM_QUAL, inner, nullptr);
+  if (node)
+    node->flags = flags;
+  return node;
+}
+
+static dm_node_t* dm_builtin(nm_demangler_t* d, const char* name, const char code) {
+  const auto node = dm_new(d, DM_BUILTIN);
+  if (node) {
+    node->str = name;
+    node->len = strlen(name);
+    node->n = (u8)code;
+  }
+  return node;
+}
+
+static dm_node_t* dm_parse_type(nm_demangler_t* d) {
+  if (++d->depth > DM_MAX_DEPTH)
+    return nullptr;
+
+  dm_node_t* type = nullptr;
+  const auto c = dm_peek(d);
+  const auto c1 = dm_peek2(d);
+
+  switch (c) {
+    case 'r':
+    case 'V':
+    case 'K':
+      type = dm_parse_qualified_type(d);
+      break;
+    case 'P':
+    case 'R':
+    case 'O':
+      d->p++;
+      type = dm_make(d, (c == 'P') ? DM_POINTER : (c == 'R') ? DM_LREF : DM_RREF,
+                     dm_parse_type(d), nullptr);
+      if (type && c != 'P' && type->a->kind == DM_TPARAM)
+        type->a->flags |= DM_PINNED;
+      break;
+    case 'C':
+    case 'G':
+      d->p++;
+      type = dm_make(d, DM_POSTFIX, dm_parse_type(d), nullptr);
+      if (type) {
+        type->str = (c == 'C') ? " _Complex" : " _Imaginary";
+        type->len = strlen(type->str);
+      }
+      break;
+    case 'F':
+      type = dm_parse_function_type(d);
+      break;
+    case 'A':
+      type = dm_parse_array_type(d);
+      break;
+    case 'M': {
+      d->p++;
+      const auto cls = dm_parse_type(d);
+      type = dm_make(d, DM_PTRMEM, cls, cls ? dm_parse_type(d) : nullptr);
+      if (type && !type->b)
+        type = nullptr;
+      break;
+    }
+    case 'T':
+      if (c1 == 's' || c1 == 'u' || c1 == 'e') {
+        // Elaborated type specifier
+        d->p += 2;
+        type = dm_parse_name(d, nullptr);
+        break;
+      }
+      type = dm_parse_template_param(d);
+      if (type && dm_peek(d) == 'I') {
+        // Template template parameter
+        if (!dm_push_sub(d, type))
+          return nullptr;
+        const auto args = dm_parse_template_args(d, false);
+        type = args ? dm_make(d, DM_TEMPLATE, type, args) : nullptr;
+      }
+      break;
+    case 'S':
+      if (c1 != 't') {
+        const auto sub = dm_parse_substitution(d);
+        if (sub && dm_peek(d) == 'I') {
+          const auto args = dm_parse_template_args(d, false);
+          type = args ? dm_make(d, DM_TEMPLATE, sub, args) : nullptr;
+          break;
+        }
+        // Already a substitution, not a new candidate.
+        d->depth--;
+        return sub;
+      }
+      type = dm_parse_name(d, nullptr);
+      break;
+    case 'D':
+      if (c1 == 'p') {
+        d->p += 2;
+        type = dm_make(d, DM_EXPANSION, dm_parse_type(d), nullptr);
+      } else if (c1 == 'o')
+        type = dm_parse_qualified_type(d);
+      else if (c1 == 't' || c1 == 'T')
+        type = dm_parse_decltype(d);
+      else if (c1 == 'v') {
+        // Vector type, `T __vector(N)`
+        d->p += 2;
+        const auto size = dm_parse_number_name(d);
+        if (!size || !dm_consume(d, '_'))
+          return nullptr;
+        type = dm_make(d, DM_POSTFIX, dm_parse_type(d), size);
+        if (type) {
+          type->str = " __vector(";
+          type->len = 10;
+        }
+      } else if (c1 == 'F') {
+        // _FloatN
+        d->p += 2;
+        const auto start = d->p;
+        size_t bits;
+        if (!dm_parse_number(d, &bits, nullptr))
+          return nullptr;
+        const auto len = (size_t)(d->p - start);
+        const auto x = dm_consume(d, 'x');
+        if (!dm_consume(d, '_') || len > 8)
+          return nullptr;
+        // Backed by the mangled name, `_Float` is rebuilt from the static prefix.
+        type = dm_new(d, DM_POSTFIX);
+        if (type) {
+          type->a = dm_name(d, "_Float", 6);
+          type->str = start;
+          type->len = len + x;
+          if (!type->a)
+            type = nullptr;
+        }
+        d->depth--;
+        return type;
+      } else if (dm_is_lower(c1) && g_dbuiltins[c1 - 'a']) {
+        d->p += 2;
+        d->depth--;
+        return dm_builtin(d, g_dbuiltins[c1 - 'a'], 0);
+      } else
+        return nullptr;
+      break;
+    case 'U': {
+      // Vendor qualifier
+      d->p++;
+      const auto name = dm_parse_source_name(d);
+      if (!name || (dm_peek(d) == 'I' && !dm_parse_template_args(d, false)))
+        return nullptr;
+      type = dm_make(d, DM_POSTFIX, dm_parse_type(d), nullptr);
+      if (type) {
+        type->str = name->str;
+        type->len = name->len;
+        type->flags = 1;  // Separated by a space
+      }
+      break;
+    }
+    case 'u':
+      d->p++;
+      type = dm_parse_source_name(d);
+      break;
+    default:
+      if (dm_is_lower(c) && g_builtins[c - 'a']) {
+        d->p++;
+        d->depth--;
+        return dm_builtin(d, g_builtins[c - 'a'], c);
+      }
+      // Class or enumeration name
+      type = dm_parse_name(d, nullptr);
+      break;
+  }
+
+  if (!type || !dm_push_sub(d, type))
+    return nullptr;
+  d->depth--;
+  return type;
+}
+
+// L <type> <value> E, L _Z <encoding> E
+static dm_node_t* dm_parse_literal(nm_demangler_t* d) {
+  if (!dm_consume(d, 'L'))
+    return nullptr;
+
+  if (dm_peek(d) == '_' && dm_peek2(d) == 'Z') {
+    d->p += 2;
+    const auto encoding = dm_parse_encoding(d);
+    return (encoding && dm_consume(d, 'E')) ? encoding : nullptr;
+  }
+
+  const auto node = dm_new(d, DM_LITERAL);
+  if (!node || (node->a = dm_parse_type(d)) == nullptr)
+    return nullptr;
+  if (dm_consume(d, 'n'))
+    node->flags |= DM_NEGATIVE;
+
+  node->str = d->p;
+  while (d->p < d->end && *d->p != 'E')
+    d->p++;
+  node->len = (size_t)(d->p - node->str);
+  return dm_consume(d, 'E') ? node : nullptr;
+}
+
+// <base-unresolved-name> ::= <simple-id> | on <operator-name> [<template-args>]
+static dm_node_t* dm_parse_base_unresolved_name(nm_demangler_t* d) {
+  dm_node_t* name;
+  if (dm_peek(d) == 'o' && dm_peek2(d) == 'n') {
+    d->p += 2;
+    name = dm_parse_operator(d, nullptr);
+  } else if (dm_peek(d) == 'd' && dm_peek2(d) == 'n') {
+    d->p += 2;
+    name = dm_make(d, DM_DTOR,
+                   dm_is_digit(dm_peek(d)) ? dm_parse_source_name(d) : dm_parse_type(d),
+                   nullptr);
+  } else
+    name = dm_parse_source_name(d);
+
+  if (name && dm_peek(d) == 'I') {
+    const auto args = dm_parse_template_args(d, false);
+    name = args ? dm_make(d, DM_TEMPLATE, name, args) : nullptr;
+  }
+  return name;
+}
+
+// The template arguments apply to the qualified name, `(ns::f<int>)(x)` is a call
+// through a template rather than a plain name.
+static dm_node_t* dm_qualify(nm_demangler_t* d, dm_node_t* scope, dm_node_t* base) {
+  if (!scope || !base)
+    return nullptr;
+  if (base->kind != DM_TEMPLATE)
+    return dm_make(d, DM_NESTED, scope, base);
+  return dm_make(d, DM_TEMPLATE, dm_make(d, DM_NESTED, scope, base->a), base->b);
+}
+
+// sr <unresolved-qualifier-level>+ E <base-unresolved-name>
+// sr <type> <base-unresolved-name>
+// The first form is tried first, older compilers mangled A::x as sr1A1x rather than
+// sr1AE1x. The qualifier levels of srN...E are parsed as a nested name by the type.
+static dm_node_t* dm_parse_unresolved_name(nm_demangler_t* d) {
+  d->p += 2;  // sr
+
+  const auto c = dm_peek(d);
+  if (dm_is_digit(c) || dm_is_lower(c) || c == 'C' || c == 'U' || c == 'L') {
+    const auto p = d->p;
+    const auto nnodes = d->nnodes;
+    const auto nsubs = d->nsubs;
+    const auto nforward = d->nforward;
+
+    // The levels are not substitution candidates.
+    dm_node_t* scope = nullptr;
+    while (dm_peek(d) && dm_peek(d) != 'E') {
+      if (dm_peek(d) == 'I') {
+        const auto args = scope ? dm_parse_template_args(d, false) : nullptr;
+        scope = args ? dm_make(d, DM_TEMPLATE, scope, args) : nullptr;
+      } else {
+        const auto level = dm_parse_unqualified_name(d, nullptr, scope);
+        scope = (scope && level) ? dm_make(d, DM_NESTED, scope, level) : level;
+      }
+      if (!scope)
+        break;
+    }
+
+    if (scope && dm_consume(d, 'E')) {
+      const auto base = dm_parse_base_unresolved_name(d);
+      if (base)
+        return dm_qualify(d, scope, base);
+    }
+    d->p = p;
+    d->nnodes = nnodes;
+    d->nsubs = nsubs;
+    d->nforward = nforward;
+  }
+
+  const auto scope = dm_parse_type(d);
+  const auto base = scope ? dm_parse_base_unresolved_name(d) : nullptr;
+  return dm_qualify(d, scope, base);
+}
+
+static dm_node_t* dm_parse_expression(nm_demangler_t* d) {
+  if (++d->depth > DM_MAX_DEPTH)
+    return nullptr;
+
+  dm_node_t* expr = nullptr;
+  const auto c = dm_peek(d);
+  const auto c1 = dm_peek2(d);
+
+  if (c == 'L')
+    expr = dm_parse_literal(d);
+  else if (c == 'T')
+    expr = dm_parse_template_param(d);
+  else if (c == 'f' && c1 == 'p') {
+    d->p += 2;
+    while (dm_peek(d) == 'r' || dm_peek(d) == 'V' || dm_peek(d) == 'K')
+      d->p++;
+    expr = dm_new(d, DM_FUNCTION_PARAM);
+    if (expr && !dm_parse_discriminator_number(d, &expr->n))
+      expr = nullptr;
+  } else if (c == 's' && c1 == 'r')
+    expr = dm_parse_unresolved_name(d);
+  else if (c == 's' && c1 == 'p') {
+    d->p += 2;
+    expr = dm_make(d, DM_EXPANSION, dm_parse_expression(d), nullptr);
+  } else if (c == 's' && c1 == 'Z') {
+    d->p += 2;
+    expr = dm_make(d, DM_SIZEOF_PACK, dm_parse_template_param(d), nullptr);
+  } else if (c == 'c' && c1 == 'v') {
+    d->p += 2;
+    const auto type = dm_parse_type(d);
+    if (type && dm_consume(d, '_')) {
+      // Expression list, `(T)(a, b)`
+      dm_node_t* operands = nullptr;
+      dm_node_t* tail = nullptr;
+      while (!dm_consume(d, 'E')) {
+        const auto arg = dm_parse_expression(d);
+        if (!arg || !dm_append(d, &operands, &tail, arg))
+          return nullptr;
+      }
+      if ((expr = dm_make(d, DM_CAST, type, operands)) != nullptr)
+        expr->n = 1;
+    } else if (type) {
+      const auto operand = dm_parse_expression(d);
+      expr = operand ? dm_make(d, DM_CAST, type, operand) : nullptr;
+    }
+  } else if (c == 'c' && c1 == 'l') {
+    d->p += 2;
+    const auto callee = dm_parse_expression(d);
+    dm_node_t* args = nullptr;
+    dm_node_t* tail = nullptr;
+    while (callee && !dm_consume(d, 'E')) {
+      const auto arg = dm_parse_expression(d);
+      if (!arg || !dm_append(d, &args, &tail, arg))
+        return nullptr;
+    }
+    expr = dm_make(d, DM_CALL, callee, args);
+  } else if (c == 'd' && c1 == 't') {
+    d->p += 2;
+    const auto object = dm_parse_expression(d);
+    expr = dm_make(d, DM_BINARY, object, object ? dm_parse_base_unresolved_name(d) : nullptr);
+    if (expr) {
+      expr->str = ".";
+      expr->len = 1;
+      if (!expr->b)
+        expr = nullptr;
+    }
+  } else if (c == 'p' && c1 == 't') {
+    d->p += 2;
+    const auto object = dm_parse_expression(d);
+    expr = dm_make(d, DM_BINARY, object, object ? dm_parse_base_unresolved_name(d) : nullptr);
+    if (expr) {
+      expr->str = "->";
+      expr->len = 2;
+      if (!expr->b)
+        expr = nullptr;
+    }
+  } else if (dm_is_digit(c))
+    expr = dm_parse_base_unresolved_name(d);
+  else {
+    for (size_t i = 0; i < sizeof(g_operators) / sizeof(g_operators[0]); i++) {
+      if (g_operators[i].code[0] != c || g_operators[i].code[1] != c1)
+        continue;
+
+      const auto arity = g_operators[i].arity;
+      // new, delete and throw expressions are not supported
+      if (arity == 3 && c != 'q')
+        break;
+      d->p += 2;
+
+      const auto type_operand = (c == 's' || c == 'a') && c1 == 't';
+      const auto a = type_operand ? dm_parse_type(d) : dm_parse_expression(d);
+      const auto b = (arity >= 2) ? dm_parse_expression(d) : nullptr;
+      const auto third = (arity == 3) ? dm_parse_expression(d) : nullptr;
+      if ((arity >= 2 && !b) || (arity == 3 && !third))
+        break;
+
+      expr = dm_make(d, (arity == 1) ? DM_UNARY : (arity == 2) ? DM_BINARY : DM_TERNARY, a, b);
+      if (expr) {
+        expr->c = third;
+        expr->str = g_operators[i].name;
+        expr->len = strlen(expr->str);
+        expr->n = type_operand;
+      }
+      break;
+    }
+  }
+
+  d->depth--;
+  return expr;
+}
+
+// h <number> _ | v <number> _ <number> _
+static bool dm_parse_call_offset(nm_demangler_t* d) {
+  size_t n;
+  bool neg;
+  if (dm_consume(d, 'h'))
+    return dm_parse_number(d, &n, &neg) && dm_consume(d, '_');
+  if (dm_consume(d, 'v'))
+    return dm_parse_number(d, &n, &neg) && dm_consume(d, '_') &&
+           dm_parse_number(d, &n, &neg) && dm_consume(d, '_');
+  return false;
+}
+
+static dm_node_t* dm_parse_special_name(nm_demangler_t* d) {
+  const auto c = *d->p++;
+  const auto c1 = dm_peek(d);
+  d->p++;
+
+  if (c == 'T') {
+    switch (c1) {
+      case 'V':
+        return dm_special(d, "vtable for ", dm_parse_type(d));
+      case 'T':
+        return dm_special(d, "VTT for ", dm_parse_type(d));
+      case 'I':
+        return dm_special(d, "typeinfo for ", dm_parse_type(d));
+      case 'S':
+        return dm_special(d, "typeinfo name for ", dm_parse_type(d));
+      case 'h':
+        d->p--;
+        if (!dm_parse_call_offset(d))
+          return nullptr;
+        return dm_special(d, "non-virtual thunk to ", dm_parse_encoding(d));
+      case 'v':
+        d->p--;
+        if (!dm_parse_call_offset(d))
+          return nullptr;
+        return dm_special(d, "virtual thunk to ", dm_parse_encoding(d));
+      case 'c':
+        if (!dm_parse_call_offset(d) || !dm_parse_call_offset(d))
+          return nullptr;
+        return dm_special(d, "covariant return thunk to ", dm_parse_encoding(d));
+      case 'C': {
+        const auto derived = dm_parse_type(d);
+        size_t offset;
+        if (!derived || !dm_parse_number(d, &offset, nullptr) || !dm_consume(d, '_'))
+          return nullptr;
+        return dm_make(d, DM_CTOR_VTABLE, dm_parse_type(d), derived);
+      }
+      case 'W':
+        return dm_special(d, "TLS wrapper function for ", dm_parse_name(d, nullptr));
+      case 'H':
+        return dm_special(d, "TLS init function for ", dm_parse_name(d, nullptr));
+      case 'A':
+        return dm_special(d, "template parameter object for ", dm_parse_template_arg(d));
+      default:
+        return nullptr;
+    }
+  }
+
+  switch (c1) {
+    case 'V':
+      return dm_special(d, "guard variable for ", dm_parse_name(d, nullptr));
+    case 'R': {
+      // The ABI has a <seq-id> _ here, libiberty reads a plain number.
+      const auto name = dm_parse_name(d, nullptr);
+      const auto node = dm_special(d, "reference temporary #", name);
+      if (node)
+        node->n = (u32)dm_parse_digits(d);
+      return node;
+    }
+    case 'T':
+      if (dm_consume(d, 't'))
+        return dm_special(d, "transaction clone for ", dm_parse_encoding(d));
+      if (dm_consume(d, 'n'))
+        return dm_special(d, "non-transaction clone for ", dm_parse_encoding(d));
+      return nullptr;
+    case 'A':
+      return dm_special(d, "hidden alias for ", dm_parse_encoding(d));
+    default:
+      return nullptr;
+  }
+}
+
+static bool dm_is_end(const nm_demangler_t* d) {
+  const auto c = dm_peek(d);
+  return c == 0 || c == 'E' || c == '.';
+}
+
+static dm_node_t* dm_parse_encoding(nm_demangler_t* d) {
+  if (++d->depth > DM_MAX_DEPTH)
+    return nullptr;
+
+  // The template parameters of an encoding are unrelated to the enclosing ones.
+  const auto tparams = d->tparams;
+  dm_node_t* node = nullptr;
+
+  const auto c = dm_peek(d);
+  if ((c == 'T' || c == 'G') && dm_peek2(d)) {
+    node = dm_parse_special_name(d);
+    goto done;
+  }
+
+  dm_name_state_t st = {};
+  const auto name = dm_parse_name(d, &st);
+  if (!name || dm_is_end(d)) {
+    node = name;
+    goto done;
+  }
+
+  // Function attributes, e.g. Ua9enable_ifIXeqfp_Li1EEE, are not printed.
+  while (dm_peek(d) == 'U' && dm_peek2(d) == 'a') {
+    d->p += 2;
+    if (!dm_parse_source_name(d) || !dm_parse_template_args(d, false))
+      goto done;
+  }
+
+  node = dm_new(d, DM_ENCODING);
+  if (!node)
+    goto done;
+  node->a = name;
+  node->flags = st.flags;
+  node->ref = st.ref;
+
+  // Only function templates mangle their return type, not their constructors.
+  if (st.template_args && !st.ctor_dtor_conv && (node->c = dm_parse_type(d)) == nullptr) {
+    node = nullptr;
+    goto done;
+  }
+
+  if (dm_peek(d) == 'v' && (d->p + 1 == d->end || d->p[1] == 'E' || d->p[1] == '.')) {
+    d->p++;
+    goto done;
+  }
+
+  dm_node_t* tail = nullptr;
+  while (!dm_is_end(d)) {
+    const auto param = dm_parse_type(d);
+    if (!param || !dm_append(d, &node->b, &tail, param)) {
+      node = nullptr;
+      goto done;
+    }
+  }
+
+done:
+  d->tparams = tparams;
+  d->depth--;
+  return node;
+}
+
+// GCC clones: .constprop.0, .isra.0, .cold, .part.0 ...
+static dm_node_t* dm_parse_clone_suffix(nm_demangler_t* d, dm_node_t* node) {
+  const auto start = d->p;
+
+  if (dm_peek(d) == '.' && (dm_is_lower(dm_peek2(d)) || dm_peek2(d) == '_')) {
+    d->p += 2;
+    while (dm_is_lower(dm_peek(d)) || dm_peek(d) == '_')
+      d->p++;
+  }
+  while (dm_peek(d) == '.' && dm_is_digit(dm_peek2(d))) {
+    d->p += 2;
+    while (dm_is_digit(dm_peek(d)))
+      d->p++;
+  }
+
+  if (d->p == start)
+    return nullptr;
+  const auto clone = dm_make(d, DM_CLONE, node, nullptr);
+  if (clone) {
+    clone->str = start;
+    clone->len = (size_t)(d->p - start);
+  }
+  return clone;
+}
+
+/* printer */
+
+static void dm_put(nm_demangler_t* d, const char* s, const size_t len) {
+  if (d->failed || len >= DM_MAX_OUTPUT - d->len) {
+    d->failed = true;
+    return;
+  }
+  memcpy(d->out + d->len, s, len);
+  d->len += len;
+  if (len)
+    d->last = s[len - 1];
+}
+
+static void dm_puts(nm_demangler_t* d, const char* s) {
+  dm_put(d, s, strlen(s));
+}
+
+static char dm_last(const nm_demangler_t* d) {
+  return d->len ? d->last : 0;
+}
+
+static void dm_print(nm_demangler_t* d, const dm_node_t* node);
+
+// Template parameters print the argument they refer to, packs the element being expanded.
+static const dm_node_t* dm_resolve(const nm_demangler_t* d, const dm_node_t* node) {
+  // Only the packs template parameters refer to are being expanded, not the ones
+  // written out in the pattern.
+  bool param = false;
+  for (size_t i = 0; node && i < DM_MAX_DEPTH; i++) {
+    if (node->kind == DM_TPARAM && d->lambda_args)
+      return node;
+    if (node->kind == DM_TPARAM) {
+      node = node->a;
+      param = true;
+    } else if (node->kind == DM_PACK && param && d->pack_index >= 0) {
+      auto item = node->a;
+      for (int j = 0; item && j < d->pack_index; j++)
+        item = item->b;
+      if (!item)
+        return nullptr;
+      node = item->a;
+    } else
+      return node;
+  }
+  return nullptr;
+}
+
+static void dm_print_list(nm_demangler_t* d, const dm_node_t* list) {
+  // Empty packs at the end of the list don't leave a dangling separator, the others do:
+  // `f<, int>`.
+  auto end = d->len;
+  for (auto item = list; item && !d->failed; item = item->b) {
+    if (item != list)
+      dm_put(d, ", ", 2);
+    const auto start = d->len;
+    dm_print(d, item->a);
+    if (d->len != start)
+      end = d->len;
+  }
+  if (!d->failed)
+    d->len = end;
+}
+
+static void dm_print_template_args(nm_demangler_t* d, const dm_node_t* args) {
+  if (dm_last(d) == '<')
+    dm_put(d, " ", 1);
+  dm_put(d, "<", 1);
+  dm_print_list(d, args);
+  if (dm_last(d) == '>')
+    dm_put(d, " ", 1);
+  dm_put(d, ">", 1);
+}
+
+static void dm_print_quals(nm_demangler_t* d, const u8 flags) {
+  if (flags & DM_NOEXCEPT)
+    dm_puts(d, " noexcept");
+  if (flags & DM_CONST)
+    dm_puts(d, " const");
+  if (flags & DM_VOLATILE)
+    dm_puts(d, " volatile");
+  if (flags & DM_RESTRICT)
+    dm_puts(d, " restrict");
+}
+
+static void dm_print_ref(nm_demangler_t* d, const u8 ref) {
+  if (ref == 1)
+    dm_puts(d, " &");
+  else if (ref == 2)
+    dm_puts(d, " &&");
+}
+
+static bool dm_is_reference(const dm_node_t* node) {
+  return node && (node->kind == DM_LREF || node->kind == DM_RREF);
+}
+
+// Collapse references to references, `T& &&` is `T&`.
+static const dm_node_t* dm_collapse(const nm_demangler_t* d,
+                                    const dm_node_t* node,
+                                    dm_kind_t* kind) {
+  *kind = node->kind;
+  auto inner = dm_resolve(d, node->a);
+  while (dm_is_reference(*kind == DM_POINTER ? nullptr : node) && dm_is_reference(inner)) {
+    if (inner->kind == DM_LREF)
+      *kind = DM_LREF;
+    node = inner;
+    inner = dm_resolve(d, inner->a);
+  }
+  return inner;
+}
+
+// Whether the type has a part printed after the declarator, functions and arrays.
+static bool dm_has_rhs(const nm_demangler_t* d, const dm_node_t* node) {
+  for (size_t i = 0; i < DM_MAX_DEPTH; i++) {
+    node = dm_resolve(d, node);
+    if (!node)
+      return false;
+    switch (node->kind) {
+      case DM_FUNCTION:
+      case DM_ARRAY:
+        return true;
+      case DM_POINTER:
+      case DM_LREF:
+      case DM_RREF:
+      case DM_QUAL:
+        node = node->a;
+        break;
+      case DM_PTRMEM: {
+        const auto member = dm_resolve(d, node->b);
+        return member && member->kind == DM_FUNCTION;
+      }
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+// The function or array type a declarator must be parenthesized in, if any.
+static const dm_node_t* dm_declarator_group(const nm_demangler_t* d, const dm_node_t* node) {
+  node = dm_resolve(d, node);
+  while (node && node->kind == DM_QUAL)
+    node = dm_resolve(d, node->a);
+  return (node && (node->kind == DM_FUNCTION || node->kind == DM_ARRAY)) ? node : nullptr;
+}
+
+static void dm_print_left(nm_demangler_t* d, const dm_node_t* node);
+static void dm_print_right(nm_demangler_t* d, const dm_node_t* node);
+
+static void dm_print_left(nm_demangler_t* d, const dm_node_t* node) {
+  node = dm_resolve(d, node);
+  if (!node || ++d->steps > DM_MAX_STEPS || ++d->depth > DM_MAX_DEPTH) {
+    d->failed = true;
+    return;
+  }
+
+  switch (node->kind) {
+    case DM_POINTER:
+    case DM_LREF:
+    case DM_RREF: {
+      dm_kind_t kind;
+      const auto inner = dm_collapse(d, node, &kind);
+      if (dm_has_rhs(d, inner)) {
+        dm_print_left(d, inner);
+        // Only the innermost declarator opens the group, `int (**)()`.
+        const auto group = dm_declarator_group(d, inner);
+        if (group && group->kind == DM_ARRAY)
+          dm_puts(d, " (");
+        else if (group) {
+          const auto last = dm_last(d);
+          dm_puts(d, (last == ' ' || last == '(' || last == '*') ? "(" : " (");
+        }
+      } else
+        dm_print(d, inner);
+      dm_puts(d, (kind == DM_POINTER) ? "*" : (kind == DM_LREF) ? "&" : "&&");
+      break;
+    }
+    case DM_QUAL: {
+      const auto inner = dm_resolve(d, node->a);
+      if (dm_has_rhs(d, inner))
+        dm_print_left(d, inner);
+      else
+        dm_print(d, inner);
+      // A substituted type may already have the qualifiers, `T const` with T = int const.
+      const auto flags = (inner && inner->kind == DM_QUAL) ? node->flags & ~inner->flags
+                                                           : node->flags;
+      dm_print_quals(d, (u8)flags);
+      break;
+    }
+    case DM_FUNCTION:
+      if (dm_has_rhs(d, node->c))
+        dm_print_left(d, node->c);
+      else {
+        dm_print(d, node->c);
+        dm_put(d, " ", 1);
+      }
+      break;
+    case DM_ARRAY:
+      if (dm_has_rhs(d, node->a))
+        dm_print_left(d, node->a);
+      else
+        dm_print(d, node->a);
+      break;
+    case DM_PTRMEM: {
+      const auto member = dm_resolve(d, node->b);
+      if (member && member->kind == DM_FUNCTION) {
+        dm_print_left(d, member);
+        dm_put(d, "(", 1);
+      } else {
+        dm_print(d, member);
+        dm_put(d, " ", 1);
+      }
+      dm_print(d, node->a);
+      dm_puts(d, "::*");
+      break;
+    }
+    default:
+      dm_print(d, node);
+      break;
+  }
+  d->depth--;
+}
+
+static void dm_print_function_rhs(nm_demangler_t* d, const dm_node_t* fn) {
+  dm_put(d, "(", 1);
+  dm_print_list(d, fn->b);
+  dm_put(d, ")", 1);
+  dm_print_quals(d, fn->flags);
+  dm_print_ref(d, fn->ref);
+  if (fn->c && dm_has_rhs(d, fn->c))
+    dm_print_right(d, fn->c);
+}
+
+static void dm_print_right(nm_demangler_t* d, const dm_node_t* node) {
+  node = dm_resolve(d, node);
+  if (!node || ++d->steps > DM_MAX_STEPS || ++d->depth > DM_MAX_DEPTH) {
+    d->failed = true;
+    return;
+  }
+
+  switch (node->kind) {
+    case DM_POINTER:
+    case DM_LREF:
+    case DM_RREF: {
+      dm_kind_t kind;
+      const auto inner = dm_collapse(d, node, &kind);
+      if (dm_has_rhs(d, inner)) {
+        if (dm_declarator_group(d, inner))
+          dm_put(d, ")", 1);
+        dm_print_right(d, inner);
+      }
+      break;
+    }
+    case DM_QUAL:
+      if (dm_has_rhs(d, node->a))
+        dm_print_right(d, node->a);
+      break;
+    case DM_FUNCTION:
+      dm_print_function_rhs(d, node);
+      break;
+    case DM_ARRAY:
+      dm_puts(d, (dm_last(d) == ']') ? "[" : " [");
+      dm_print(d, node->b);
+      dm_put(d, "]", 1);
+      if (dm_has_rhs(d, node->a))
+        dm_print_right(d, node->a);
+      break;
+    case DM_PTRMEM: {
+      const auto member = dm_resolve(d, node->b);
+      if (member && member->kind == DM_FUNCTION) {
+        dm_put(d, ")", 1);
+        dm_print_right(d, member);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  d->depth--;
+}
+
+// Operands are parenthesized unless they are names.
+static void dm_print_subexpr(nm_demangler_t* d, const dm_node_t* node) {
+  const auto simple = node && (node->kind == DM_NAME || node->kind == DM_NESTED ||
+                               node->kind == DM_FUNCTION_PARAM);
+  if (!simple)
+    dm_put(d, "(", 1);
+  dm_print(d, node);
+  if (!simple)
+    dm_put(d, ")", 1);
+}
+
+static void dm_print_literal(nm_demangler_t* d, const dm_node_t* node) {
+  const auto type = dm_resolve(d, node->a);
+  const auto negative = (node->flags & DM_NEGATIVE) != 0;
+
+  if (type && type->kind == DM_BUILTIN && node->len) {
+    const char* suffix = nullptr;
+    switch (type->n) {
+      case 'i':
+        suffix = "";
+        break;
+      case 'j':
+        suffix = "u";
+        break;
+      case 'l':
+        suffix = "l";
+        break;
+      case 'm':
+        suffix = "ul";
+        break;
+      case 'x':
+        suffix = "ll";
+        break;
+      case 'y':
+        suffix = "ull";
+        break;
+      case 'b':
+        if (node->len == 1 && !negative && (node->str[0] == '0' || node->str[0] == '1')) {
+          dm_puts(d, (node->str[0] == '1') ? "true" : "false");
+          return;
+        }
+        break;
+      default:
+        break;
+    }
+    if (suffix) {
+      if (negative)
+        dm_put(d, "-", 1);
+      dm_put(d, node->str, node->len);
+      dm_puts(d, suffix);
+      return;
+    }
+  }
+
+  dm_put(d, "(", 1);
+  dm_print(d, type);
+  dm_put(d, ")", 1);
+  if (negative)
+    dm_put(d, "-", 1);
+  dm_put(d, node->str, node->len);
+}
+
+static void dm_put_number(nm_demangler_t* d, u32 n) {
+  char buffer[16];
+  char* p = buffer + sizeof(buffer);
+  do {
+    *--p = (char)('0' + n % 10);
+    n /= 10;
+  } while (n);
+  dm_put(d, p, (size_t)(buffer + sizeof(buffer) - p));
+}
+
+// The pack a pack expansion expands, the first one found in its pattern.
+static const dm_node_t* dm_find_pack(const dm_node_t* node, const size_t depth) {
+  if (!node || depth > DM_MAX_DEPTH)
+    return nullptr;
+  if (node->kind == DM_TPARAM)
+    return (node->a && node->a->kind == DM_PACK) ? node->a : nullptr;
+
+  const dm_node_t* pack = nullptr;
+  if ((pack = dm_find_pack(node->a, depth + 1)) != nullptr)
+    return pack;
+  if ((pack = dm_find_pack(node->b, depth + 1)) != nullptr)
+    return pack;
+  return dm_find_pack(node->c, depth + 1);
+}
+
+static void dm_print_expansion(nm_demangler_t* d, const dm_node_t* node) {
+  const auto pack = dm_find_pack(node->a, 0);
+  if (!pack || d->pack_index >= 0) {
+    dm_print(d, node->a);
+    dm_puts(d, "...");
+    return;
+  }
+
+  int i = 0;
+  for (auto item = pack->a; item && !d->failed; item = item->b, i++) {
+    if (i)
+      dm_put(d, ", ", 2);
+    d->pack_index = i;
+    dm_print(d, node->a);
+  }
+  d->pack_index = -1;
+}
+
+static void dm_print(nm_demangler_t* d, const dm_node_t* node) {
+  if (!node || d->failed || ++d->steps > DM_MAX_STEPS || ++d->depth > DM_MAX_DEPTH) {
+    d->failed = true;
+    return;
+  }
+
+  switch (node->kind) {
+    case DM_NAME:
+    case DM_BUILTIN:
+      dm_put(d, node->str, node->len);
+      break;
+    case DM_NESTED:
+    case DM_LOCAL:
+      dm_print(d, node->a);
+      dm_put(d, "::", 2);
+      dm_print(d, node->b);
+      break;
+    case DM_TEMPLATE: {
+      const auto lambda_args = d->lambda_args;
+      d->lambda_args = 0;
+      dm_print(d, node->a);
+      dm_print_template_args(d, node->b);
+      d->lambda_args = lambda_args;
+      break;
+    }
+    case DM_LIST:
+      dm_print_list(d, node);
+      break;
+    case DM_STD:
+      dm_puts(d, (node->flags & DM_EXPANDED) ? g_std[node->n].expanded : g_std[node->n].name);
+      break;
+    case DM_ABI_TAG:
+      dm_print(d, node->a);
+      dm_puts(d, "[abi:");
+      dm_put(d, node->str, node->len);
+      dm_put(d, "]", 1);
+      break;
+    case DM_CTOR:
+      dm_print(d, node->a);
+      break;
+    case DM_DTOR:
+      dm_put(d, "~", 1);
+      dm_print(d, node->a);
+      break;
+    case DM_OPERATOR:
+      dm_puts(d, "operator");
+      if (dm_is_lower(node->str[0]) || node->a)
+        dm_put(d, " ", 1);
+      if (node->a) {
+        // Literal and vendor operators
+        if (node->str[0] == '"')
+          dm_put(d, node->str, 2);
+        dm_print(d, node->a);
+      } else
+        dm_put(d, node->str, node->len - (node->str[node->len - 1] == ' '));
+      break;
+    case DM_CONVERSION:
+      dm_puts(d, "operator ");
+      dm_print(d, node->a);
+      break;
+    case DM_SPECIAL:
+      dm_put(d, node->str, node->len);
+      if (node->str[node->len - 1] == '#') {
+        dm_put_number(d, node->n);
+        dm_puts(d, " for ");
+      }
+      dm_print(d, node->a);
+      break;
+    case DM_CTOR_VTABLE:
+      dm_puts(d, "construction vtable for ");
+      dm_print(d, node->a);
+      dm_puts(d, "-in-");
+      dm_print(d, node->b);
+      break;
+    case DM_ENCODING: {
+      const auto ret = node->c;
+      if (ret) {
+        if (dm_has_rhs(d, ret))
+          dm_print_left(d, ret);
+        else {
+          dm_print(d, ret);
+          dm_put(d, " ", 1);
+        }
+      }
+      dm_print(d, node->a);
+      dm_put(d, "(", 1);
+      dm_print_list(d, node->b);
+      dm_put(d, ")", 1);
+      dm_print_quals(d, node->flags);
+      dm_print_ref(d, node->ref);
+      if (ret && dm_has_rhs(d, ret))
+        dm_print_right(d, ret);
+      break;
+    }
+    case DM_CLONE:
+      dm_print(d, node->a);
+      dm_puts(d, " [clone ");
+      dm_put(d, node->str, node->len);
+      dm_put(d, "]", 1);
+      break;
+    case DM_QUAL:
+    case DM_POINTER:
+    case DM_LREF:
+    case DM_RREF:
+    case DM_FUNCTION:
+    case DM_ARRAY:
+    case DM_PTRMEM:
+      dm_print_left(d, node);
+      dm_print_right(d, node);
+      break;
+    case DM_POSTFIX:
+      dm_print(d, node->a);
+      if (node->flags)
+        dm_put(d, " ", 1);
+      dm_put(d, node->str, node->len);
+      if (node->b) {
+        dm_print(d, node->b);
+        dm_put(d, ")", 1);
+      }
+      break;
+    case DM_PACK:
+    case DM_TPARAM: {
+      if (node->kind == DM_TPARAM && d->lambda_args) {
+        dm_puts(d, "auto:");
+        dm_put_number(d, node->n + 1);
+        break;
+      }
+      const auto resolved = dm_resolve(d, node);
+      if (resolved && resolved->kind == DM_PACK)
+        dm_print_list(d, resolved->a);
+      else
+        dm_print(d, resolved);
+      break;
+    }
+    case DM_EXPANSION:
+      dm_print_expansion(d, node);
+      break;
+    case DM_LAMBDA:
+      dm_puts(d, "{lambda(");
+      d->lambda_args++;
+      dm_print_list(d, node->b);
+      d->lambda_args--;
+      dm_puts(d, ")#");
+      dm_put_number(d, node->n);
+      dm_put(d, "}", 1);
+      break;
+    case DM_UNNAMED:
+      dm_puts(d, "{unnamed type#");
+      dm_put_number(d, node->n);
+      dm_put(d, "}", 1);
+      break;
+    case DM_DEFAULT_ARG:
+      dm_puts(d, "{default arg#");
+      dm_put_number(d, node->n);
+      dm_puts(d, "}::");
+      dm_print(d, node->a);
+      break;
+    case DM_LITERAL:
+      dm_print_literal(d, node);
+      break;
+    case DM_UNARY:
+      dm_put(d, node->str, node->len);
+      // The address of a function doesn't show its parameters, `&ns::f`, unless they
+      // are needed for its qualifiers.
+      if (node->str[0] == '&' && node->a && node->a->kind == DM_ENCODING &&
+          node->a->a->kind == DM_NESTED && !node->a->flags && !node->a->ref)
+        dm_print(d, node->a->a);
+      else if (node->n) {
+        dm_put(d, "(", 1);
+        dm_print(d, node->a);
+        dm_put(d, ")", 1);
+      } else
+        dm_print_subexpr(d, node->a);
+      break;
+    case DM_BINARY: {
+      // The greater-than operator would close the template argument list.
+      const auto gt = node->str[0] == '>' && node->len == 1;
+      if (gt)
+        dm_put(d, "(", 1);
+      dm_print_subexpr(d, node->a);
+      if (node->str[0] == '[') {
+        dm_put(d, "[", 1);
+        dm_print(d, node->b);
+        dm_put(d, "]", 1);
+      } else {
+        dm_put(d, node->str, node->len);
+        dm_print_subexpr(d, node->b);
+      }
+      if (gt)
+        dm_put(d, ")", 1);
+      break;
+    }
+    case DM_TERNARY:
+      dm_print_subexpr(d, node->a);
+      dm_put(d, "?", 1);
+      dm_print_subexpr(d, node->b);
+      dm_puts(d, " : ");
+      dm_print_subexpr(d, node->c);
+      break;
+    case DM_CAST:
+      dm_put(d, "(", 1);
+      dm_print(d, node->a);
+      dm_put(d, ")", 1);
+      if (node->n) {
+        dm_put(d, "(", 1);
+        dm_print_list(d, node->b);
+        dm_put(d, ")", 1);
+      } else
+        dm_print_subexpr(d, node->b);
+      break;
+    case DM_CALL:
+      // The parameter types of a called function are not shown.
+      dm_print_subexpr(d, (node->a->kind == DM_ENCODING) ? node->a->a : node->a);
+      dm_put(d, "(", 1);
+      dm_print_list(d, node->b);
+      dm_put(d, ")", 1);
+      break;
+    case DM_FUNCTION_PARAM:
+      dm_puts(d, "{parm#");
+      dm_put_number(d, node->n);
+      dm_put(d, "}", 1);
+      break;
+    case DM_SIZEOF_PACK: {
+      const auto pack = dm_resolve(d, node->a);
+      if (pack && pack->kind == DM_PACK) {
+        u32 n = 0;
+        for (auto item = pack->a; item; item = item->b)
+          n++;
+        dm_put_number(d, n);
+      } else {
+        dm_puts(d, "sizeof...(");
+        dm_print(d, node->a);
+        dm_put(d, ")", 1);
+      }
+      break;
+    }
+    case DM_WRAPPED:
+      dm_put(d, node->str, node->len);
+      if (node->a && node->a->kind == DM_LIST)
+        dm_print_list(d, node->a);
+      else
+        dm_print(d, node->a);
+      dm_put(d, (node->str[0] == '[') ? "]" : ")", 1);
+      break;
+    default:
+      d->failed = true;
+      break;
+  }
+  d->depth--;
+}
+
+/* legacy rust */
+
+// Rust symbols before the v0 mangling are Itanium nested names whose last component is
+// a hash, with `$..$` escapes for the characters C++ identifiers can't hold. nm tries
+// them first, the hash is not printed.
+
+static bool dm_rust_ident(const char** p, const char* end, const char** ident, size_t* len) {
+  if (*p == end || !dm_is_digit(**p))
+    return false;
+
+  size_t n = (size_t)(*(*p)++ - '0');
+  if (n)
+    while (*p < end && dm_is_digit(**p) && n <= (SIZE_MAX - 9) / 10)
+      n = n * 10 + (size_t)(*(*p)++ - '0');
+  if (n == 0 || (size_t)(end - *p) < n)
+    return false;
+
+  *ident = *p;
+  *len = n;
+  *p += n;
+  return true;
+}
+
+static int dm_hex_nibble(const char c) {
+  if (dm_is_digit(c))
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// h followed by 16 hex digits, of which at least 5 different.
+static bool dm_rust_is_hash(const char* ident, const size_t len) {
+  if (len != 17 || ident[0] != 'h')
+    return false;
+
+  u16 seen = 0;
+  for (size_t i = 1; i < len; i++) {
+    const auto nibble = dm_hex_nibble(ident[i]);
+    if (nibble < 0)
+      return false;
+    seen |= (u16)(1 << nibble);
+  }
+  return __builtin_popcount(seen) >= 5;
+}
+
+// $SP$ $BP$ $RF$ $LT$ $GT$ $LP$ $RP$ $C$ and $uXX$
+static char dm_rust_escape(const char* e, const size_t len, size_t* escape) {
+  if (len < 3)
+    return 0;
+
+  char c = 0;
+  size_t n = 0;
+  if (e[1] == 'C') {
+    n = 1;
+    c = ',';
+  } else if (len > 3) {
+    n = 2;
+    static const char escapes[][3] = {"SP@", "BP*", "RF&", "LT<", "GT>", "LP(", "RP)"};
+    for (size_t i = 0; i < sizeof(escapes) / sizeof(escapes[0]); i++)
+      if (e[1] == escapes[i][0] && e[2] == escapes[i][1])
+        c = escapes[i][2];
+
+    if (!c && e[1] == 'u' && len > 4) {
+      n = 3;
+      const auto hi = dm_hex_nibble(e[2]);
+      const auto lo = dm_hex_nibble(e[3]);
+      // Printable ASCII only
+      if (hi < 0 || lo < 0 || hi > 7 || (hi << 4 | lo) < 0x20)
+        return 0;
+      c = (char)(hi << 4 | lo);
+    }
+  }
+
+  if (!c || len <= n + 1 || e[n + 1] != '$')
+    return 0;
+  *escape = n + 2;
+  return c;
+}
+
+static void dm_rust_print_ident(nm_demangler_t* d, const char* ident, size_t len) {
+  // The underscore making the identifier start with a letter is not printed.
+  if (len >= 2 && ident[0] == '_' && ident[1] == '$') {
+    ident++;
+    len--;
+  }
+
+  while (len) {
+    size_t n = 1;
+    if (ident[0] == '$') {
+      const auto c = dm_rust_escape(ident, len, &n);
+      if (!c) {
+        dm_put(d, ident, len);
+        return;
+      }
+      dm_put(d, &c, 1);
+    } else if (ident[0] == '.') {
+      if (len >= 2 && ident[1] == '.') {
+        dm_put(d, "::", 2);
+        n = 2;
+      } else
+        dm_put(d, "-", 1);
+    } else {
+      for (n = 0; n < len && ident[n] != '$' && ident[n] != '.'; n++)
+        ;
+      dm_put(d, ident, n);
+    }
+    ident += n;
+    len -= n;
+  }
+}
+
+static bool dm_demangle_rust(nm_demangler_t* d, const char* name, const size_t len) {
+  if (len < 3 || name[2] != 'N' || name[len - 1] != 'E')
+    return false;
+
+  for (size_t i = 3; i < len; i++) {
+    const auto c = name[i];
+    if (!(c == '_' || c == '$' || c == '.' || c == ':' || dm_is_digit(c) ||
+          (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+      return false;
+  }
+
+  const auto end = name + len - 1;
+  if (end - (name + 3) <= 19 || memcmp(end - 19, "17h", 3) != 0)
+    return false;
+
+  const char* ident = nullptr;
+  size_t ident_len = 0;
+  for (auto p = name + 3; p < end;)
+    if (!dm_rust_ident(&p, end, &ident, &ident_len))
+      return false;
+  if (!dm_rust_is_hash(ident, ident_len))
+    return false;
+
+  for (auto p = name + 3; p < end - 19;) {
+    if (p != name + 3)
+      dm_put(d, "::", 2);
+    dm_rust_ident(&p, end, &ident, &ident_len);
+    dm_rust_print_ident(d, ident, ident_len);
+  }
+  return !d->failed;
+}
+
+/*!
+ * Demangle the \a len bytes long \a name into the output buffer.
+ * @return Whether \a name is a valid mangled name.
+ */
+static bool dm_demangle(nm_demangler_t* d, const char* name, const size_t len) {
+  // Only the parser and printer state is reset, the pools are reused as they are.
+  d->p = name + 2;
+  d->end = name + len;
+  d->depth = 0;
+  d->nnodes = 0;
+  d->nsubs = 0;
+  d->tparams = nullptr;
+  d->nforward = 0;
+  d->len = 0;
+  d->last = 0;
+  d->failed = false;
+  d->pack_index = -1;
+  d->lambda_args = 0;
+  d->steps = 0;
+
+  if (dm_demangle_rust(d, name, len)) {
+    d->out[d->len] = 0;
+    return true;
+  }
+  d->len = 0;
+  d->failed = false;
+
+  auto node = dm_parse_encoding(d);
+  while (node && dm_peek(d) == '.')
+    node = dm_parse_clone_suffix(d, node);
+  if (!node || d->p != d->end || d->nforward)
+    return false;
+
+  d->depth = 0;
+  dm_print(d, node);
+  if (d->failed)
+    return false;
+  d->out[d->len] = 0;
+  return true;
+}
+
+nm_demangler_t* nm_demangler_new() {
+  nm_demangler_t* d = malloc(sizeof(nm_demangler_t));
+  if (!d)
+    return nullptr;
+
+  memset(d->slots, 0, sizeof(d->slots));
+  d->generation = 1;
+  d->used = 0;
+  return d;
+}
+
+const char* nm_demangle(nm_demangler_t* d, const char* name) {
+  if (name[0] != '_' || name[1] != 'Z')
+    return name;
+
+  u32 len;
+  const auto hash = nm_strhash(name, &len);
+  const auto slot = &d->slots[hash & (DM_CACHE_SLOTS - 1)];
+  if (slot->generation == d->generation && slot->hash == hash && slot->len == len &&
+      memcmp(d->arena + slot->offset, name, len) == 0)
+    return d->arena + slot->offset + len + 1;
+
+  // Versioned names from .symtab, `_Z1fv@VERS`, keep the version as it is.
+  const char* version = memchr(name, '@', len);
+  const auto mlen = version ? (size_t)(version - name) : len;
+  if (!dm_demangle(d, name, mlen))
+    return name;
+  if (version) {
+    const auto vlen = len - mlen;
+    if (d->len + vlen >= DM_MAX_OUTPUT)
+      return name;
+    memcpy(d->out + d->len, version, vlen + 1);
+    d->len += vlen;
+  }
+
+  // Memoize, starting over once the arena is full.
+  const auto size = (size_t)len + 1 + d->len + 1;
+  if (size > DM_CACHE_SIZE)
+    return d->out;
+  if (DM_CACHE_SIZE - d->used < size) {
+    d->generation++;
+    d->used = 0;
+  }
+
+  const auto entry = d->arena + d->used;
+  memcpy(entry, name, len + 1);
+  memcpy(entry + len + 1, d->out, d->len + 1);
+  *slot = (dm_cache_slot_t){
+      .hash = hash,
+      .generation = d->generation,
+      .offset = (u32)d->used,
+      .len = len,
+  };
+  d->used += size;
+  return entry + len + 1;
+}
+
+void nm_demangler_destroy(nm_demangler_t** d) {
+  if (!d)
+    return;
+  free(*d);
+  *d = nullptr;
+}
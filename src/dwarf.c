@@ -0,0 +1,901 @@
+#define ELFU_PRIVATE
+#include <nm/elfu.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#undef ELFU_PRIVATE
+
+// DWARF .debug_line reader, see the DWARF 5 standard section 6.2.
+// Every line program is run once, its rows are appended to a single table and each
+// sequence is recorded. Resolving an address is then a binary search over the sequences
+// followed by one over the rows of the sequence containing it.
+
+#define seterr(e) _elfu_seterr(e)
+
+// Base of the sections of a relocatable object that are not loaded, they have no address.
+#define DW_UNPLACED UINT64_MAX
+
+enum {
+  DW_LNS_copy = 1,
+  DW_LNS_advance_pc = 2,
+  DW_LNS_advance_line = 3,
+  DW_LNS_set_file = 4,
+  DW_LNS_const_add_pc = 8,
+  DW_LNS_fixed_advance_pc = 9,
+};
+
+enum {
+  DW_LNE_end_sequence = 1,
+  DW_LNE_set_address = 2,
+  DW_LNE_define_file = 3,
+};
+
+enum {
+  DW_LNCT_path = 1,
+  DW_LNCT_directory_index = 2,
+};
+
+enum {
+  DW_FORM_block2 = 0x03,
+  DW_FORM_block4 = 0x04,
+  DW_FORM_data2 = 0x05,
+  DW_FORM_data4 = 0x06,
+  DW_FORM_data8 = 0x07,
+  DW_FORM_string = 0x08,
+  DW_FORM_block = 0x09,
+  DW_FORM_block1 = 0x0a,
+  DW_FORM_data1 = 0x0b,
+  DW_FORM_sdata = 0x0d,
+  DW_FORM_strp = 0x0e,
+  DW_FORM_udata = 0x0f,
+  DW_FORM_strx = 0x1a,
+  DW_FORM_data16 = 0x1e,
+  DW_FORM_line_strp = 0x1f,
+  DW_FORM_strx1 = 0x25,
+  DW_FORM_strx2 = 0x26,
+  DW_FORM_strx3 = 0x27,
+  DW_FORM_strx4 = 0x28,
+};
+
+#define DW_MAX_FORMATS 16
+
+typedef struct {
+  const elfu_t* e;
+  const u8* p;
+  const u8* end;
+  bool err;  // A read went past the end
+} dw_reader_t;
+
+typedef struct {
+  const u8* data;
+  size_t size;
+} dw_strings_t;
+
+typedef struct {
+  elfu_lines_t* t;
+  size_t rows_cap;
+  size_t files_cap;
+  size_t seqs_cap;
+
+  // Directories of the unit being read.
+  const char** dirs;
+  size_t ndirs;
+  size_t dirs_cap;
+
+  dw_strings_t line_str;  // .debug_line_str
+  dw_strings_t str;       // .debug_str
+} dw_ctx_t;
+
+// Header of the unit being run.
+typedef struct {
+  u16 version;
+  size_t offset_size;  // 4 or 8 for the 64 bits DWARF format
+  u8 min_inst;
+  u8 max_ops;
+  int8_t line_base;
+  u8 line_range;
+  u8 opcode_base;
+  const u8* lengths;  // Operand count of the standard opcodes
+  size_t files_base;  // Index of the first file of the unit in the table
+} dw_unit_t;
+
+static bool dw_grow(void** arr, size_t* cap, const size_t n, const size_t size) {
+  if (n < *cap)
+    return true;
+
+  const auto ncap = *cap ? *cap * 2 : 64;
+  void* p = realloc(*arr, ncap * size);
+  if (!p) {
+    seterr(ELFU_OUT_OF_MEMORY);
+    return false;
+  }
+  *arr = p;
+  *cap = ncap;
+  return true;
+}
+
+#define dw_push(arr, n, cap, v) \
+  (dw_grow((void**)&(arr), &(cap), (n), sizeof(*(arr))) && ((arr)[(n)++] = (v), true))
+
+static bool dw_has(dw_reader_t* r, const size_t n) {
+  if (r->err || (size_t)(r->end - r->p) < n) {
+    r->err = true;
+    r->p = r->end;
+    return false;
+  }
+  return true;
+}
+
+// Unaligned read of a `size` bytes integer in the object byte order.
+static u64 dw_uint(dw_reader_t* r, const size_t size) {
+  if (!dw_has(r, size))
+    return 0;
+
+  u64 v = 0;
+  for (size_t i = 0; i < size; i++) {
+    const auto shift = (r->e->endian == ENDIAN_LITTLE) ? 8 * i : 8 * (size - i - 1);
+    v |= (u64)r->p[i] << shift;
+  }
+  r->p += size;
+  return v;
+}
+
+static u64 dw_uleb(dw_reader_t* r) {
+  u64 v = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    if (!dw_has(r, 1))
+      return 0;
+    const auto b = *r->p++;
+    if (shift < 64)
+      v |= (u64)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return v;
+  }
+}
+
+static int64_t dw_sleb(dw_reader_t* r) {
+  u64 v = 0;
+  unsigned shift = 0;
+  u8 b;
+  do {
+    if (!dw_has(r, 1))
+      return 0;
+    b = *r->p++;
+    if (shift < 64)
+      v |= (u64)(b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+
+  if (shift < 64 && (b & 0x40))
+    v |= ~(u64)0 << shift;
+  return (int64_t)v;
+}
+
+static const char* dw_str(dw_reader_t* r) {
+  const u8* nul = nullptr;
+  if (!r->err && (nul = memchr(r->p, 0, (size_t)(r->end - r->p))) == nullptr)
+    r->err = true;
+  if (r->err) {
+    r->p = r->end;
+    return nullptr;
+  }
+
+  const auto s = (const char*)r->p;
+  r->p = nul + 1;
+  return s;
+}
+
+static void dw_skip(dw_reader_t* r, const u64 n) {
+  if (dw_has(r, n))
+    r->p += n;
+}
+
+static const char* dw_strings_at(const dw_strings_t* s, const u64 offset) {
+  if (offset >= s->size || !memchr(s->data + offset, 0, s->size - offset))
+    return nullptr;
+  return (const char*)(s->data + offset);
+}
+
+// Read an attribute of a DWARF 5 directory or file entry, strings go to `str`, the
+// constants to `value`.
+static bool dw_form(const dw_ctx_t* c,
+                    dw_reader_t* r,
+                    const dw_unit_t* u,
+                    const u64 form,
+                    u64* value,
+                    const char** str) {
+  *value = 0;
+  *str = nullptr;
+
+  switch (form) {
+    case DW_FORM_string:
+      *str = dw_str(r);
+      break;
+    case DW_FORM_strp:
+      *str = dw_strings_at(&c->str, dw_uint(r, u->offset_size));
+      break;
+    case DW_FORM_line_strp:
+      *str = dw_strings_at(&c->line_str, dw_uint(r, u->offset_size));
+      break;
+    case DW_FORM_data1:
+    case DW_FORM_strx1:
+      *value = dw_uint(r, 1);
+      break;
+    case DW_FORM_data2:
+    case DW_FORM_strx2:
+      *value = dw_uint(r, 2);
+      break;
+    case DW_FORM_strx3:
+      *value = dw_uint(r, 3);
+      break;
+    case DW_FORM_data4:
+    case DW_FORM_strx4:
+      *value = dw_uint(r, 4);
+      break;
+    case DW_FORM_data8:
+      *value = dw_uint(r, 8);
+      break;
+    case DW_FORM_data16:
+      dw_skip(r, 16);
+      break;
+    case DW_FORM_udata:
+    case DW_FORM_strx:
+      *value = dw_uleb(r);
+      break;
+    case DW_FORM_sdata:
+      *value = (u64)dw_sleb(r);
+      break;
+    case DW_FORM_block:
+      dw_skip(r, dw_uleb(r));
+      break;
+    case DW_FORM_block1:
+      dw_skip(r, dw_uint(r, 1));
+      break;
+    case DW_FORM_block2:
+      dw_skip(r, dw_uint(r, 2));
+      break;
+    case DW_FORM_block4:
+      dw_skip(r, dw_uint(r, 4));
+      break;
+    default:
+      return false;
+  }
+
+  return !r->err;
+}
+
+static bool dw_add_file(dw_ctx_t* c, const char* name, const u64 dir) {
+  const auto t = c->t;
+  // The directory 0 is the compilation directory, it is only in the table since DWARF 5.
+  elfu_line_file_t file = {
+      .comp_dir = c->ndirs ? c->dirs[0] : nullptr,
+      .name = name ? name : "",
+  };
+  if (dir != 0 && dir < c->ndirs)
+    file.dir = c->dirs[dir];
+  return dw_push(t->files, t->nfiles, c->files_cap, file);
+}
+
+// DWARF 5 directory (`files` false) or file name table.
+// Returns 0 on success, -1 on allocation failure and 1 if the table is malformed.
+static int dw_table_v5(dw_ctx_t* c,
+                       dw_reader_t* r,
+                       const dw_unit_t* u,
+                       const bool files) {
+  u64 formats[DW_MAX_FORMATS][2];
+
+  const auto nformats = dw_uint(r, 1);
+  if (nformats > DW_MAX_FORMATS)
+    return 1;
+  for (size_t i = 0; i < nformats; i++) {
+    formats[i][0] = dw_uleb(r);
+    formats[i][1] = dw_uleb(r);
+  }
+
+  // Every entry must consume some bytes, a huge count can't make it loop forever.
+  const auto count = dw_uleb(r);
+  if (count && !nformats)
+    return 1;
+  for (u64 n = 0; n < count && !r->err; n++) {
+    const char* path = nullptr;
+    u64 dir = 0;
+
+    for (size_t i = 0; i < nformats; i++) {
+      u64 value;
+      const char* str;
+      if (!dw_form(c, r, u, formats[i][1], &value, &str))
+        return 1;
+
+      if (formats[i][0] == DW_LNCT_path)
+        path = str;
+      else if (formats[i][0] == DW_LNCT_directory_index)
+        dir = value;
+    }
+
+    const auto ok = files ? dw_add_file(c, path, dir)
+                          : dw_push(c->dirs, c->ndirs, c->dirs_cap, path);
+    if (!ok)
+      return -1;
+  }
+
+  return r->err ? 1 : 0;
+}
+
+// Directories and files before DWARF 5, the directory 0 is the compilation directory.
+static int dw_tables_v4(dw_ctx_t* c, dw_reader_t* r) {
+  // The compilation directory is only known from .debug_info.
+  if (!dw_push(c->dirs, c->ndirs, c->dirs_cap, nullptr))
+    return -1;
+
+  for (const char* dir; (dir = dw_str(r)) && *dir;) {
+    if (!dw_push(c->dirs, c->ndirs, c->dirs_cap, dir))
+      return -1;
+  }
+
+  for (const char* name; (name = dw_str(r)) && *name;) {
+    const auto dir = dw_uleb(r);
+    dw_uleb(r);  // Modification time
+    dw_uleb(r);  // Size
+    if (!dw_add_file(c, name, dir))
+      return -1;
+  }
+
+  return r->err ? 1 : 0;
+}
+
+typedef struct {
+  u64 address;
+  u64 op_index;
+  u64 file;
+  u64 line;
+
+  size_t first;  // First row of the current sequence
+  bool bad;      // The addresses of the sequence are not increasing
+} dw_state_t;
+
+static void dw_state_reset(dw_state_t* s, const size_t first) {
+  *s = (dw_state_t){.file = 1, .line = 1, .first = first};
+}
+
+static void dw_advance(dw_state_t* s, const dw_unit_t* u, const u64 adv) {
+  if (u->max_ops == 1) {
+    s->address += u->min_inst * adv;
+    return;
+  }
+  s->address += u->min_inst * ((s->op_index + adv) / u->max_ops);
+  s->op_index = (s->op_index + adv) % u->max_ops;
+}
+
+static bool dw_row(dw_ctx_t* c, dw_state_t* s, const dw_unit_t* u) {
+  const auto t = c->t;
+
+  // Files are 1-based before DWARF 5.
+  const auto local = (u->version >= 5) ? s->file : s->file - 1;
+  const auto file = (local < t->nfiles - u->files_base) ? (u32)(u->files_base + local)
+                                                        : UINT32_MAX;
+  const auto row = (elfu_line_row_t){
+      .addr = s->address,
+      .file = file,
+      .line = (u32)s->line,
+  };
+
+  if (t->nrows > s->first) {
+    const auto prev = &t->rows[t->nrows - 1];
+    if (row.addr < prev->addr)
+      s->bad = true;
+    // Like nm (bfd), the last row of an address wins.
+    if (row.addr == prev->addr) {
+      *prev = row;
+      return true;
+    }
+    if (row.file == prev->file && row.line == prev->line)
+      return true;
+  }
+
+  return dw_push(t->rows, t->nrows, c->rows_cap, row);
+}
+
+static bool dw_end_sequence(dw_ctx_t* c, dw_state_t* s) {
+  const auto t = c->t;
+  const auto end = (elfu_line_row_t){.addr = s->address, .file = UINT32_MAX};
+
+  if (t->nrows > s->first && end.addr < t->rows[t->nrows - 1].addr)
+    s->bad = true;
+  if (!dw_push(t->rows, t->nrows, c->rows_cap, end))
+    return false;
+
+  const auto seq = (elfu_line_seq_t){
+      .low = t->rows[s->first].addr,
+      .high = end.addr,
+      .first = s->first,
+      .count = t->nrows - s->first,
+  };
+  // Empty sequences can't contain anything, and sequences going backwards can't be
+  // searched.
+  if (s->bad || seq.count < 2 || seq.high <= seq.low)
+    t->nrows = s->first;
+  else if (!dw_push(t->seqs, t->nseqs, c->seqs_cap, seq))
+    return false;
+
+  dw_state_reset(s, t->nrows);
+  return true;
+}
+
+static bool dw_run(dw_ctx_t* c, dw_reader_t* r, const dw_unit_t* u) {
+  dw_state_t s;
+  dw_state_reset(&s, c->t->nrows);
+
+  while (!r->err && r->p < r->end) {
+    const auto op = (u8)dw_uint(r, 1);
+
+    // Special opcodes advance both the address and the line, then append a row.
+    if (op >= u->opcode_base) {
+      const auto adj = (u8)(op - u->opcode_base);
+      dw_advance(&s, u, adj / u->line_range);
+      s.line += (u64)(int64_t)(u->line_base + adj % u->line_range);
+      if (!dw_row(c, &s, u))
+        return false;
+      continue;
+    }
+
+    if (op == 0) {
+      const auto len = dw_uleb(r);
+      if (r->err || len == 0 || len > (size_t)(r->end - r->p))
+        break;
+      const auto next = r->p + len;
+
+      switch (dw_uint(r, 1)) {
+        case DW_LNE_end_sequence:
+          if (!dw_end_sequence(c, &s))
+            return false;
+          break;
+        case DW_LNE_set_address:
+          if (len - 1 <= sizeof(u64)) {
+            s.address = dw_uint(r, len - 1);
+            s.op_index = 0;
+          }
+          break;
+        case DW_LNE_define_file:
+        {
+          const auto name = dw_str(r);
+          const auto dir = dw_uleb(r);
+          if (!r->err && !dw_add_file(c, name, dir))
+            return false;
+          break;
+        }
+        default:
+          break;
+      }
+      r->p = next;
+      continue;
+    }
+
+    switch (op) {
+      case DW_LNS_copy:
+        if (!dw_row(c, &s, u))
+          return false;
+        break;
+      case DW_LNS_advance_pc:
+        dw_advance(&s, u, dw_uleb(r));
+        break;
+      case DW_LNS_advance_line:
+        s.line += (u64)dw_sleb(r);
+        break;
+      case DW_LNS_set_file:
+        s.file = dw_uleb(r);
+        break;
+      case DW_LNS_const_add_pc:
+        dw_advance(&s, u, (255 - u->opcode_base) / u->line_range);
+        break;
+      case DW_LNS_fixed_advance_pc:
+        s.address += dw_uint(r, 2);
+        s.op_index = 0;
+        break;
+      default:
+        // The other standard opcodes don't change the rows, skip their operands.
+        for (u8 i = 0; i < u->lengths[op - 1]; i++)
+          dw_uleb(r);
+        break;
+    }
+  }
+
+  // Drop the unterminated sequence.
+  c->t->nrows = s.first;
+  return true;
+}
+
+/*!
+ * Read the unit header at \a r and run its line program, \a r is moved past the unit.
+ * @return \c false on allocation failure only, malformed units are skipped. \a r is at
+ * the end of the section if the next unit can't be found.
+ */
+static bool dw_unit(dw_ctx_t* c, dw_reader_t* r) {
+  const auto t = c->t;
+  dw_unit_t u = {.offset_size = 4, .files_base = t->nfiles};
+
+  u64 length = dw_uint(r, 4);
+  if (length == 0xffffffff) {
+    length = dw_uint(r, 8);
+    u.offset_size = 8;
+  }
+  if (r->err || length > (size_t)(r->end - r->p)) {
+    r->p = r->end;
+    return true;
+  }
+
+  dw_reader_t h = {.e = r->e, .p = r->p, .end = r->p + length};
+  r->p = h.end;
+
+  u.version = (u16)dw_uint(&h, 2);
+  if (u.version < 2 || u.version > 5)
+    return true;
+  if (u.version >= 5)
+    dw_skip(&h, 2);  // Address and segment selector sizes
+
+  const auto header_length = dw_uint(&h, u.offset_size);
+  if (h.err || header_length > (size_t)(h.end - h.p))
+    return true;
+  const auto program = h.p + header_length;
+
+  u.min_inst = (u8)dw_uint(&h, 1);
+  u.max_ops = (u.version >= 4) ? (u8)dw_uint(&h, 1) : 1;
+  dw_skip(&h, 1);  // default_is_stmt
+  u.line_base = (int8_t)dw_uint(&h, 1);
+  u.line_range = (u8)dw_uint(&h, 1);
+  u.opcode_base = (u8)dw_uint(&h, 1);
+  u.lengths = h.p;
+  if (u.opcode_base)
+    dw_skip(&h, u.opcode_base - 1);
+  if (h.err || u.line_range == 0 || u.max_ops == 0 || u.opcode_base == 0)
+    return true;
+
+  c->ndirs = 0;
+  int ret;
+  if (u.version >= 5) {
+    ret = dw_table_v5(c, &h, &u, false);
+    if (ret == 0)
+      ret = dw_table_v5(c, &h, &u, true);
+  } else
+    ret = dw_tables_v4(c, &h);
+  if (ret < 0)
+    return false;
+  if (ret > 0 || program > h.end) {
+    t->nfiles = u.files_base;
+    return true;
+  }
+
+  h.p = program;
+  return dw_run(c, &h, &u);
+}
+
+static bool dw_find_section(const elfu_t* e,
+                            const char* name,
+                            elfu_section_t* section,
+                            size_t* index) {
+  for (size_t i = 0; i < e->ehdr.e_shnum; i++) {
+    const auto sname = elfu_get_section_name(e, i);
+    if (!sname || strcmp(sname, name) != 0)
+      continue;
+    // Compressed sections would need zlib.
+    if (!elfu_get_section(e, i, section) || !section->data ||
+        (section->hdr.sh_flags & SHF_COMPRESSED))
+      return false;
+    if (index)
+      *index = i;
+    return true;
+  }
+  return false;
+}
+
+static dw_strings_t dw_find_strings(const elfu_t* e, const char* name) {
+  elfu_section_t section;
+  if (!dw_find_section(e, name, &section, nullptr))
+    return (dw_strings_t){};
+  return (dw_strings_t){.data = section.data, .size = section.hdr.sh_size};
+}
+
+// Place the allocated sections of a relocatable object one after the other, like a
+// linker would, so that addresses are unique across sections. The others have no
+// address and are left at DW_UNPLACED.
+static bool dw_place_sections(const elfu_t* e, elfu_lines_t* t) {
+  const size_t count = e->ehdr.e_shnum;
+  if ((t->bases = malloc((count ? count : 1) * sizeof(u64))) == nullptr) {
+    seterr(ELFU_OUT_OF_MEMORY);
+    return false;
+  }
+  t->nbases = count;
+
+  u64 cursor = 0;
+  for (size_t i = 0; i < count; i++) {
+    elfu_section_t section;
+    t->bases[i] = DW_UNPLACED;
+    if (!elfu_get_section(e, i, &section) || !(section.hdr.sh_flags & SHF_ALLOC))
+      continue;
+
+    const auto align = section.hdr.sh_addralign ? section.hdr.sh_addralign : 1;
+    cursor = (cursor + align - 1) / align * align;
+    t->bases[i] = cursor;
+    // Keep empty sections distinct from the next one.
+    cursor += section.hdr.sh_size ? section.hdr.sh_size : 1;
+  }
+
+  return true;
+}
+
+// Size of the absolute relocations found in .debug_line, 0 for the others.
+static size_t dw_reloc_size(const u16 machine, const u32 type) {
+  switch (machine) {
+    case EM_X86_64:
+      if (type == R_X86_64_64)
+        return 8;
+      return (type == R_X86_64_32 || type == R_X86_64_32S) ? 4 : 0;
+    case EM_386:
+      return (type == R_386_32) ? 4 : 0;
+    case EM_AARCH64:
+      return (type == R_AARCH64_ABS64) ? 8 : (type == R_AARCH64_ABS32) ? 4 : 0;
+    case EM_ARM:
+      return (type == R_ARM_ABS32) ? 4 : 0;
+    case EM_RISCV:
+      return (type == R_RISCV_64) ? 8 : (type == R_RISCV_32) ? 4 : 0;
+    default:
+      return 0;
+  }
+}
+
+static void dw_write(const elfu_t* e, u8* p, const size_t size, const u64 v) {
+  for (size_t i = 0; i < size; i++) {
+    const auto shift = (e->endian == ENDIAN_LITTLE) ? 8 * i : 8 * (size - i - 1);
+    p[i] = (u8)(v >> shift);
+  }
+}
+
+// Apply the relocations targeting the section `index` to `copy`.
+static void dw_apply_relocs(const elfu_t* e,
+                            const elfu_lines_t* t,
+                            const elfu_section_t* rel,
+                            const size_t index,
+                            u8* copy) {
+  const auto rela = rel->hdr.sh_type == SHT_RELA;
+  const auto wide = e->class == CLASS64;
+  const size_t entry_size = (wide ? 8 : 4) * (rela ? 3 : 2);
+  elfu_section_t target;
+  elfu_section_t symtab;
+  elfu_sym_iter_t iter;
+
+  if (rel->hdr.sh_info != index || !rel->data || rel->hdr.sh_entsize != entry_size ||
+      !elfu_get_section(e, index, &target) ||
+      !elfu_get_section(e, rel->hdr.sh_link, &symtab) ||
+      !elfu_get_sym_iter(e, &symtab, &iter))
+    return;
+
+  dw_reader_t r = {.e = e, .p = rel->data, .end = rel->data + rel->hdr.sh_size};
+  while (dw_has(&r, entry_size)) {
+    const auto offset = dw_uint(&r, wide ? 8 : 4);
+    const auto info = dw_uint(&r, wide ? 8 : 4);
+    const auto addend = rela ? dw_uint(&r, wide ? 8 : 4) : 0;
+
+    const auto sym = wide ? ELF64_R_SYM(info) : ELF32_R_SYM(info);
+    const auto type = wide ? ELF64_R_TYPE(info) : ELF32_R_TYPE(info);
+    const auto size = dw_reloc_size(e->ehdr.e_machine, (u32)type);
+
+    elfu_sym_t s;
+    if (size == 0 || offset > target.hdr.sh_size || target.hdr.sh_size - offset < size ||
+        !elfu_sym_iter_seek(&iter, sym) || !elfu_sym_iter_next(&iter, &s))
+      continue;
+
+    // A reference to a section that is not loaded is an offset in it, like the paths
+    // in .debug_line_str, it is not moved.
+    u64 value = s.sym.st_value;
+    if (s.sym.st_shndx < t->nbases) {
+      if (t->bases[s.sym.st_shndx] != DW_UNPLACED)
+        value += t->bases[s.sym.st_shndx];
+    } else if (s.sym.st_shndx != SHN_ABS)
+      continue;
+
+    // Sign extend the 32 bits addends, the result is truncated to the field anyway.
+    if (rela)
+      value += wide ? addend : (u64)(int64_t)(int32_t)addend;
+    else {
+      dw_reader_t in = {.e = e, .p = copy + offset, .end = copy + offset + size};
+      value += dw_uint(&in, size);
+    }
+    dw_write(e, copy + offset, size, value);
+  }
+}
+
+// Relocatable objects: relocate a copy of .debug_line against the placed sections.
+static const u8* dw_relocate(const elfu_t* e,
+                             elfu_lines_t* t,
+                             const elfu_section_t* line,
+                             const size_t index) {
+  if (!dw_place_sections(e, t) || (t->relocated = malloc(line->hdr.sh_size)) == nullptr) {
+    seterr(ELFU_OUT_OF_MEMORY);
+    return nullptr;
+  }
+  memcpy(t->relocated, line->data, line->hdr.sh_size);
+
+  for (size_t i = 0; i < e->ehdr.e_shnum; i++) {
+    elfu_section_t rel;
+    if (elfu_get_section(e, i, &rel) &&
+        (rel.hdr.sh_type == SHT_RELA || rel.hdr.sh_type == SHT_REL))
+      dw_apply_relocs(e, t, &rel, index, t->relocated);
+  }
+
+  return t->relocated;
+}
+
+static bool dw_seq_less(const elfu_line_seq_t* a, const elfu_line_seq_t* b) {
+  // Like nm (bfd), the widest sequence first when several start at the same address.
+  if (a->low != b->low)
+    return a->low < b->low;
+  if (a->high != b->high)
+    return a->high > b->high;
+  return a->first < b->first;
+}
+
+static void dw_sift_down(elfu_line_seq_t* seqs, size_t i, const size_t n) {
+  for (;;) {
+    auto max = i;
+    const auto l = 2 * i + 1;
+    const auto r = l + 1;
+    if (l < n && dw_seq_less(&seqs[max], &seqs[l]))
+      max = l;
+    if (r < n && dw_seq_less(&seqs[max], &seqs[r]))
+      max = r;
+    if (max == i)
+      return;
+
+    const auto tmp = seqs[i];
+    seqs[i] = seqs[max];
+    seqs[max] = tmp;
+    i = max;
+  }
+}
+
+static void dw_sort_seqs(elfu_line_seq_t* seqs, const size_t n) {
+  for (size_t i = n / 2; i-- > 0;)
+    dw_sift_down(seqs, i, n);
+  for (size_t end = n; end-- > 1;) {
+    const auto tmp = seqs[0];
+    seqs[0] = seqs[end];
+    seqs[end] = tmp;
+    dw_sift_down(seqs, 0, end);
+  }
+}
+
+bool elfu_get_lines(const elfu_t* e, elfu_lines_t* lines) {
+  if (!e || !e->flags.ehdr || !lines) {
+    seterr(ELFU_INVALID_ARG);
+    return false;
+  }
+
+  elfu_lines_t t = {};
+  dw_ctx_t c = {.t = &t};
+  elfu_section_t line;
+  size_t index;
+
+  if (!dw_find_section(e, ".debug_line", &line, &index))
+    return false;
+  c.line_str = dw_find_strings(e, ".debug_line_str");
+  c.str = dw_find_strings(e, ".debug_str");
+
+  const u8* data = line.data;
+  const auto relocatable = e->ehdr.e_type == ET_REL;
+  if (relocatable && (data = dw_relocate(e, &t, &line, index)) == nullptr)
+    goto err;
+
+  // The section is only walked once, front to back: ask for a more aggressive readahead
+  // while it is. Only when the image is our own mapping, as for _elfu_willneed.
+  const auto advise = !relocatable && e->flags.mapped;
+  const auto page = (uintptr_t)getpagesize();
+  const auto start = (uintptr_t)line.data & ~(page - 1);
+  const auto length = (uintptr_t)line.data + line.hdr.sh_size - start;
+  if (advise)
+    madvise((void*)start, length, MADV_SEQUENTIAL);
+
+  dw_reader_t r = {.e = e, .p = data, .end = data + line.hdr.sh_size};
+  auto ok = true;
+  while (ok && r.p < r.end)
+    ok = dw_unit(&c, &r);
+
+  if (advise)
+    madvise((void*)start, length, MADV_NORMAL);
+  if (!ok)
+    goto err;
+
+  dw_sort_seqs(t.seqs, t.nseqs);
+  free(c.dirs);
+
+  if (t.nseqs == 0) {
+    elfu_lines_destroy(&t);
+    return false;
+  }
+
+  *lines = t;
+  return true;
+
+err:
+  free(c.dirs);
+  elfu_lines_destroy(&t);
+  return false;
+}
+
+bool elfu_lines_find(const elfu_lines_t* lines,
+                     const elfu_isym_t* sym,
+                     elfu_line_t* line) {
+  if (!lines || !sym || !line) {
+    seterr(ELFU_INVALID_ARG);
+    return false;
+  }
+
+  if (sym->st_shndx == SHN_UNDEF || sym->st_shndx >= SHN_LORESERVE)
+    return false;
+
+  auto addr = sym->st_value;
+  if (lines->bases) {
+    if (sym->st_shndx >= lines->nbases || lines->bases[sym->st_shndx] == DW_UNPLACED)
+      return false;
+    addr += lines->bases[sym->st_shndx];
+  }
+
+  // Sequences may be nested when several start at the same address, like nm (bfd) stop at
+  // the first one found containing the address.
+  const elfu_line_seq_t* seq = nullptr;
+  size_t lo = 0;
+  size_t hi = lines->nseqs;
+  while (lo < hi && !seq) {
+    const auto mid = lo + (hi - lo) / 2;
+    const auto s = &lines->seqs[mid];
+    if (addr < s->low)
+      hi = mid;
+    else if (addr >= s->high)
+      lo = mid + 1;
+    else
+      seq = s;
+  }
+  if (!seq)
+    return false;
+
+  // Last row starting at or before the address, the end row can't be one.
+  const auto rows = lines->rows + seq->first;
+  lo = 0;
+  hi = seq->count - 1;
+  while (hi - lo > 1) {
+    const auto mid = lo + (hi - lo) / 2;
+    if (rows[mid].addr <= addr)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  const auto row = &rows[lo];
+  if (row->file == UINT32_MAX || row->line == 0)
+    return false;
+
+  // Like nm (bfd), the directories are only prepended while the path is relative.
+  const auto file = &lines->files[row->file];
+  *line = (elfu_line_t){.file = file->name, .line = row->line};
+  if (file->name[0] == '/')
+    return true;
+  if (file->dir && *file->dir) {
+    line->dir = file->dir;
+    if (file->dir[0] == '/')
+      return true;
+  }
+  if (file->comp_dir && *file->comp_dir)
+    line->comp_dir = file->comp_dir;
+  return true;
+}
+
+void elfu_lines_destroy(elfu_lines_t* lines) {
+  if (!lines)
+    return;
+
+  free(lines->files);
+  free(lines->rows);
+  free(lines->seqs);
+  free(lines->bases);
+  free(lines->relocated);
+  *lines = (elfu_lines_t){};
+}
@@ -1,8 +1,10 @@
 #define ELFU_PRIVATE
 #include <fcntl.h>
 #include <nm/elfu.h>
+#include <nm/stats.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -23,11 +25,31 @@ static thread_local elfu_err_t g_err = ELFU_SUCCESS;
            u32: __builtin_bswap32,             \
            u64: __builtin_bswap64)((v)))
 
+// The structures are copied out of the object: nothing aligns them in a malformed one.
+static u16 _elfu_load16(const elfu_t* e, const u8* p) {
+  u16 v;
+  memcpy(&v, p, sizeof(v));
+  return translate(e, v);
+}
+
+static u32 _elfu_load32(const elfu_t* e, const u8* p) {
+  u32 v;
+  memcpy(&v, p, sizeof(v));
+  return translate(e, v);
+}
+
+static u64 _elfu_load64(const elfu_t* e, const u8* p) {
+  u64 v;
+  memcpy(&v, p, sizeof(v));
+  return translate(e, v);
+}
+
 static elfu_ehdr_t _elfu_read_ehdr(const elfu_t* e, const uintptr_t offset) {
   elfu_ehdr_t ehdr = {};
 
   if (e->class == CLASS32) {
-    _elfu32_ehdr_t e32 = *(_elfu32_ehdr_t*)(e->raw + offset);
+    _elfu32_ehdr_t e32;
+    memcpy(&e32, e->raw + offset, sizeof(e32));
 
     ehdr.e_type = translate(e, e32.e_type);
     ehdr.e_machine = translate(e, e32.e_machine);
@@ -43,7 +65,7 @@ static elfu_ehdr_t _elfu_read_ehdr(const elfu_t* e, const uintptr_t offset) {
     ehdr.e_shnum = translate(e, e32.e_shnum);
     ehdr.e_shstrndx = translate(e, e32.e_shstrndx);
   } else {
-    ehdr = *(elfu_ehdr_t*)(e->raw + e->offset);
+    memcpy(&ehdr, e->raw + e->offset, sizeof(ehdr));
 
     ehdr.e_type = translate(e, ehdr.e_type);
     ehdr.e_machine = translate(e, ehdr.e_machine);
@@ -67,7 +89,8 @@ static elfu_shdr_t _elfu_read_shdr(const elfu_t* e, const uintptr_t offset) {
   elfu_shdr_t hdr = {};
 
   if (e->class == CLASS32) {
-    Elf32_Shdr h32 = *(Elf32_Shdr*)(e->raw + offset);
+    Elf32_Shdr h32;
+    memcpy(&h32, e->raw + offset, sizeof(h32));
 
     hdr.sh_name = translate(e, h32.sh_name);
     hdr.sh_type = translate(e, h32.sh_type);
@@ -80,7 +103,7 @@ static elfu_shdr_t _elfu_read_shdr(const elfu_t* e, const uintptr_t offset) {
     hdr.sh_addralign = translate(e, h32.sh_addralign);
     hdr.sh_entsize = translate(e, h32.sh_entsize);
   } else {
-    hdr = *(elfu_shdr_t*)(e->raw + offset);
+    memcpy(&hdr, e->raw + offset, sizeof(hdr));
 
     hdr.sh_name = translate(e, hdr.sh_name);
     hdr.sh_type = translate(e, hdr.sh_type);
@@ -101,7 +124,8 @@ static elfu_isym_t _elfu_read_sym(const elfu_t* e, const uintptr_t offset) {
   elfu_isym_t raw = {};
 
   if (e->class == CLASS32) {
-    const auto s32 = *(Elf32_Sym*)(e->raw + offset);
+    Elf32_Sym s32;
+    memcpy(&s32, e->raw + offset, sizeof(s32));
 
     raw.st_name = translate(e, s32.st_name);
     raw.st_info = s32.st_info;
@@ -110,7 +134,7 @@ static elfu_isym_t _elfu_read_sym(const elfu_t* e, const uintptr_t offset) {
     raw.st_value = translate(e, s32.st_value);
     raw.st_size = translate(e, s32.st_size);
   } else {
-    raw = *(Elf64_Sym*)(e->raw + offset);
+    memcpy(&raw, e->raw + offset, sizeof(raw));
 
     raw.st_name = translate(e, raw.st_name);
     raw.st_shndx = translate(e, raw.st_shndx);
@@ -121,8 +145,59 @@ static elfu_isym_t _elfu_read_sym(const elfu_t* e, const uintptr_t offset) {
   return raw;
 }
 
+static elfu_phdr_t _elfu_read_phdr(const elfu_t* e, const uintptr_t offset) {
+  elfu_phdr_t hdr = {};
+
+  if (e->class == CLASS32) {
+    Elf32_Phdr p32;
+    memcpy(&p32, e->raw + offset, sizeof(p32));
+
+    hdr.p_type = translate(e, p32.p_type);
+    hdr.p_offset = translate(e, p32.p_offset);
+    hdr.p_vaddr = translate(e, p32.p_vaddr);
+    hdr.p_paddr = translate(e, p32.p_paddr);
+    hdr.p_filesz = translate(e, p32.p_filesz);
+    hdr.p_memsz = translate(e, p32.p_memsz);
+    hdr.p_flags = translate(e, p32.p_flags);
+    hdr.p_align = translate(e, p32.p_align);
+  } else {
+    memcpy(&hdr, e->raw + offset, sizeof(hdr));
+
+    hdr.p_type = translate(e, hdr.p_type);
+    hdr.p_offset = translate(e, hdr.p_offset);
+    hdr.p_vaddr = translate(e, hdr.p_vaddr);
+    hdr.p_paddr = translate(e, hdr.p_paddr);
+    hdr.p_filesz = translate(e, hdr.p_filesz);
+    hdr.p_memsz = translate(e, hdr.p_memsz);
+    hdr.p_flags = translate(e, hdr.p_flags);
+    hdr.p_align = translate(e, hdr.p_align);
+  }
+
+  return hdr;
+}
+
+static elfu_dyn_t _elfu_read_dyn(const elfu_t* e, const uintptr_t offset) {
+  elfu_dyn_t dyn = {};
+
+  if (e->class == CLASS32) {
+    Elf32_Dyn d32;
+    memcpy(&d32, e->raw + offset, sizeof(d32));
+
+    dyn.d_tag = (int32_t)translate(e, (u32)d32.d_tag);
+    dyn.d_un.d_val = translate(e, d32.d_un.d_val);
+  } else {
+    memcpy(&dyn, e->raw + offset, sizeof(dyn));
+
+    dyn.d_tag = (int64_t)translate(e, (u64)dyn.d_tag);
+    dyn.d_un.d_val = translate(e, dyn.d_un.d_val);
+  }
+
+  return dyn;
+}
+
 static Elf64_Verneed _elfu_read_verneed(const elfu_t* e, const uintptr_t offset) {
-  Elf64_Verneed raw = *(Elf64_Verneed*)(e->raw + offset);
+  Elf64_Verneed raw;
+  memcpy(&raw, e->raw + offset, sizeof(raw));
 
   raw.vn_version = translate(e, raw.vn_version);
   raw.vn_cnt = translate(e, raw.vn_cnt);
@@ -134,7 +209,8 @@ static Elf64_Verneed _elfu_read_verneed(const elfu_t* e, const uintptr_t offset)
 }
 
 static Elf64_Vernaux _elfu_read_vernaux(const elfu_t* e, const uintptr_t offset) {
-  Elf64_Vernaux raw = *(Elf64_Vernaux*)(e->raw + offset);
+  Elf64_Vernaux raw;
+  memcpy(&raw, e->raw + offset, sizeof(raw));
 
   raw.vna_hash = translate(e, raw.vna_hash);
   raw.vna_flags = translate(e, raw.vna_flags);
@@ -146,7 +222,8 @@ static Elf64_Vernaux _elfu_read_vernaux(const elfu_t* e, const uintptr_t offset)
 }
 
 static Elf64_Verdef _elfu_read_verdef(const elfu_t* e, const uintptr_t offset) {
-  Elf64_Verdef raw = *(Elf64_Verdef*)(e->raw + offset);
+  Elf64_Verdef raw;
+  memcpy(&raw, e->raw + offset, sizeof(raw));
 
   raw.vd_version = translate(e, raw.vd_version);
   raw.vd_flags = translate(e, raw.vd_flags);
@@ -159,7 +236,8 @@ static Elf64_Verdef _elfu_read_verdef(const elfu_t* e, const uintptr_t offset) {
 }
 
 static Elf64_Verdaux _elfu_read_verdaux(const elfu_t* e, const uintptr_t offset) {
-  Elf64_Verdaux raw = *(Elf64_Verdaux*)(e->raw + offset);
+  Elf64_Verdaux raw;
+  memcpy(&raw, e->raw + offset, sizeof(raw));
 
   raw.vda_name = translate(e, raw.vda_name);
   raw.vda_next = translate(e, raw.vda_next);
@@ -187,7 +265,7 @@ static bool elf_read_ident(elfu_t* e) {
   }
 
   const auto id = (elf_ident_t*)e->raw;
-  if (*(u32*)id->magic != *(u32*)elf_magic) {
+  if (memcmp(id->magic, elf_magic, sizeof(elf_magic)) != 0) {
     seterr(ELFU_UNKNOWN_FORMAT);
     return false;
   }
@@ -224,12 +302,69 @@ static bool elf_read_header(elfu_t* e) {
   return true;
 }
 
+// Reads the headers of the object once its bytes are in place.
+static bool _elfu_init(elfu_t* e) {
+  e->hendian = fetch_host_endian();
+  return elf_read_ident(e) && elf_read_header(e);
+}
+
+#define ELFU_HUGEPAGE_SIZE ((size_t)2 << 20)
+
+// Map the object following the ELFU_MAP_* hints.
+static u8* _elfu_map(const int fd, const size_t size, const u32 map_flags) {
+  const int flags = MAP_PRIVATE | ((map_flags & ELFU_MAP_POPULATE) ? MAP_POPULATE : 0);
+  if (!(map_flags & ELFU_MAP_HUGEPAGE) || size < ELFU_HUGEPAGE_SIZE)
+    return mmap(nullptr, size, PROT_READ, flags, fd, 0);
+
+  // Huge pages can only back aligned ranges: reserve enough room to align the object,
+  // map it over the reservation and give back what is left on both sides.
+  const auto span = size + ELFU_HUGEPAGE_SIZE;
+  u8* area = mmap(nullptr, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (area == MAP_FAILED)
+    return MAP_FAILED;
+
+  const auto mask = (uintptr_t)ELFU_HUGEPAGE_SIZE - 1;
+  u8* aligned = (u8*)(((uintptr_t)area + mask) & ~mask);
+  u8* raw = mmap(aligned, size, PROT_READ, flags | MAP_FIXED, fd, 0);
+  if (raw == MAP_FAILED) {
+    munmap(area, span);
+    return MAP_FAILED;
+  }
+
+  const auto page = (size_t)getpagesize();
+  u8* end = aligned + ((size + page - 1) & ~(page - 1));
+  if (aligned != area)
+    munmap(area, (size_t)(aligned - area));
+  if (end != area + span)
+    munmap(end, (size_t)(area + span - end));
+
+  madvise(raw, size, MADV_HUGEPAGE);
+  return raw;
+}
+
+// Read ahead the bytes of `section` if the object was mapped with ELFU_MAP_WILLNEED.
+static void _elfu_willneed(const elfu_t* e, const elfu_section_t* section) {
+  if (!(e->map_flags & ELFU_MAP_WILLNEED) || !e->flags.mapped || !section->data)
+    return;
+
+  const auto page = (uintptr_t)getpagesize();
+  const auto start = (uintptr_t)section->data & ~(page - 1);
+  const auto end = (uintptr_t)section->data + section->hdr.sh_size;
+  madvise((void*)start, end - start, MADV_WILLNEED);
+}
+
 elfu_t* elfu_new(const int fd) {
+  return elfu_new_with_flags(fd, 0);
+}
+
+elfu_t* elfu_new_with_flags(const int fd, const u32 map_flags) {
   elfu_t* elf = malloc(sizeof(elfu_t));
   if (!elf) {
     seterr(ELFU_OUT_OF_MEMORY);
     goto err;
   }
+  // Before anything can fail, elfu_destroy looks at the mapping.
+  *elf = (elfu_t){};
 
   struct stat st;
   if (fstat(fd, &st) < 0) {
@@ -247,19 +382,18 @@ elfu_t* elfu_new(const int fd) {
     goto err;
   }
 
-  *elf = (elfu_t){};
   elf->fsize = st.st_size;
+  elf->map_flags = map_flags;
 
-  elf->raw = mmap(nullptr, elf->fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+  elf->raw = _elfu_map(fd, elf->fsize, map_flags);
   if (elf->raw == MAP_FAILED) {
+    elf->raw = nullptr;
     seterr(ELFU_MAP_FAILED);
     goto err;
   }
+  elf->flags.mapped = true;
 
-  elf->hendian = fetch_host_endian();
-  if (!elf_read_ident(elf))
-    goto err;
-  if (!elf_read_header(elf))
+  if (!_elfu_init(elf))
     goto err;
 
   return elf;
@@ -269,6 +403,28 @@ err:
   return nullptr;
 }
 
+elfu_t* elfu_new_from_memory(const void* data, const size_t size) {
+  if (!data && size) {
+    seterr(ELFU_INVALID_ARG);
+    return nullptr;
+  }
+
+  elfu_t* elf = malloc(sizeof(elfu_t));
+  if (!elf) {
+    seterr(ELFU_OUT_OF_MEMORY);
+    return nullptr;
+  }
+
+  // Never written through, the mapping of elfu_new is read only as well.
+  *elf = (elfu_t){.raw = (uint8_t*)data, .fsize = size};
+  if (!_elfu_init(elf)) {
+    elfu_destroy(&elf);
+    return nullptr;
+  }
+
+  return elf;
+}
+
 bool elfu_get_ehdr(const elfu_t* e, elfu_ehdr_t* ehdr) {
   if (!e || !ehdr) {
     seterr(ELFU_INVALID_ARG);
@@ -306,13 +462,50 @@ static bool _elfu_first_section_by_type(const elfu_t* e,
   return false;
 }
 
+static const char* _elfu_str(const elfu_section_t* strtab, const size_t str) {
+  NM_STAT_INC(strptr);
+
+  const auto e = strtab->elf;
+  if (!e || !strtab->data)
+    return nullptr;
+
+  const auto start = (uintptr_t)strtab->data;
+  const auto end = (uintptr_t)(strtab->data + str);
+
+  if (end < start)
+    return nullptr;
+
+  if (e->fsize < end - (uintptr_t)e->raw)
+    return nullptr;
+
+  // We do this check to ensure the strtab is actually null terminated and that in the
+  // worst case we don't read out of bounds. An unterminated table is tolerated when the
+  // byte right after it, still within the object, is a terminator.
+  const auto strtab_size = strtab->hdr.sh_size;
+  if (strtab_size == 0)
+    return nullptr;
+
+  auto limit = strtab_size;
+  if (*(strtab->data + strtab_size - 1) != 0) {
+    const auto next = (uintptr_t)(strtab->data + strtab_size) - (uintptr_t)e->raw;
+    if (next >= e->fsize || *(strtab->data + strtab_size) != 0)
+      return nullptr;
+    limit++;
+  }
+  // Past the table, nothing guarantees a terminator before the end of the object.
+  if (str >= limit)
+    return nullptr;
+
+  return (const char*)(strtab->data + str);
+}
+
 static const char* _elfu_version_from_verdef(const elfu_section_t* verdef,
+                                             const elfu_section_t* strtab,
                                              const elfu_isym_t* sym,
                                              const size_t version) {
   const auto e = verdef->elf;
   const auto base = (uintptr_t)verdef->hdr.sh_offset;
   const auto end = base + verdef->hdr.sh_size;
-  const auto strtab = verdef->hdr.sh_link;
 
   if (verdef->hdr.sh_size == 0 || e->fsize < base || e->fsize < end)
     return nullptr;
@@ -337,7 +530,7 @@ static const char* _elfu_version_from_verdef(const elfu_section_t* verdef,
       const auto vdaux = _elfu_read_verdaux(e, cursor);
       // If the name is the same as the symbol name, avoid returning it as its redundant.
       // nm seems to be doing this so we follow the same behavior.
-      return (vdaux.vda_name != sym->st_name) ? elfu_strptr(e, strtab, vdaux.vda_name)
+      return (vdaux.vda_name != sym->st_name) ? _elfu_str(strtab, vdaux.vda_name)
                                               : nullptr;
     }
 
@@ -348,11 +541,11 @@ static const char* _elfu_version_from_verdef(const elfu_section_t* verdef,
 }
 
 static const char* _elfu_version_from_verneed(const elfu_section_t* verneed,
+                                              const elfu_section_t* strtab,
                                               const size_t version) {
   const auto e = verneed->elf;
   const auto base = (uintptr_t)verneed->hdr.sh_offset;
   const auto end = base + verneed->hdr.sh_size;
-  const auto strtab = verneed->hdr.sh_link;
 
   if (verneed->hdr.sh_size == 0 || e->fsize < base || e->fsize < end)
     return nullptr;
@@ -377,7 +570,7 @@ static const char* _elfu_version_from_verneed(const elfu_section_t* verneed,
 
       const auto vnaux = _elfu_read_vernaux(e, cursor);
       if (vnaux.vna_other == version)
-        return elfu_strptr(e, strtab, vnaux.vna_name);
+        return _elfu_str(strtab, vnaux.vna_name);
       cursor += vnaux.vna_next;
     }
 
@@ -421,7 +614,7 @@ static const char* _elfu_get_sym_version(const elfu_t* e,
     return nullptr;
   }
 
-  const auto version = translate(e, *(u16*)(versym_base + versym_offset));
+  const auto version = _elfu_load16(e, (const u8*)(versym_base + versym_offset));
   if ((version & VERSYM_VERSION) == VER_NDX_LOCAL ||
       (version & VERSYM_VERSION) == VER_NDX_GLOBAL)
     return nullptr;
@@ -431,76 +624,129 @@ static const char* _elfu_get_sym_version(const elfu_t* e,
     *hidden = true;
 
   if (sym->st_shndx != SHN_UNDEF && version != (VERSYM_HIDDEN | 0x1) && verdef != nullptr) {
-    const char* name;
-    if ((name = _elfu_version_from_verdef(verdef, sym, version & VERSYM_VERSION)))
+    const auto name =
+        _elfu_version_from_verdef(verdef, &v->strtab, sym, version & VERSYM_VERSION);
+    if (name)
       return name;
   }
 
   // The verneed section holds the version information for undefined symbols, thus the
   // symbol is definitely hidden.
   *hidden = true;
-  return (verneed != nullptr) ? _elfu_version_from_verneed(verneed, version) : nullptr;
+  return (verneed != nullptr) ? _elfu_version_from_verneed(verneed, &v->strtab, version)
+                              : nullptr;
 }
 
 bool elfu_get_symtab(const elfu_t* e, elfu_section_t* symtab) {
   return _elfu_first_section_by_type(e, SHT_SYMTAB, symtab);
 }
 
-bool elfu_get_dynsymtab(const elfu_t* e, elfu_section_t* dynsymtab) {
-  return _elfu_first_section_by_type(e, SHT_DYNSYM, dynsymtab);
-}
-
 bool elfu_sym_iter_next(elfu_sym_iter_t* i, elfu_sym_t* sym) {
   if (!i || !sym) {
     seterr(ELFU_INVALID_ARG);
     return false;
   }
 
-  if (i->cursor >= i->total)
-    return false;
-
   const auto e = i->elf;
   const auto symtab = i->symtab;
   const auto entry_size = (e->class == CLASS64) ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
-  const auto off = symtab->hdr.sh_offset + i->cursor * entry_size;
 
-  if (off + entry_size < off || e->fsize < off + entry_size) {
-    seterr(ELFU_MALFORMED);
+  for (; i->cursor < i->total; i->cursor++) {
+    const auto off = symtab->hdr.sh_offset + i->cursor * entry_size;
+
+    if (off + entry_size < off || e->fsize < off + entry_size) {
+      seterr(ELFU_MALFORMED);
+      return false;
+    }
+
+    const char* name = nullptr;
+    const char* version = nullptr;
+    const auto raw = _elfu_read_sym(e, off);
+
+    if (ELF64_ST_TYPE(raw.st_info) == STT_SECTION && raw.st_shndx < SHN_LORESERVE &&
+        (name = elfu_get_section_name(e, raw.st_shndx)) == nullptr)
+      name = "<corrupt>";
+    if (!name && (name = _elfu_str(&i->strtab, raw.st_name)) == nullptr)
+      name = "<corrupt>";
+
+    if (i->filter && !i->filter(name, i->filter_ctx))
+      continue;
+
+    bool hidden = false;
+    if (i->has_version)
+      version = _elfu_get_sym_version(e, &i->version, &raw, i->cursor, &hidden);
+
+    uint64_t sh_addr = 0;
+    elfu_section_t section;
+    if (elfu_get_section(e, raw.st_shndx, &section))
+      sh_addr = section.hdr.sh_addr;
+
+    *sym = (elfu_sym_t){
+        .name = name,
+        .version = version,
+        .version_hidden = hidden,
+        .sh_addr = sh_addr,
+        .sym = raw,
+    };
+
+    i->cursor++;
+
+    return true;
+  }
+
+  return false;
+}
+
+bool elfu_sym_iter_seek(elfu_sym_iter_t* i, const size_t index) {
+  if (!i) {
+    seterr(ELFU_INVALID_ARG);
     return false;
   }
 
-  const char* name = nullptr;
-  const char* version = nullptr;
-  const auto raw = _elfu_read_sym(e, off);
+  if (index >= i->total)
+    return false;
 
-  if (ELF64_ST_TYPE(raw.st_info) == STT_SECTION && raw.st_shndx < SHN_LORESERVE &&
-      (name = elfu_get_section_name(e, raw.st_shndx)) == nullptr)
-    name = "<corrupt>";
-  if (!name && (name = elfu_strptr(e, symtab->hdr.sh_link, raw.st_name)) == nullptr)
-    name = "<corrupt>";
+  i->cursor = index;
+  return true;
+}
 
-  bool hidden = false;
-  if (i->has_version)
-    version = _elfu_get_sym_version(e, &i->version, &raw, i->cursor, &hidden);
+bool elfu_sym_iter_defines_version(const elfu_sym_iter_t* i, const char* name) {
+  if (!i || !i->has_version || !(i->version.flags & ELFU_VER_DEF))
+    return false;
 
-  uint64_t sh_addr = 0;
-  elfu_section_t section;
-  if (elfu_get_section(e, raw.st_shndx, &section))
-    sh_addr = section.hdr.sh_addr;
-
-  *sym = (elfu_sym_t){
-      .name = name,
-      .version = version,
-      .version_hidden = hidden,
-      .sh_addr = sh_addr,
-      .sym = raw,
-  };
+  const auto verdef = &i->version.verdef;
+  const auto e = verdef->elf;
+  const auto base = (uintptr_t)verdef->hdr.sh_offset;
+  const auto end = base + verdef->hdr.sh_size;
+  if (verdef->hdr.sh_size == 0 || e->fsize < base || e->fsize < end)
+    return false;
 
-  i->cursor++;
+  uintptr_t vnoff = 0;
+  for (size_t n = 0; n < verdef->hdr.sh_info; n++) {
+    auto cursor = base + vnoff;
+    if (cursor + sizeof(Elf64_Verdef) < cursor || end < cursor + sizeof(Elf64_Verdef))
+      return false;
 
-  return true;
+    const auto vd = _elfu_read_verdef(e, cursor);
+    cursor += vd.vd_aux;
+    if (cursor + sizeof(Elf64_Verdaux) < cursor || end < cursor + sizeof(Elf64_Verdaux))
+      return false;
+
+    const auto vdaux = _elfu_read_verdaux(e, cursor);
+    const auto defined = _elfu_str(&i->version.strtab, vdaux.vda_name);
+    if (defined && strcmp(defined, name) == 0)
+      return true;
+
+    if (vd.vd_next == 0)
+      break;
+    vnoff += vd.vd_next;
+  }
+
+  return false;
 }
 
+static void _elfu_dynamic_sym_iter(const elfu_t* e, elfu_sym_iter_t* i);
+
 bool elfu_get_sym_iter(const elfu_t* e, const elfu_section_t* symtab, elfu_sym_iter_t* i) {
   if (!e || !symtab) {
     seterr(ELFU_INVALID_ARG);
@@ -530,6 +776,14 @@ bool elfu_get_sym_iter(const elfu_t* e, const elfu_section_t* symtab, elfu_sym_i
       .total = count,
   };
 
+  // Without section header, the dynamic segment describes the string and version tables.
+  if (hdr.sh_type == SHT_DYNSYM && hdr.sh_link == SHN_UNDEF) {
+    _elfu_dynamic_sym_iter(e, &iter);
+    goto done;
+  }
+
+  elfu_get_section(e, hdr.sh_link, &iter.strtab);
+
   // If it is a dynsym section we're trying to iterate, we try to find the associated
   // version sections
   if (hdr.sh_type == SHT_DYNSYM) {
@@ -551,15 +805,29 @@ bool elfu_get_sym_iter(const elfu_t* e, const elfu_section_t* symtab, elfu_sym_i
         iter.version.verdef = verdef;
         iter.version.flags |= ELFU_VER_DEF;
       }
+
+      // Both are linked to the dynamic string table.
+      const auto link = (iter.version.flags & ELFU_VER_NEED) ? verneed.hdr.sh_link
+                                                             : verdef.hdr.sh_link;
+      if (iter.version.flags != ELFU_VER_NONE)
+        elfu_get_section(e, link, &iter.version.strtab);
     }
   }
 
+done:
+  // Every symbol is about to be read, along with its name and version.
+  _elfu_willneed(e, symtab);
+  _elfu_willneed(e, &iter.strtab);
+  if (iter.has_version)
+    _elfu_willneed(e, &iter.version.versym);
   *i = iter;
 
   return true;
 }
 
 bool elfu_get_section(const elfu_t* e, const size_t index, elfu_section_t* section) {
+  NM_STAT_INC(get_section);
+
   if (!e || !section || !e->flags.ehdr) {
     seterr(ELFU_INVALID_ARG);
     return false;
@@ -605,6 +873,419 @@ bool elfu_get_section(const elfu_t* e, const size_t index, elfu_section_t* secti
   return true;
 }
 
+static bool _elfu_read_gnu_hash(const elfu_t* e, elfu_hash_t* h) {
+  // https://flapenguin.me/elf-dt-gnu-hash
+  //  u32 nbuckets, symoffset, bloom_size, bloom_shift
+  //  ElfW(Addr) bloom[bloom_size]
+  //  u32 buckets[nbuckets]
+  //  u32 chain[]
+  const auto size = h->section.hdr.sh_size;
+  const auto data = h->section.data;
+  const size_t word = (e->class == CLASS64) ? sizeof(u64) : sizeof(u32);
+
+  if (size < 4 * sizeof(u32))
+    return false;
+
+  h->nbuckets = _elfu_load32(e, data);
+  h->symoffset = _elfu_load32(e, data + 4);
+  h->bloom_size = _elfu_load32(e, data + 8);
+  h->bloom_shift = _elfu_load32(e, data + 12);
+
+  // The sizes come from 32 bits fields, this can't overflow on a 64 bits size_t.
+  const auto bloom_off = 4 * sizeof(u32);
+  const auto buckets_off = bloom_off + (size_t)h->bloom_size * word;
+  const auto chain_off = buckets_off + (size_t)h->nbuckets * sizeof(u32);
+  // The second bloom bit is picked by shifting a 32 bits hash.
+  if (h->nbuckets == 0 || h->bloom_size == 0 || h->bloom_shift >= 32 || size < chain_off)
+    return false;
+
+  h->bloom = data + bloom_off;
+  h->buckets = data + buckets_off;
+  h->chain = data + chain_off;
+  h->nchain = (size - chain_off) / sizeof(u32);
+
+  return true;
+}
+
+static bool _elfu_read_sysv_hash(const elfu_t* e, elfu_hash_t* h) {
+  //  u32 nbucket, nchain
+  //  u32 buckets[nbucket]
+  //  u32 chain[nchain]
+  const auto size = h->section.hdr.sh_size;
+  const auto data = h->section.data;
+
+  if (size < 2 * sizeof(u32))
+    return false;
+
+  h->nbuckets = _elfu_load32(e, data);
+  const size_t nchain = _elfu_load32(e, data + 4);
+
+  const auto buckets_off = 2 * sizeof(u32);
+  const auto chain_off = buckets_off + (size_t)h->nbuckets * sizeof(u32);
+  if (h->nbuckets == 0 || size < chain_off + nchain * sizeof(u32))
+    return false;
+
+  h->buckets = data + buckets_off;
+  h->chain = data + chain_off;
+  h->nchain = nchain;
+
+  return true;
+}
+
+bool elfu_get_hash(const elfu_t* e, elfu_hash_t* hash) {
+  elfu_hash_t h = {};
+
+  if (_elfu_first_section_by_type(e, SHT_GNU_HASH, &h.section)) {
+    h.gnu = true;
+    if (!_elfu_read_gnu_hash(e, &h)) {
+      seterr(ELFU_MALFORMED);
+      return false;
+    }
+  } else if (_elfu_first_section_by_type(e, SHT_HASH, &h.section)) {
+    if (!_elfu_read_sysv_hash(e, &h)) {
+      seterr(ELFU_MALFORMED);
+      return false;
+    }
+  } else
+    return false;
+
+  *hash = h;
+  return true;
+}
+
+static u32 _elfu_gnu_hash(const char* name) {
+  u32 h = 5381;
+  for (; *name; name++)
+    h = (h << 5) + h + (u8)*name;
+  return h;
+}
+
+static u32 _elfu_sysv_hash(const char* name) {
+  u32 h = 0;
+  for (; *name; name++) {
+    h = (h << 4) + (u8)*name;
+    const auto g = h & 0xf0000000;
+    if (g)
+      h ^= g >> 24;
+    h &= ~g;
+  }
+  return h;
+}
+
+// Whether the symbol at `index` is a defined symbol named `name`.
+static bool _elfu_hash_match(const elfu_t* e,
+                             const elfu_section_t* symtab,
+                             const elfu_section_t* strtab,
+                             const size_t index,
+                             const char* name) {
+  const auto entry_size = (e->class == CLASS64) ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+  if (index >= symtab->hdr.sh_size / entry_size)
+    return false;
+
+  const auto sym = _elfu_read_sym(e, symtab->hdr.sh_offset + index * entry_size);
+  if (sym.st_shndx == SHN_UNDEF || sym.st_name >= strtab->hdr.sh_size)
+    return false;
+
+  // Bounded comparison, the string table might not be terminated.
+  const auto str = (const char*)strtab->data + sym.st_name;
+  const auto left = strtab->hdr.sh_size - sym.st_name;
+  size_t i = 0;
+  for (; i < left && name[i] && str[i] == name[i]; i++)
+    ;
+  return i < left && !name[i] && !str[i];
+}
+
+size_t elfu_hash_lookup(const elfu_hash_t* hash,
+                        const elfu_section_t* symtab,
+                        const char* name,
+                        size_t* out,
+                        const size_t max) {
+  if (!hash || !symtab || !name || !out) {
+    seterr(ELFU_INVALID_ARG);
+    return 0;
+  }
+
+  const auto e = hash->section.elf;
+  elfu_section_t strtab;
+  if (!elfu_get_section(e, symtab->hdr.sh_link, &strtab) || strtab.data == nullptr)
+    return 0;
+
+  const auto buckets = hash->buckets;
+  const auto chain = hash->chain;
+  size_t found = 0;
+
+  if (!hash->gnu) {
+    const auto h = _elfu_sysv_hash(name);
+    auto index = (size_t)_elfu_load32(e, buckets + (h % hash->nbuckets) * sizeof(u32));
+
+    // Bound the walk, a malformed chain could loop.
+    for (size_t steps = 0; index != STN_UNDEF && index < hash->nchain && steps < hash->nchain;
+         steps++) {
+      if (found < max && _elfu_hash_match(e, symtab, &strtab, index, name))
+        out[found++] = index;
+      index = _elfu_load32(e, chain + index * sizeof(u32));
+    }
+    return found;
+  }
+
+  const auto h = _elfu_gnu_hash(name);
+
+  // The bloom filter rejects most of the absent names without touching the buckets.
+  const size_t bits = (e->class == CLASS64) ? 64 : 32;
+  const size_t word_index = (h / bits) % hash->bloom_size;
+  const u64 word = (e->class == CLASS64)
+                       ? _elfu_load64(e, hash->bloom + word_index * sizeof(u64))
+                       : _elfu_load32(e, hash->bloom + word_index * sizeof(u32));
+  const u64 mask = (1ull << (h % bits)) | (1ull << ((h >> hash->bloom_shift) % bits));
+  if ((word & mask) != mask)
+    return 0;
+
+  size_t index = _elfu_load32(e, buckets + (h % hash->nbuckets) * sizeof(u32));
+  if (index < hash->symoffset)
+    return 0;
+
+  // Symbols sharing a bucket are contiguous, the last one of a chain has its low bit set.
+  for (; index - hash->symoffset < hash->nchain; index++) {
+    const auto h2 = _elfu_load32(e, chain + (index - hash->symoffset) * sizeof(u32));
+    if ((h | 1) == (h2 | 1) && found < max &&
+        _elfu_hash_match(e, symtab, &strtab, index, name))
+      out[found++] = index;
+    if (h2 & 1)
+      break;
+  }
+
+  return found;
+}
+
+bool elfu_get_phdr(const elfu_t* e, const size_t index, elfu_phdr_t* phdr) {
+  if (!e || !phdr || !e->flags.ehdr || index >= e->ehdr.e_phnum) {
+    seterr(ELFU_INVALID_ARG);
+    return false;
+  }
+
+  const auto hdrsize = e->ehdr.e_phentsize;
+  const auto expected = (e->class == CLASS64) ? sizeof(Elf64_Phdr) : sizeof(Elf32_Phdr);
+  const auto off = e->ehdr.e_phoff + index * hdrsize;
+
+  // overflow OR out of bounds
+  if (hdrsize != expected || off + hdrsize < off || e->fsize < off + hdrsize) {
+    seterr(ELFU_MALFORMED);
+    return false;
+  }
+
+  *phdr = _elfu_read_phdr(e, off);
+  return true;
+}
+
+bool elfu_vaddr_to_offset(const elfu_t* e, const u64 vaddr, u64* offset) {
+  elfu_phdr_t phdr;
+
+  for (size_t i = 0; e && e->flags.ehdr && i < e->ehdr.e_phnum; i++) {
+    if (!elfu_get_phdr(e, i, &phdr))
+      return false;
+    if (phdr.p_type != PT_LOAD || vaddr < phdr.p_vaddr ||
+        vaddr - phdr.p_vaddr >= phdr.p_filesz)
+      continue;
+
+    const auto off = phdr.p_offset + (vaddr - phdr.p_vaddr);
+    if (off < phdr.p_offset || e->fsize <= off)
+      return false;
+    *offset = off;
+    return true;
+  }
+
+  return false;
+}
+
+bool elfu_get_dynamic(const elfu_t* e, elfu_dynamic_t* dynamic) {
+  if (!e || !dynamic || !e->flags.ehdr) {
+    seterr(ELFU_INVALID_ARG);
+    return false;
+  }
+
+  elfu_phdr_t phdr;
+  size_t i = 0;
+  for (; i < e->ehdr.e_phnum; i++) {
+    if (!elfu_get_phdr(e, i, &phdr))
+      return false;
+    if (phdr.p_type == PT_DYNAMIC)
+      break;
+  }
+  if (i == e->ehdr.e_phnum)
+    return false;
+
+  const auto start = phdr.p_offset;
+  const auto end = phdr.p_offset + phdr.p_filesz;
+  if (end < start || e->fsize < end) {
+    seterr(ELFU_MALFORMED);
+    return false;
+  }
+
+  const auto entry_size = (e->class == CLASS64) ? sizeof(Elf64_Dyn) : sizeof(Elf32_Dyn);
+  *dynamic = (elfu_dynamic_t){
+      .data = e->raw + phdr.p_offset,
+      .count = phdr.p_filesz / entry_size,
+      .elf = e,
+  };
+
+  // Everything past the terminator is padding.
+  elfu_dyn_t dyn;
+  for (i = 0; elfu_dynamic_get(dynamic, i, &dyn); i++) {
+    if (dyn.d_tag == DT_NULL) {
+      dynamic->count = i;
+      break;
+    }
+  }
+
+  return true;
+}
+
+bool elfu_dynamic_get(const elfu_dynamic_t* dynamic,
+                      const size_t index,
+                      elfu_dyn_t* dyn) {
+  if (!dynamic || !dyn || index >= dynamic->count)
+    return false;
+
+  const auto e = dynamic->elf;
+  const auto entry_size = (e->class == CLASS64) ? sizeof(Elf64_Dyn) : sizeof(Elf32_Dyn);
+  *dyn = _elfu_read_dyn(e, (uintptr_t)(dynamic->data - e->raw) + index * entry_size);
+  return true;
+}
+
+bool elfu_dynamic_find(const elfu_dynamic_t* dynamic, const int64_t tag, u64* value) {
+  elfu_dyn_t dyn;
+
+  for (size_t i = 0; elfu_dynamic_get(dynamic, i, &dyn); i++) {
+    if (dyn.d_tag == tag) {
+      *value = dyn.d_un.d_val;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// A section without header, located by the dynamic entry `tag`. At most `size` bytes,
+// clamped to the end of the file.
+static bool _elfu_dynamic_section(const elfu_dynamic_t* d,
+                                  const int64_t tag,
+                                  const u32 type,
+                                  u64 size,
+                                  elfu_section_t* section) {
+  const auto e = d->elf;
+  u64 vaddr, off;
+
+  if (!elfu_dynamic_find(d, tag, &vaddr) || !elfu_vaddr_to_offset(e, vaddr, &off))
+    return false;
+  if (size > e->fsize - off)
+    size = e->fsize - off;
+
+  *section = (elfu_section_t){
+      .hdr = {.sh_type = type, .sh_addr = vaddr, .sh_offset = off, .sh_size = size},
+      .data = e->raw + off,
+      .elf = e,
+  };
+  return true;
+}
+
+// The dynamic segment has no symbol count, it is recovered from the hash tables.
+static size_t _elfu_dynamic_symcount(const elfu_dynamic_t* d, const u64 symtab) {
+  const auto e = d->elf;
+  elfu_hash_t h = {};
+
+  // The number of chain entries of a SysV table is the number of symbols.
+  if (_elfu_dynamic_section(d, DT_HASH, SHT_HASH, UINT64_MAX, &h.section) &&
+      _elfu_read_sysv_hash(e, &h))
+    return h.nchain;
+
+  // With GNU, the chain of the highest bucket ends with the last symbol.
+  if (_elfu_dynamic_section(d, DT_GNU_HASH, SHT_GNU_HASH, UINT64_MAX, &h.section) &&
+      _elfu_read_gnu_hash(e, &h)) {
+    size_t last = 0;
+    for (size_t b = 0; b < h.nbuckets; b++) {
+      const size_t index = _elfu_load32(e, h.buckets + b * sizeof(u32));
+      if (index > last)
+        last = index;
+    }
+    if (last < h.symoffset)
+      return h.symoffset;
+
+    for (; last - h.symoffset < h.nchain; last++) {
+      if (_elfu_load32(e, h.chain + (last - h.symoffset) * sizeof(u32)) & 1)
+        return last + 1;
+    }
+    return 0;
+  }
+
+  // No hash table, the linkers place the string table right after the symbols.
+  u64 strtab;
+  const auto entry_size = (e->class == CLASS64) ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+  if (elfu_dynamic_find(d, DT_STRTAB, &strtab) && strtab > symtab)
+    return (strtab - symtab) / entry_size;
+  return 0;
+}
+
+static bool _elfu_dynsym_from_dynamic(const elfu_t* e, elfu_section_t* dynsymtab) {
+  elfu_dynamic_t d;
+  if (!elfu_get_dynamic(e, &d))
+    return false;
+
+  const auto entry_size = (e->class == CLASS64) ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+  u64 syment = entry_size;
+  elfu_dynamic_find(&d, DT_SYMENT, &syment);
+
+  elfu_section_t section;
+  if (!_elfu_dynamic_section(&d, DT_SYMTAB, SHT_DYNSYM, UINT64_MAX, &section))
+    return false;
+
+  const auto count = _elfu_dynamic_symcount(&d, section.hdr.sh_addr);
+  if (count == 0 || syment != entry_size || section.hdr.sh_size / entry_size < count) {
+    seterr(ELFU_MALFORMED);
+    return false;
+  }
+
+  section.hdr.sh_size = count * entry_size;
+  section.hdr.sh_entsize = entry_size;
+  section.hdr.sh_link = SHN_UNDEF;
+  *dynsymtab = section;
+  return true;
+}
+
+bool elfu_get_dynsymtab(const elfu_t* e, elfu_section_t* dynsymtab) {
+  if (_elfu_first_section_by_type(e, SHT_DYNSYM, dynsymtab))
+    return true;
+  return _elfu_dynsym_from_dynamic(e, dynsymtab);
+}
+
+static void _elfu_dynamic_sym_iter(const elfu_t* e, elfu_sym_iter_t* i) {
+  elfu_dynamic_t d;
+  if (!elfu_get_dynamic(e, &d))
+    return;
+
+  u64 strsz = 0;
+  elfu_dynamic_find(&d, DT_STRSZ, &strsz);
+  _elfu_dynamic_section(&d, DT_STRTAB, SHT_STRTAB, strsz, &i->strtab);
+
+  auto v = &i->version;
+  if (!_elfu_dynamic_section(&d, DT_VERSYM, SHT_GNU_versym, i->total * sizeof(u16),
+                             &v->versym))
+    return;
+  i->has_version = true;
+  v->strtab = i->strtab;
+
+  u64 num;
+  if (elfu_dynamic_find(&d, DT_VERNEEDNUM, &num) &&
+      _elfu_dynamic_section(&d, DT_VERNEED, SHT_GNU_verneed, UINT64_MAX, &v->verneed)) {
+    v->verneed.hdr.sh_info = (u32)num;
+    v->flags |= ELFU_VER_NEED;
+  }
+  if (elfu_dynamic_find(&d, DT_VERDEFNUM, &num) &&
+      _elfu_dynamic_section(&d, DT_VERDEF, SHT_GNU_verdef, UINT64_MAX, &v->verdef)) {
+    v->verdef.hdr.sh_info = (u32)num;
+    v->flags |= ELFU_VER_DEF;
+  }
+}
+
 const char* elfu_get_section_name(const elfu_t* e, const size_t index) {
   if (!e || !e->flags.ehdr) {
     seterr(ELFU_INVALID_ARG);
@@ -622,37 +1303,23 @@ const char* elfu_strptr(const elfu_t* e, const size_t index, const size_t str) {
   elfu_section_t strtab;
   if (!elfu_get_section(e, index, &strtab))
     return nullptr;
-
-  const auto start = (uintptr_t)strtab.data;
-  const auto end = (uintptr_t)(strtab.data + str);
-
-  if (end < start)
-    return nullptr;
-
-  if (e->fsize < end - (uintptr_t)e->raw)
-    return nullptr;
-
-  // We do this check to ensure the strtab is actually null terminated and that in the
-  // worst case we don't read out of bounds.
-  const auto strtab_size = strtab.hdr.sh_size;
-  if (strtab_size == 0)
-    return nullptr;
-  if (*(strtab.data + strtab_size - 1) != 0 && *(strtab.data + strtab_size) != 0)
-    return nullptr;
-
-  return (const char*)(strtab.data + str);
+  return _elfu_str(&strtab, str);
 }
 
 void elfu_destroy(elfu_t** e) {
   if (!e || !*e)
     return;
 
-  if ((*e)->raw && (*e)->raw != MAP_FAILED)
+  if ((*e)->flags.mapped)
     munmap((*e)->raw, (*e)->fsize);
   free(*e);
   *e = nullptr;
 }
 
+void _elfu_seterr(const elfu_err_t err) {
+  seterr(err);
+}
+
 void elfu_reset_err() {
   g_err = ELFU_SUCCESS;
 }
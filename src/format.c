@@ -0,0 +1,416 @@
+#include <nm/format.h>
+#include <string.h>
+
+#define HEX "0123456789abcdef"
+
+static const char g_blank[] = "                ";
+
+// Zero padded hex, `width` digits.
+static void put_hex(nm_out_t* out, u64 value, const size_t width) {
+  char buffer[16];
+  char* h = buffer + width;
+
+  while (h != buffer) {
+    *--h = HEX[value % 16];
+    value /= 16;
+  }
+  nm_out_write(out, buffer, width);
+}
+
+// Hex without padding.
+static void put_hex_short(nm_out_t* out, const u64 value) {
+  size_t digits = 1;
+  while (digits < 16 && (value >> (4 * digits)))
+    digits++;
+  put_hex(out, value, digits);
+}
+
+static void put_dec(nm_out_t* out, u64 v) {
+  char buffer[24];
+  char* p = buffer + sizeof(buffer);
+
+  do {
+    *--p = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  nm_out_write(out, p, (size_t)(buffer + sizeof(buffer) - p));
+}
+
+static const char* symbol_name(const nm_fmt_ctx_t* ctx, const nm_symbol_t* s) {
+  return ctx->demangler ? nm_demangle(ctx->demangler, s->name) : s->name;
+}
+
+// Write the symbol name and version, returns the number of bytes written.
+static size_t put_name(nm_out_t* out, const nm_fmt_ctx_t* ctx, const nm_symbol_t* s) {
+  const auto name = symbol_name(ctx, s);
+  size_t len = strlen(name);
+  nm_out_write(out, name, len);
+
+  if (s->version) {
+    const auto vlen = strlen(s->version);
+    nm_out_write(out, "@@", s->version_hidden ? 1 : 2);
+    nm_out_write(out, s->version, vlen);
+    len += vlen + (s->version_hidden ? 1 : 2);
+  }
+  return len;
+}
+
+#define is_undefined(s) ((s)->internal.st_shndx == SHN_UNDEF)
+
+// Name of the section owning the symbol, like nm (bfd) names them.
+static const char* section_name(const nm_fmt_ctx_t* ctx, const size_t index) {
+  switch (index) {
+    case SHN_UNDEF:
+      return "*UND*";
+    case SHN_ABS:
+      return "*ABS*";
+    case SHN_COMMON:
+      return "*COM*";
+    default:
+      break;
+  }
+  // Symbols pointing to a section that doesn't exist are absolute.
+  if (index >= ctx->sections->count)
+    return "*ABS*";
+  return ctx->sections->entries[index].name;
+}
+
+static void put_section(nm_out_t* out, const nm_fmt_ctx_t* ctx, const nm_symbol_t* s) {
+  if (!ctx->print_section)
+    return;
+  nm_out_putc(out, '\t');
+  nm_out_puts(out, section_name(ctx, s->internal.st_shndx));
+}
+
+static void put_path(nm_out_t* out,
+                     const elfu_line_t* line,
+                     void (*put)(nm_out_t* out, const char* s)) {
+  const char* dirs[] = {line->comp_dir, line->dir};
+  for (size_t i = 0; i < 2; i++) {
+    if (dirs[i]) {
+      put(out, dirs[i]);
+      nm_out_putc(out, '/');
+    }
+  }
+  put(out, line->file);
+}
+
+// Source location of a defined symbol, like nm (bfd) `\tFILE:LINE` after everything else.
+static void put_line(nm_out_t* out, const nm_fmt_ctx_t* ctx, const nm_symbol_t* s) {
+  elfu_line_t line;
+  if (!ctx->lines || !elfu_lines_find(ctx->lines, &s->internal, &line))
+    return;
+
+  nm_out_putc(out, '\t');
+  put_path(out, &line, nm_out_puts);
+  nm_out_putc(out, ':');
+  put_dec(out, line.line);
+}
+
+/* bsd */
+
+static void bsd_header(nm_out_t* out, const nm_fmt_ctx_t* ctx) {
+  if (!ctx->print_filename)
+    return;
+  nm_out_putc(out, '\n');
+  nm_out_puts(out, ctx->file);
+  nm_out_write(out, ":\n", 2);
+}
+
+static void bsd_symbol(nm_out_t* out, const nm_fmt_ctx_t* ctx, const nm_symbol_t* s) {
+  // Like nm, the size takes the place of the value when sorting by size, unless it has
+  // its own column.
+  const auto size_as_value = ctx->size_as_value && !ctx->print_size;
+
+  if (is_undefined(s))
+    nm_out_write(out, g_blank, ctx->width);
+  else
+    put_hex(out, size_as_value ? s->internal.st_size : s->value, ctx->width);
+  if (ctx->print_size && !is_undefined(s) && s->internal.st_size) {
+    nm_out_putc(out, ' ');
+    put_hex(out, s->internal.st_size, ctx->width);
+  }
+
+  nm_out_write(out, (char[]){' ', (char)s->type, ' '}, 3);
+  put_name(out, ctx, s);
+  put_section(out, ctx, s);
+  put_line(out, ctx, s);
+  nm_out_putc(out, '\n');
+}
+
+/* posix */
+
+static void posix_header(nm_out_t* out, const nm_fmt_ctx_t* ctx) {
+  if (!ctx->print_filename)
+    return;
+  nm_out_puts(out, ctx->file);
+  nm_out_write(out, ":\n", 2);
+}
+
+static void posix_symbol(nm_out_t* out, const nm_fmt_ctx_t* ctx, const nm_symbol_t* s) {
+  put_name(out, ctx, s);
+  nm_out_write(out, (char[]){' ', (char)s->type, ' '}, 3);
+  if (is_undefined(s))
+    nm_out_write(out, g_blank, 8);
+  else {
+    put_hex_short(out, s->value);
+    nm_out_putc(out, ' ');
+    if (s->internal.st_size)
+      put_hex_short(out, s->internal.st_size);
+  }
+  put_section(out, ctx, s);
+  put_line(out, ctx, s);
+  nm_out_putc(out, '\n');
+}
+
+/* sysv */
+
+static void sysv_header(nm_out_t* out, const nm_fmt_ctx_t* ctx) {
+  nm_out_puts(out, ctx->undefined_only ? "\n\nUndefined symbols from " : "\n\nSymbols from ");
+  nm_out_puts(out, ctx->file);
+  nm_out_puts(out, ":\n\n");
+  if (ctx->width == 8)
+    nm_out_puts(out, "Name                  Value   Class        Type         Size     Line  Section\n\n");
+  else
+    nm_out_puts(out,
+                "Name                  Value           Class        Type         Size         "
+                "    Line  Section\n\n");
+}
+
+static const char* sysv_type(const u8 type, char* buffer) {
+  switch (type) {
+    case STT_NOTYPE:
+      return "NOTYPE";
+    case STT_OBJECT:
+      return "OBJECT";
+    case STT_FUNC:
+      return "FUNC";
+    case STT_SECTION:
+      return "SECTION";
+    case STT_FILE:
+      return "FILE";
+    case STT_COMMON:
+      return "COMMON";
+    case STT_TLS:
+      return "TLS";
+    default:
+      break;
+  }
+
+  const char* prefix = "<unknown>: ";
+  if (type >= STT_LOPROC && type <= STT_HIPROC)
+    prefix = "<processor specific>: ";
+  else if (type >= STT_LOOS && type <= STT_HIOS)
+    prefix = "<OS specific>: ";
+
+  const auto len = strlen(prefix);
+  memcpy(buffer, prefix, len);
+  char* p = buffer + len;
+  if (type >= 10)
+    *p++ = (char)('0' + type / 10);
+  *p++ = (char)('0' + type % 10);
+  *p = 0;
+  return buffer;
+}
+
+static void sysv_symbol(nm_out_t* out, const nm_fmt_ctx_t* ctx, const nm_symbol_t* s) {
+  const auto len = put_name(out, ctx, s);
+  if (len < 20)
+    nm_out_write(out, "                    ", 20 - len);
+  nm_out_putc(out, '|');
+
+  if (is_undefined(s))
+    nm_out_write(out, g_blank, ctx->width);
+  else
+    put_hex(out, s->value, ctx->width);
+  nm_out_write(out, (char[]){'|', ' ', ' ', ' ', (char)s->type, ' ', ' ', '|'}, 8);
+
+  // Like nm (bfd), section symbols have neither a type nor a section.
+  const auto section_sym = ELF64_ST_TYPE(s->internal.st_info) == STT_SECTION;
+
+  char buffer[32];
+  const auto type =
+      section_sym ? "" : sysv_type(ELF64_ST_TYPE(s->internal.st_info), buffer);
+  const auto tlen = strlen(type);
+  if (tlen < 18)
+    nm_out_write(out, "                  ", 18 - tlen);
+  nm_out_write(out, type, tlen);
+  nm_out_putc(out, '|');
+
+  if (s->internal.st_size)
+    put_hex(out, s->internal.st_size, ctx->width);
+  else
+    nm_out_write(out, g_blank, ctx->width);
+
+  nm_out_write(out, "|     |", 7);
+  if (!section_sym)
+    nm_out_puts(out, section_name(ctx, s->internal.st_shndx));
+  put_line(out, ctx, s);
+  nm_out_putc(out, '\n');
+}
+
+/* json */
+
+// Escaped string contents, without the quotes.
+static void json_put_raw(nm_out_t* out, const char* s) {
+  for (; *s; s++) {
+    const auto c = (u8)*s;
+
+    if (c == '"' || c == '\\') {
+      nm_out_putc(out, '\\');
+      nm_out_putc(out, (char)c);
+    } else if (c < 0x20) {
+      nm_out_write(out, "\\u00", 4);
+      nm_out_putc(out, HEX[c >> 4]);
+      nm_out_putc(out, HEX[c & 0xf]);
+    } else
+      nm_out_putc(out, (char)c);
+  }
+}
+
+static void json_put_string(nm_out_t* out, const char* s) {
+  nm_out_putc(out, '"');
+  json_put_raw(out, s);
+  nm_out_putc(out, '"');
+}
+
+static void json_symbol(nm_out_t* out, const nm_fmt_ctx_t* ctx, const nm_symbol_t* s) {
+  nm_out_puts(out, "{\"file\":");
+  json_put_string(out, ctx->file);
+  nm_out_puts(out, ",\"name\":");
+  json_put_string(out, symbol_name(ctx, s));
+  if (s->version) {
+    nm_out_puts(out, ",\"version\":");
+    json_put_string(out, s->version);
+    nm_out_puts(out, s->version_hidden ? ",\"default\":false" : ",\"default\":true");
+  }
+  nm_out_puts(out, ",\"type\":\"");
+  nm_out_putc(out, (char)s->type);
+  nm_out_puts(out, "\",\"value\":");
+  // Hex strings, 64 bits addresses don't fit in a JSON number.
+  if (!is_undefined(s)) {
+    nm_out_putc(out, '"');
+    put_hex(out, s->value, ctx->width);
+    nm_out_putc(out, '"');
+  } else
+    nm_out_puts(out, "null");
+  nm_out_puts(out, ",\"size\":");
+  put_dec(out, s->internal.st_size);
+  if (ctx->print_section) {
+    nm_out_puts(out, ",\"section\":");
+    json_put_string(out, section_name(ctx, s->internal.st_shndx));
+  }
+
+  elfu_line_t line;
+  if (ctx->lines && elfu_lines_find(ctx->lines, &s->internal, &line)) {
+    nm_out_puts(out, ",\"source\":\"");
+    put_path(out, &line, json_put_raw);
+    nm_out_puts(out, "\",\"line\":");
+    put_dec(out, line.line);
+  }
+  nm_out_puts(out, "}\n");
+}
+
+const nm_formatter_t nm_formatters[] = {
+    [NM_FORMAT_BSD] = {.name = "bsd", .header = bsd_header, .symbol = bsd_symbol},
+    [NM_FORMAT_POSIX] = {.name = "posix", .header = posix_header, .symbol = posix_symbol},
+    [NM_FORMAT_SYSV] = {.name = "sysv", .header = sysv_header, .symbol = sysv_symbol},
+    [NM_FORMAT_JSON] = {.name = "json", .symbol = json_symbol},
+    [NM_FORMAT_BINARY] = {.name = "binary"},
+};
+
+int nm_format_by_name(const char* name) {
+  for (size_t i = 0; i < sizeof(nm_formatters) / sizeof(nm_formatters[0]); i++) {
+    if (strcmp(nm_formatters[i].name, name) == 0)
+      return (int)i;
+  }
+  return -1;
+}
+
+void nm_format_symbol(nm_out_t* out,
+                      const nm_fmt_ctx_t* ctx,
+                      const nm_format_t format,
+                      const nm_symbol_t* s) {
+  const auto symbol = nm_formatters[format].symbol;
+  (symbol ? symbol : bsd_symbol)(out, ctx, s);
+}
+
+/* binary */
+
+#define align8(v) (((v) + 7) & ~(u64)7)
+
+bool nm_format_binary(nm_out_t* out,
+                      const nm_fmt_ctx_t* ctx,
+                      const nm_symbol_t* symbols,
+                      const nm_key_t* order,
+                      const size_t count) {
+  const auto file = ctx->file;
+
+  // First pass to size the strings, so that the header can be written up front.
+  u64 strings_size = strlen(file) + 1;
+  for (size_t i = 0; i < count; i++) {
+    const auto s = &symbols[order[i].index];
+    strings_size += strlen(s->name) + 1;
+    if (s->version)
+      strings_size += strlen(s->version) + 1;
+  }
+  // The last offset stays below NM_BIN_NO_STRING.
+  if (strings_size > UINT32_MAX)
+    return false;
+
+  const auto strings_offset = sizeof(nm_bin_header_t) + count * sizeof(nm_bin_record_t);
+  const auto total_size = align8(strings_offset + strings_size);
+
+  nm_bin_header_t header = {
+      .version = NM_BIN_VERSION,
+      .record_size = sizeof(nm_bin_record_t),
+      .count = count,
+      .strings_offset = strings_offset,
+      .strings_size = strings_size,
+      .total_size = total_size,
+      .file = 0,
+      .flags = (ctx->width == 16) ? NM_BIN_OBJECT_64 : 0,
+  };
+  memcpy(header.magic, NM_BIN_MAGIC, sizeof(header.magic));
+  nm_out_write(out, &header, sizeof(header));
+
+  // The strings are laid out in record order, right after the object path.
+  u64 str = strlen(file) + 1;
+  for (size_t i = 0; i < count; i++) {
+    const auto s = &symbols[order[i].index];
+    nm_bin_record_t record = {
+        .value = s->value,
+        .size = s->internal.st_size,
+        .name = (u32)str,
+        .version = NM_BIN_NO_STRING,
+        .type = (u8)s->type,
+        .info = s->internal.st_info,
+        .other = s->internal.st_other,
+        .shndx = s->internal.st_shndx,
+    };
+
+    str += strlen(s->name) + 1;
+    if (s->version) {
+      record.version = (u32)str;
+      str += strlen(s->version) + 1;
+    }
+    if (s->version_hidden)
+      record.flags |= NM_BIN_SYM_VERSION_HIDDEN;
+    if (is_undefined(s))
+      record.flags |= NM_BIN_SYM_UNDEFINED;
+
+    nm_out_write(out, &record, sizeof(record));
+  }
+
+  nm_out_write(out, file, strlen(file) + 1);
+  for (size_t i = 0; i < count; i++) {
+    const auto s = &symbols[order[i].index];
+    nm_out_write(out, s->name, strlen(s->name) + 1);
+    if (s->version)
+      nm_out_write(out, s->version, strlen(s->version) + 1);
+  }
+
+  constexpr char padding[8] = {};
+  nm_out_write(out, padding, total_size - strings_offset - strings_size);
+  return true;
+}
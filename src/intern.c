@@ -0,0 +1,70 @@
+#include <nm/nm.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Open addressing table, slots hold `id + 1` so that zero means empty.
+
+#define INTERN_MIN_SLOTS 64
+
+static bool intern_grow(nm_intern_t* t) {
+  const auto cap = t->cap ? t->cap * 2 : INTERN_MIN_SLOTS;
+
+  u32* slots = calloc(cap, sizeof(u32));
+  nm_interned_t* entries = realloc(t->entries, (cap / 2) * sizeof(nm_interned_t));
+  if (!slots || !entries) {
+    free(slots);
+    if (entries)
+      t->entries = entries;
+    return false;
+  }
+
+  for (size_t id = 0; id < t->count; id++) {
+    auto slot = entries[id].hash & (cap - 1);
+    while (slots[slot])
+      slot = (slot + 1) & (cap - 1);
+    slots[slot] = id + 1;
+  }
+
+  free(t->slots);
+  t->slots = slots;
+  t->entries = entries;
+  t->cap = cap;
+
+  return true;
+}
+
+bool nm_intern(nm_intern_t* t, const char* name, u32* id) {
+  // Keep the load factor at or below 1/2.
+  if (t->count >= t->cap / 2 && !intern_grow(t))
+    return false;
+
+  u32 len;
+  const auto hash = nm_strhash(name, &len);
+
+  auto slot = hash & (t->cap - 1);
+  while (t->slots[slot]) {
+    const auto e = &t->entries[t->slots[slot] - 1];
+    if (e->hash == hash && e->len == len &&
+        (e->name == name || memcmp(e->name, name, len) == 0)) {
+      *id = t->slots[slot] - 1;
+      return true;
+    }
+    slot = (slot + 1) & (t->cap - 1);
+  }
+
+  *id = t->count;
+  t->slots[slot] = t->count + 1;
+  t->entries[t->count++] = (nm_interned_t){
+      .name = name,
+      .hash = hash,
+      .len = len,
+  };
+
+  return true;
+}
+
+void nm_intern_destroy(nm_intern_t* t) {
+  free(t->slots);
+  free(t->entries);
+  *t = (nm_intern_t){};
+}
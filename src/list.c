@@ -0,0 +1,471 @@
+#include <stdlib.h>
+
+#include <nm/list.h>
+#include <nm/stats.h>
+
+#define shndx(s) ((s).st_shndx)
+
+static nm_sym_type_t nm_sym_type(const nm_sections_t* sections, const Elf64_Sym s) {
+  const auto type = ELF64_ST_TYPE(s.st_info);
+  const auto bind = ELF64_ST_BIND(s.st_info);
+
+  if (shndx(s) == SHN_COMMON)
+    return SYM_COMMON_G;
+  if (shndx(s) == SHN_UNDEF) {
+    if (bind == STB_WEAK)
+      return (type == STT_OBJECT) ? SYM_WEAK_OBJ_L : SYM_WEAK_L;
+    return SYM_UNDEFINED;
+  }
+
+  if (type == STT_GNU_IFUNC)
+    return SYM_INDIR;
+  if (bind == STB_GNU_UNIQUE)
+    return SYM_UNIQUE_GLOBAL;
+  if (bind == STB_WEAK)
+    return (type == STT_OBJECT) ? SYM_WEAK_OBJ_G : SYM_WEAK_G;
+
+  nm_sym_type_t stype;
+  if (shndx(s) == SHN_ABS)
+    stype = SYM_ABSOLUTE_L;
+  else if (sections->nsegments)
+    stype = nm_segments_type(sections, s.st_value, type == STT_TLS);
+  else
+    stype = nm_sections_type(sections, shndx(s));
+  if (stype != SYM_UNKNOWN && bind == STB_GLOBAL)
+    return stype - 32;
+
+  return stype;
+}
+
+static bool nm_keep_symbol(const nm_list_opts_t* opts, const Elf64_Sym s) {
+  const auto type = ELF64_ST_TYPE(s.st_info);
+  const auto bind = ELF64_ST_BIND(s.st_info);
+
+  if (!opts->no_filter && (type == STT_FILE || type == STT_SECTION))
+    return false;
+
+  if (opts->only_undefined)
+    return (s.st_shndx == SHN_UNDEF);
+  if (opts->only_external)
+    return (bind == STB_GLOBAL || bind == STB_WEAK || bind == STB_GNU_UNIQUE);
+
+  return true;
+}
+
+nm_symbol_t nm_make_symbol(const elfu_t* obj,
+                           const nm_sections_t* sections,
+                           const elfu_sym_t* s,
+                           const size_t pos) {
+  const auto type = nm_sym_type(sections, s->sym);
+  // Again, cryptic case by nm. If the object is one of these two types, defined symbols
+  // will add the sh_addr to their value.
+  // readelf doesn't do that. elfutils nm neither.
+  const auto reloff =
+      (obj->ehdr.e_type == ET_EXEC || obj->ehdr.e_type == ET_DYN) ? 0 : s->sh_addr;
+  const auto value = (type == SYM_UNDEFINED || type == SYM_WEAK_OBJ_L || type == SYM_WEAK_L)
+                         ? 0
+                         : s->sym.st_value + reloff;
+
+  return (nm_symbol_t){
+      .name = s->name,
+      .version = s->version,
+      .version_hidden = s->version_hidden,
+      .type = type,
+      .value = value,
+      .internal = s->sym,
+      .pos = pos,
+      .key = {.prefix = nm_strprefix(s->name)},
+  };
+}
+
+bool nm_list_symtab(const elfu_t* obj,
+                    const nm_list_opts_t* opts,
+                    elfu_section_t* symtab) {
+  return opts->dynamic ? elfu_get_dynsymtab(obj, symtab) : elfu_get_symtab(obj, symtab);
+}
+
+static bool nm_match_filter(const char* name, const void* ctx) {
+  return nm_match(ctx, name);
+}
+
+ssize_t nm_process_symtab(const elfu_t* obj,
+                          const nm_sections_t* sections,
+                          const nm_list_opts_t* opts,
+                          const elfu_section_t* symtab,
+                          vector(nm_symbol_t) * symbols,
+                          nm_intern_t* names,
+                          bool* has_symbols) {
+  ssize_t ret = -1;
+  vector(nm_symbol_t) symvec = *symbols;
+  elfu_sym_iter_t iter;
+  if (!elfu_get_sym_iter(obj, symtab, &iter))
+    return -1;
+  // Filter on the raw names, the others are never classified nor versioned.
+  if (opts->match) {
+    iter.filter = nm_match_filter;
+    iter.filter_ctx = opts->match;
+  }
+
+  elfu_sym_t s;
+  while (elfu_sym_iter_next(&iter, &s)) {
+    if (!nm_keep_symbol(opts, s.sym))
+      continue;
+
+    auto symbol = nm_make_symbol(obj, sections, &s, iter.cursor);
+    symbol.key.index = (u32)vector_len(symvec);
+
+    if (names && !nm_intern(names, s.name, &symbol.key.id))
+      goto err;
+    if (!vector_push(symvec, symbol))
+      goto err;
+  }
+
+  *has_symbols = (iter.total > 1);
+  ret = (ssize_t)iter.total;
+
+err:
+  *symbols = symvec;
+  return ret;
+}
+
+static int nm_cmp_name(const nm_key_t* a, const nm_key_t* b, const void* ctx) {
+  const nm_intern_t* names = ctx;
+  NM_STAT_INC(compares);
+
+  int cmp;
+  if (a->prefix != b->prefix)
+    cmp = (a->prefix < b->prefix) ? -1 : 1;
+  else if (a->id == b->id)
+    cmp = 0;
+  else {
+    // Different names sharing the prefix, both are at least 8 bytes long.
+    const auto na = names->entries[a->id].name;
+    const auto nb = names->entries[b->id].name;
+    cmp = nm_strcmp(na + sizeof(u64), nb + sizeof(u64));
+  }
+
+  // Symbols are collected in table order, the index is an equivalent tie-break to `pos`.
+  if (cmp == 0)
+    cmp = (a->index < b->index) ? -1 : 1;
+  return cmp;
+}
+
+static int nm_cmp_name_reverse(const nm_key_t* a, const nm_key_t* b, const void* ctx) {
+  return -nm_cmp_name(a, b, ctx);
+}
+
+/*!
+ * Order the symbols by address (-n) or by size (--size-sort) into \a keys using a radix
+ * sort, symbols sharing the same address or size are ordered by name like nm does.
+ * When sorting by size, undefined, absolute and zero-sized symbols are dropped.
+ * @return The number of keys written, \c -1 on error.
+ */
+static ssize_t nm_sort_numeric(const nm_list_opts_t* opts,
+                               const nm_symbol_t* symbols,
+                               const size_t count,
+                               nm_key_t* keys,
+                               const nm_intern_t* names) {
+  nm_rkey_t* rkeys = malloc(count * sizeof(nm_rkey_t));
+  if (count && !rkeys)
+    return -1;
+
+  size_t n = 0;
+  // Undefined symbols come first when sorting by address.
+  for (size_t i = 0; !opts->size_sort && i < count; i++) {
+    if (symbols[i].internal.st_shndx == SHN_UNDEF)
+      rkeys[n++] = (nm_rkey_t){.value = symbols[i].value, .index = i};
+  }
+
+  const auto undefined = n;
+  for (size_t i = 0; i < count; i++) {
+    const auto s = &symbols[i];
+    if (s->internal.st_shndx == SHN_UNDEF)
+      continue;
+    // Like nm, absolute symbols are dropped too when sorting by size.
+    if (opts->size_sort && (s->internal.st_size == 0 || s->internal.st_shndx == SHN_ABS))
+      continue;
+
+    const auto value = opts->size_sort ? s->internal.st_size : s->value;
+    rkeys[n++] = (nm_rkey_t){.value = value, .index = i};
+  }
+
+  if (!radixsort(rkeys + undefined, n - undefined)) {
+    free(rkeys);
+    return -1;
+  }
+
+  for (size_t i = 0; i < n; i++)
+    keys[i] = symbols[rkeys[i].index].key;
+
+  // Break the ties by name, runs of equal values are usually tiny.
+  for (size_t i = 0; i < n;) {
+    auto j = i + 1;
+    while (j < n && rkeys[j].value == rkeys[i].value && (i < undefined) == (j < undefined))
+      j++;
+    if (j - i > 1)
+      heapsort(keys + i, j - i, nm_cmp_name, names);
+    i = j;
+  }
+
+  for (size_t i = 0; opts->reverse_sort && i < n / 2; i++) {
+    const auto tmp = keys[i];
+    keys[i] = keys[n - i - 1];
+    keys[n - i - 1] = tmp;
+  }
+
+  free(rkeys);
+  return (ssize_t)n;
+}
+
+/*!
+ * Size the section symbols for --size-sort like nm: in address then name order, a
+ * section symbol extends up to the next symbol if it is in the same section, to the end
+ * of its section otherwise. Undefined and absolute symbols are not counted.
+ * @return Whether the operation was successful, it only fails on allocation failure.
+ */
+static bool nm_size_section_symbols(const nm_sections_t* sections,
+                                    nm_symbol_t* symbols,
+                                    const size_t count,
+                                    const nm_intern_t* names) {
+  bool any = false;
+  for (size_t i = 0; i < count && !any; i++)
+    any = ELF64_ST_TYPE(symbols[i].internal.st_info) == STT_SECTION;
+  if (!any)
+    return true;
+
+  nm_rkey_t* rkeys = malloc(count * sizeof(nm_rkey_t));
+  nm_key_t* keys = malloc(count * sizeof(nm_key_t));
+  if (!rkeys || !keys) {
+    free(rkeys);
+    free(keys);
+    return false;
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    const auto shndx = symbols[i].internal.st_shndx;
+    if (shndx != SHN_UNDEF && shndx != SHN_ABS)
+      rkeys[n++] = (nm_rkey_t){.value = symbols[i].internal.st_value, .index = i};
+  }
+  if (!radixsort(rkeys, n)) {
+    free(rkeys);
+    free(keys);
+    return false;
+  }
+
+  for (size_t i = 0; i < n; i++)
+    keys[i] = symbols[rkeys[i].index].key;
+  for (size_t i = 0; i < n;) {
+    auto j = i + 1;
+    while (j < n && rkeys[j].value == rkeys[i].value)
+      j++;
+    if (j - i > 1)
+      heapsort(keys + i, j - i, nm_cmp_name, names);
+    i = j;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    const auto s = &symbols[keys[i].index].internal;
+    if (ELF64_ST_TYPE(s->st_info) != STT_SECTION || s->st_shndx >= sections->count)
+      continue;
+
+    const auto next = (i + 1 < n) ? &symbols[keys[i + 1].index].internal : nullptr;
+    const auto section = &sections->entries[s->st_shndx];
+    if (next && next->st_shndx == s->st_shndx)
+      s->st_size = next->st_value - s->st_value;
+    else
+      s->st_size = section->addr + section->size - s->st_value;
+  }
+
+  free(rkeys);
+  free(keys);
+  return true;
+}
+
+static nm_list_err_t nm_list_symbols(const elfu_t* obj,
+                                     const nm_list_opts_t* opts,
+                                     const nm_fmt_ctx_t* ctx,
+                                     nm_out_t* out) {
+  auto ret = NM_LIST_OUT_OF_MEMORY;
+  bool has_symbols = false;
+  vector(nm_symbol_t) symbols = nullptr;
+  nm_intern_t names = {};
+  nm_key_t* keys = nullptr;
+
+  const auto intern = opts->no_sort ? nullptr : &names;
+  const auto cmp_symbol = opts->reverse_sort ? nm_cmp_name_reverse : nm_cmp_name;
+
+  elfu_section_t sym;
+  NM_PHASE_BEGIN(NM_PHASE_SYMTAB);
+  if (nm_list_symtab(obj, opts, &sym) &&
+      nm_process_symtab(obj, ctx->sections, opts, &sym, &symbols, intern,
+                        &has_symbols) < 0)
+    goto done;
+  NM_PHASE_END(NM_PHASE_SYMTAB);
+
+  const auto count = vector_len(symbols);
+  if (opts->size_sort && !opts->no_sort &&
+      !nm_size_section_symbols(ctx->sections, symbols, count, &names))
+    goto done;
+  auto limit = (opts->limit < count) ? opts->limit : count;
+  // The binary blob needs the whole selection up front, it is written once ordered.
+  const auto stream = opts->format != NM_FORMAT_BINARY;
+
+  // Sort the compact keys rather than the symbols themselves, it keeps the working set
+  // small and the swaps cheap.
+  if (count && (keys = malloc(count * sizeof(nm_key_t))) == nullptr)
+    goto done;
+
+  NM_PHASE_BEGIN(NM_PHASE_SORT);
+  nm_key_t* order = keys;
+  if (opts->no_sort) {
+    for (size_t i = 0; i < count; i++)
+      keys[i] = symbols[i].key;
+  } else if (opts->numeric_sort || opts->size_sort) {
+    const auto n = nm_sort_numeric(opts, symbols, count, keys, &names);
+    if (n < 0)
+      goto done;
+    if ((size_t)n < limit)
+      limit = (size_t)n;
+  } else if (limit == count) {
+    for (size_t i = 0; i < count; i++)
+      keys[i] = symbols[i].key;
+    heapsort(keys, count, cmp_symbol, &names);
+  } else {
+    for (size_t i = 0; i < count; i++)
+      keys[i] = symbols[i].key;
+
+    // Only the first `limit` symbols are wanted: heapify in O(n) and pop them in order,
+    // each symbol is displayed as soon as its position is known (and is timed as sort).
+    auto heap_size = count;
+    heap_build(keys, heap_size, cmp_symbol, &names);
+    for (size_t i = 0; i < limit; i++) {
+      const auto key = heap_pop(keys, &heap_size, cmp_symbol, &names);
+      // Park the popped keys in the slots freed at the end of the heap.
+      keys[heap_size] = key;
+      if (stream)
+        nm_format_symbol(out, ctx, opts->format, &symbols[key.index]);
+    }
+    if (stream) {
+      NM_PHASE_END(NM_PHASE_SORT);
+      ret = NM_LIST_OK;
+      goto done;
+    }
+
+    // The parked keys are in reverse order.
+    order = keys + heap_size;
+    for (size_t i = 0; i < limit / 2; i++) {
+      const auto tmp = order[i];
+      order[i] = order[limit - i - 1];
+      order[limit - i - 1] = tmp;
+    }
+  }
+
+  NM_PHASE_END(NM_PHASE_SORT);
+
+  NM_PHASE_BEGIN(NM_PHASE_DISPLAY);
+  ret = NM_LIST_OK;
+  if (stream) {
+    for (size_t i = 0; i < limit; i++)
+      nm_format_symbol(out, ctx, opts->format, &symbols[order[i].index]);
+  } else if (!nm_format_binary(out, ctx, symbols, order, limit))
+    ret = NM_LIST_TOO_LARGE;
+  nm_out_flush(out);
+  NM_PHASE_END(NM_PHASE_DISPLAY);
+
+done:
+  nm_out_flush(out);
+  free(keys);
+  nm_intern_destroy(&names);
+  vector_destroy(symbols);
+  if (ret == NM_LIST_OK && !has_symbols)
+    ret = NM_LIST_NO_SYMBOLS;
+  return ret;
+}
+
+// The formatting context of the listing, without the section and line tables.
+static nm_fmt_ctx_t nm_list_fmt(const elfu_t* obj, const nm_list_opts_t* opts) {
+  return (nm_fmt_ctx_t){
+      .file = opts->file,
+      .print_filename = opts->print_filename,
+      .undefined_only = opts->only_undefined,
+      .size_as_value = opts->size_sort,
+      .print_size = opts->print_size,
+      .print_section = opts->print_section,
+      .demangler = opts->demangler,
+      .width = (obj->class == CLASS64) ? 16 : 8,
+  };
+}
+
+bool nm_list_ctx_init(nm_list_ctx_t* ctx, const elfu_t* obj, const nm_list_opts_t* opts) {
+  *ctx = (nm_list_ctx_t){};
+  if (!nm_sections_build(obj, &ctx->sections)) {
+    nm_list_ctx_destroy(ctx);
+    return false;
+  }
+
+  // Built once, every listed symbol is then resolved with a binary search.
+  bool has_lines = false;
+  if (opts->line_numbers && !(has_lines = elfu_get_lines(obj, &ctx->lines)) &&
+      elfu_get_err() == ELFU_OUT_OF_MEMORY) {
+    nm_list_ctx_destroy(ctx);
+    return false;
+  }
+
+  ctx->fmt = nm_list_fmt(obj, opts);
+  ctx->fmt.sections = &ctx->sections;
+  ctx->fmt.lines = has_lines ? &ctx->lines : nullptr;
+  return true;
+}
+
+void nm_list_ctx_destroy(nm_list_ctx_t* ctx) {
+  elfu_lines_destroy(&ctx->lines);
+  nm_sections_destroy(&ctx->sections);
+}
+
+nm_list_err_t nm_list(const elfu_t* obj,
+                      const nm_list_opts_t* opts,
+                      const nm_sink_t* sink) {
+  // Too big for the stack of the threads embedding the engine.
+  nm_out_t* out = malloc(sizeof(nm_out_t));
+  if (!out)
+    return NM_LIST_OUT_OF_MEMORY;
+  *out = (nm_out_t){.fd = -1, .sink = sink};
+
+  nm_list_ctx_t ctx;
+  if (!nm_list_ctx_init(&ctx, obj, opts)) {
+    free(out);
+    return NM_LIST_OUT_OF_MEMORY;
+  }
+
+  const auto header = nm_formatters[opts->format].header;
+  if (header && !opts->no_header)
+    header(out, &ctx.fmt);
+
+  auto ret = nm_list_symbols(obj, opts, &ctx.fmt, out);
+  if (out->failed)
+    ret = NM_LIST_SINK_FAILED;
+
+  nm_list_ctx_destroy(&ctx);
+  free(out);
+  return ret;
+}
+
+bool nm_list_header(const elfu_t* obj,
+                    const nm_list_opts_t* opts,
+                    const nm_sink_t* sink) {
+  const auto header = nm_formatters[opts->format].header;
+  if (!header)
+    return true;
+
+  nm_out_t* out = malloc(sizeof(nm_out_t));
+  if (!out)
+    return false;
+  *out = (nm_out_t){.fd = -1, .sink = sink};
+
+  const auto fmt = nm_list_fmt(obj, opts);
+  header(out, &fmt);
+  const auto ok = nm_out_flush(out);
+  free(out);
+  return ok;
+}
@@ -1,6 +1,9 @@
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <nm/elfu.h>
@@ -9,21 +12,45 @@
 #include <string.h>
 
 #include <ad/ad.h>
+#include <nm/dedup.h>
+#include <nm/demangle.h>
+#include <nm/format.h>
+#include <nm/list.h>
 #include <nm/opt.h>
+#include <nm/prefetch.h>
+#include <nm/walk.h>
+#include <nm/stats.h>
 #include "ad/collections.h"
 #include "ad/io.h"
 #include "ad/string.h"
 
 static const char* g_filename = nullptr;
 
-static bool flag_no_sort = false;
-static bool flag_reverse_sort = false;
-static bool flag_only_undefined = false;
-static bool flag_only_external = false;
-static bool flag_dynamic = false;
-static bool flag_no_filter = false;
+static nm_list_opts_t g_opts = NM_LIST_OPTS_DEFAULT;
+static bool flag_lookup = false;
+static bool flag_resolve = false;
+static bool flag_diff = false;
+static u32 flag_map = 0;  // --mmap, ELFU_MAP_*
+static size_t flag_prefetch = NM_PREFETCH_DEPTH;  // --prefetch, 0 disables it
+static vector(const char*) flag_dirs = nullptr;    // -R
+static bool flag_dedup = false;
+static nm_dedup_t* g_dedup = nullptr;  // Set by nm_process_files with --dedup
 
-static auto nm_get_symtab_fn = elfu_get_symtab;
+static nm_out_t g_out = {.fd = STDOUT_FILENO};
+static int g_stdout_fd = STDOUT_FILENO;
+static const nm_sink_t g_stdout = {.write = nm_sink_fd, .ctx = &g_stdout_fd};
+
+typedef struct {
+  const char* name;
+  const char* version;  // nullptr matches any version
+  bool default_only;    // `NAME@@VERSION` only matches the default version
+} nm_query_t;
+
+static vector(nm_query_t) flag_find = nullptr;
+static nm_match_t g_match;  // --match
+#ifdef NM_STATS
+static bool flag_stats = false;
+#endif
 
 // too lazy to pull libft ...
 
@@ -49,212 +76,309 @@ static auto nm_get_symtab_fn = elfu_get_symtab;
 
 #define nm_warn(err) nm_warn_p(err, "")
 
-static nm_sym_type_t nm_section_type(const elfu_t* obj, const size_t index) {
-  // Obviously not a valid section index
-  if (index != SHN_UNDEF && index >= SHN_LORESERVE)
-    return SYM_UNKNOWN;
-
-  // Really, really special case, when nm (bfd) encounters a symbol for which his section
-  // doesn't exist, it classifies it as absolute.
-  if (index > obj->ehdr.e_shnum)
-    return SYM_ABSOLUTE_L;
+// Write `value` as zero padded hex, `width` digits, into `buffer`.
+static void nm_fmt_hex(char* buffer, u64 value, const size_t width) {
+  char* h = buffer + width;
 
-  elfu_section_t section;
-  if (!elfu_get_section(obj, index, &section))
-    return SYM_UNKNOWN;
-
-  const auto section_name = elfu_strptr(obj, obj->ehdr.e_shstrndx, section.hdr.sh_name);
-  const auto type = section.hdr.sh_type;
-  const auto flags = section.hdr.sh_flags;
+  while (value > 0 && h != buffer) {
+    const auto table = "0123456789abcdef";
+    *--h = table[value % 16];
+    value /= 16;
+  }
+  while (h != buffer)
+    *--h = '0';
+}
 
-  const auto ro = (flags & SHF_WRITE) == 0;
-  const auto data = (flags & SHF_ALLOC) != 0;
-  const auto code = (flags & SHF_EXECINSTR) != 0;
+// Name to display, sorting and matching always use the mangled name.
+static const char* nm_display_name(const char* name) {
+  return g_opts.demangler ? nm_demangle(g_opts.demangler, name) : name;
+}
 
-  if (type == SHT_PROGBITS && code) {
-    // .text section
-    return SYM_CODE_L;
+static void nm_symbol_put_name(nm_out_t* out, const nm_symbol_t* s) {
+  nm_out_puts(out, nm_display_name(s->name));
+  if (s->version) {
+    nm_out_putc(out, '@');
+    if (!s->version_hidden)
+      nm_out_putc(out, '@');
+    nm_out_puts(out, s->version);
   }
-
-  // .bss section
-  if (type == SHT_NOBITS && (!ro && data))
-    return SYM_BSS_L;
-  // data sections
-  if (!ro && data)
-    return SYM_INITD_L;
-  if (data && ro)
-    return SYM_RD_ONLY_DATA_L;
-  if (section_name && ad_strncmp(section_name, ".debug", 6) == 0)
-    return SYM_DEBUG;
-  if (!code && !data && ro)
-    return SYM_RD_ONLY;
-  return SYM_UNKNOWN;
 }
 
-#define shndx(s) ((s).st_shndx)
+#define NM_LOOKUP_BUFFER_SIZE 65536
 
-static nm_sym_type_t nm_sym_type(const elfu_t* obj, const Elf64_Sym s) {
-  const auto type = ELF64_ST_TYPE(s.st_info);
-  const auto bind = ELF64_ST_BIND(s.st_info);
+static bool nm_parse_addr(const char* s, const size_t len, u64* addr) {
+  size_t i = 0;
+  if (len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+    i = 2;
+  if (i == len || len - i > 16)
+    return false;
 
-  if (shndx(s) == SHN_COMMON)
-    return SYM_COMMON_G;
-  if (shndx(s) == SHN_UNDEF) {
-    if (bind == STB_WEAK)
-      return (type == STT_OBJECT) ? SYM_WEAK_OBJ_L : SYM_WEAK_L;
-    return SYM_UNDEFINED;
+  u64 v = 0;
+  for (; i < len; i++) {
+    const auto c = s[i] | 0x20;
+    if (s[i] >= '0' && s[i] <= '9')
+      v = (v << 4) | (u64)(s[i] - '0');
+    else if (c >= 'a' && c <= 'f')
+      v = (v << 4) | (u64)(c - 'a' + 10);
+    else
+      return false;
   }
 
-  if (type == STT_GNU_IFUNC)
-    return SYM_INDIR;
-  if (bind == STB_GNU_UNIQUE)
-    return SYM_UNIQUE_GLOBAL;
-  if (bind == STB_WEAK)
-    return (type == STT_OBJECT) ? SYM_WEAK_OBJ_G : SYM_WEAK_G;
-
-  const auto stype = (shndx(s) == SHN_ABS) ? SYM_ABSOLUTE_L : nm_section_type(obj, shndx(s));
-  if (stype != SYM_UNKNOWN && bind == STB_GLOBAL)
-    return stype - 32;
-
-  return stype;
+  *addr = v;
+  return true;
 }
 
-static bool nm_keep_symbol(const elfu_t* obj, const Elf64_Sym s) {
-  (void)obj;
+static void nm_lookup_line(const nm_addr_index_t* idx,
+                           const char* line,
+                           size_t len,
+                           const bool bits_64) {
+  while (len && (line[0] == ' ' || line[0] == '\t')) {
+    line++;
+    len--;
+  }
+  while (len && (line[len - 1] == ' ' || line[len - 1] == '\t' || line[len - 1] == '\r'))
+    len--;
+  if (len == 0)
+    return;
 
-  const auto type = ELF64_ST_TYPE(s.st_info);
-  const auto bind = ELF64_ST_BIND(s.st_info);
+  u64 addr;
+  if (!nm_parse_addr(line, len, &addr)) {
+    nm_out_puts(&g_out, "?? ?\n");
+    return;
+  }
 
-  if (!flag_no_filter && (type == STT_FILE || type == STT_SECTION))
-    return false;
+  char buffer[48] = {};
+  const size_t width = (bits_64) ? 16 : 8;
+  nm_fmt_hex(buffer, addr, width);
+  nm_out_puts(&g_out, buffer);
 
-  if (flag_only_undefined)
-    return (s.st_shndx == SHN_UNDEF);
-  if (flag_only_external)
-    return (bind == STB_GLOBAL || bind == STB_WEAK || bind == STB_GNU_UNIQUE);
+  const auto r = nm_addr_index_find(idx, addr);
+  if (!r) {
+    nm_out_puts(&g_out, " ??\n");
+    return;
+  }
 
-  return true;
+  nm_out_putc(&g_out, ' ');
+  nm_out_puts(&g_out, nm_display_name(r->symbol->name));
+
+  const auto offset = addr - r->start;
+  if (offset) {
+    char off[24] = {'+', '0', 'x'};
+    size_t digits = 1;
+    while (digits < 16 && (offset >> (4 * digits)))
+      digits++;
+    nm_fmt_hex(off + 3, offset, digits);
+    nm_out_puts(&g_out, off);
+  }
+  nm_out_putc(&g_out, '\n');
 }
 
 /*!
- * Process the given \a symtab ELF section and push its listed symbols to \a symbols.
- * @return \c -1 on error.
+ * Resolve each address read from stdin, one per line in hex, to the function or object
+ * containing it. The output is `ADDRESS NAME+0xOFFSET`, or `ADDRESS ??` when nothing
+ * contains the address.
  */
-static ssize_t nm_process_symtab(const elfu_t* obj,
-                                 const elfu_section_t* symtab,
-                                 vector(nm_symbol_t) * symbols,
-                                 bool* has_symbols) {
-  vector(nm_symbol_t) symvec = *symbols;
-  elfu_sym_iter_t iter;
-  if (!elfu_get_sym_iter(obj, symtab, &iter))
-    return -1;
+static bool nm_lookup_symbols(const elfu_t* obj, const nm_sections_t* sections) {
+  bool ret = false;
+  vector(nm_symbol_t) symbols = nullptr;
+  nm_addr_index_t idx = {};
+  char* buffer = nullptr;
 
-  elfu_sym_t s;
-  while (elfu_sym_iter_next(&iter, &s)) {
-    if (!nm_keep_symbol(obj, s.sym))
+  elfu_section_t sym;
+  if (nm_list_symtab(obj, &g_opts, &sym) &&
+      nm_process_symtab(obj, sections, &g_opts, &sym, &symbols, nullptr, &ret) < 0)
+    goto done;
+  if (!ret)
+    goto done;
+
+  if (!nm_addr_index_build(&idx, symbols, vector_len(symbols)) ||
+      (buffer = malloc(NM_LOOKUP_BUFFER_SIZE)) == nullptr) {
+    nm_err(strerror(ENOMEM));
+    goto done;
+  }
+
+  const bool bits_64 = obj->class == CLASS64;
+  size_t used = 0;
+  for (;;) {
+    const auto rd = read(STDIN_FILENO, buffer + used, NM_LOOKUP_BUFFER_SIZE - used);
+    if (rd < 0 && errno == EINTR)
       continue;
+    if (rd <= 0) {
+      // Last line without a trailing newline.
+      nm_lookup_line(&idx, buffer, used, bits_64);
+      nm_out_flush(&g_out);
+      break;
+    }
+    used += (size_t)rd;
 
-    const auto type = nm_sym_type(obj, s.sym);
-    // Again, cryptic case by nm. If the object is one of these two types, defined symbols
-    // will add the sh_addr to their value.
-    // readelf doesn't do that. elfutils nm neither.
-    const auto reloff =
-        (obj->ehdr.e_type == ET_EXEC || obj->ehdr.e_type == ET_DYN) ? 0 : s.sh_addr;
-    const auto value = (type == SYM_UNDEFINED || type == SYM_WEAK_OBJ_L || type == SYM_WEAK_L)
-                           ? 0
-                           : s.sym.st_value + reloff;
-
-    const nm_symbol_t symbol = {
-        .name = s.name,
-        .version = s.version,
-        .version_hidden = s.version_hidden,
-        .type = type,
-        .value = value,
-        .internal = s.sym,
-        .pos = iter.cursor,
-    };
-
-    if (!vector_push(symvec, symbol))
-      return -1;
+    size_t start = 0;
+    for (size_t i = 0; i < used; i++) {
+      if (buffer[i] == '\n') {
+        nm_lookup_line(&idx, buffer + start, i - start, bits_64);
+        start = i + 1;
+      }
+    }
+
+    // A line that doesn't fit in the buffer can't be an address.
+    if (start == 0 && used == NM_LOOKUP_BUFFER_SIZE) {
+      nm_out_puts(&g_out, "?? ?\n");
+      used = 0;
+      continue;
+    }
+
+    memmove(buffer, buffer + start, used - start);
+    used -= start;
+    // The answers to what stdin had so far, before waiting for more.
+    nm_out_flush(&g_out);
   }
 
-  *symbols = symvec;
-  *has_symbols = (iter.total > 1);
+done:
+  free(buffer);
+  nm_addr_index_destroy(&idx);
+  vector_destroy(symbols);
+  return ret;
+}
 
-  return (ssize_t)iter.total;
+static bool nm_query_match(const nm_query_t* q, const nm_symbol_t* s) {
+  if (ad_strcmp(q->name, s->name) != 0)
+    return false;
+  if (!q->version)
+    return true;
+  if (!s->version || ad_strcmp(q->version, s->version) != 0)
+    return false;
+  return !q->default_only || !s->version_hidden;
 }
 
-static void nm_symbol_put_value(const nm_symbol_t* s, const bool bits_64) {
-  const size_t width = (bits_64) ? 16 : 8;
+#define NM_FIND_MAX_MATCHES 32
 
-  char buffer[32] = {};
-  auto value = s->value;
+// A symbol found by the scan fallback, with the query it answers.
+typedef struct {
+  nm_symbol_t symbol;
+  size_t query;
+} nm_find_match_t;
 
-  if (s->internal.st_shndx != SHN_UNDEF) {
-    char* h = buffer + width;
+/*!
+ * Resolve each \c --find query through the object hash table when it indexes the
+ * selected symbol table, otherwise fall back to a single scan of the table.
+ * Only defined symbols are reported, in query order.
+ * @param all_found[out] Whether every query matched a symbol.
+ * @return Whether the table has any symbol.
+ */
+static bool nm_find_symbols(const elfu_t* obj, nm_fmt_ctx_t* ctx, bool* all_found) {
+  *all_found = false;
+  elfu_section_t symtab;
+  elfu_sym_iter_t iter;
+  if (!nm_list_symtab(obj, &g_opts, &symtab) || !elfu_get_sym_iter(obj, &symtab, &iter))
+    return false;
+  if (iter.total <= 1)
+    return false;
 
-    while (value > 0 && h != buffer) {
-      const auto table = "0123456789abcdef";
-      *--h = table[value % 16];
-      value /= 16;
-    }
-    while (h != buffer)
-      *--h = '0';
-  } else {
-    for (size_t i = 0; i < width; i++)
-      buffer[i] = ' ';
-  }
+  const auto nqueries = vector_len(flag_find);
 
-  ad_puts(buffer);
-}
+  elfu_hash_t hash;
+  elfu_section_t linked;
+  const auto use_hash = elfu_get_hash(obj, &hash) &&
+                        elfu_get_section(obj, hash.section.hdr.sh_link, &linked) &&
+                        linked.hdr.sh_offset == symtab.hdr.sh_offset;
 
-static void nm_display_symbol(const nm_symbol_t* s, const bool bits_64) {
-  nm_symbol_put_value(s, bits_64);
-  ad_puts((char[]){' ', (char)s->type, ' ', 0});
-  ad_puts(s->name);
-  if (s->version) {
-    ad_puts("@");
-    if (!s->version_hidden)
-      ad_puts("@");
-    ad_puts(s->version);
+  bool* found = calloc(nqueries, sizeof(bool));
+  if (nqueries && !found) {
+    nm_err(strerror(ENOMEM));
+    return true;
   }
-  ad_puts("\n");
-}
 
-static int nm_cmp_symbol(const nm_symbol_t* a, const nm_symbol_t* b) {
-  auto cmp = ad_strcmp(a->name, b->name);
-  if (cmp == 0)
-    cmp = (int)a->pos - (int)b->pos;
-  return flag_reverse_sort ? -cmp : cmp;
-}
+  elfu_sym_t s;
+  if (use_hash) {
+    size_t small[NM_FIND_MAX_MATCHES];
+    size_t* indices = small;
+    size_t max = NM_FIND_MAX_MATCHES;
 
-static bool nm_list_symbols(const elfu_t* obj) {
-  bool ret = false;
-  vector(nm_symbol_t) symbols = nullptr;
+    for (size_t q = 0; q < nqueries; q++) {
+      auto n = elfu_hash_lookup(&hash, &symtab, flag_find[q].name, indices, max);
+      // A full buffer may have cut the matches short, look up again with a larger one.
+      while (n == max) {
+        size_t* larger = malloc(2 * max * sizeof(size_t));
+        if (!larger) {
+          nm_err(strerror(ENOMEM));
+          break;
+        }
+        if (indices != small)
+          free(indices);
+        indices = larger;
+        max *= 2;
+        n = elfu_hash_lookup(&hash, &symtab, flag_find[q].name, indices, max);
+      }
 
-  elfu_section_t sym;
-  if (nm_get_symtab_fn(obj, &sym) && nm_process_symtab(obj, &sym, &symbols, &ret) < 0)
-    goto err;
+      for (size_t i = 0; i < n; i++) {
+        if (!elfu_sym_iter_seek(&iter, indices[i]) || !elfu_sym_iter_next(&iter, &s))
+          continue;
+
+        const auto symbol = nm_make_symbol(obj, ctx->sections, &s, iter.cursor);
+        if (nm_query_match(&flag_find[q], &symbol)) {
+          nm_format_symbol(&g_out, ctx, g_opts.format, &symbol);
+          found[q] = true;
+        }
+      }
+    }
 
-  if (!flag_no_sort)
-    heapsort(symbols, vector_len(symbols), nm_cmp_symbol);
+    if (indices != small)
+      free(indices);
+  } else {
+    vector(nm_find_match_t) matches = nullptr;
 
-  const bool bits_64 = obj->class == CLASS64;
-  for (size_t i = 0; i < vector_len(symbols); i++)
-    nm_display_symbol(&symbols[i], bits_64);
+    while (elfu_sym_iter_next(&iter, &s)) {
+      if (s.sym.st_shndx == SHN_UNDEF)
+        continue;
 
-err:
-  vector_destroy(symbols);
-  return ret;
+      const auto symbol = nm_make_symbol(obj, ctx->sections, &s, iter.cursor);
+      for (size_t q = 0; q < nqueries; q++) {
+        if (!nm_query_match(&flag_find[q], &symbol))
+          continue;
+        if (!vector_push(matches, ((nm_find_match_t){.symbol = symbol, .query = q}))) {
+          nm_err(strerror(ENOMEM));
+          vector_destroy(matches);
+          free(found);
+          return true;
+        }
+      }
+    }
+
+    for (size_t q = 0; q < nqueries; q++) {
+      for (size_t i = 0; i < vector_len(matches); i++) {
+        if (matches[i].query == q) {
+          nm_format_symbol(&g_out, ctx, g_opts.format, &matches[i].symbol);
+          found[q] = true;
+        }
+      }
+    }
+
+    vector_destroy(matches);
+  }
+
+  *all_found = true;
+  for (size_t q = 0; q < nqueries; q++) {
+    if (!found[q]) {
+      *all_found = false;
+      ad_dputs(STDERR_FILENO, "nm: ");
+      ad_dputs(STDERR_FILENO, g_filename);
+      ad_dputs(STDERR_FILENO, ": ");
+      ad_dputs(STDERR_FILENO, flag_find[q].name);
+      ad_dputs(STDERR_FILENO, ": symbol not found\n");
+    }
+  }
+
+  nm_out_flush(&g_out);
+  free(found);
+  return true;
 }
 
-static void nm_print_err() {
-  switch (elfu_get_err()) {
+static void nm_print_err(const elfu_err_t err, const int errnum) {
+  switch (err) {
     case ELFU_UNKNOWN_FORMAT:
       nm_err("file format not recognized");
       break;
     case ELFU_SYS_ERR:
-      nm_warn(strerror(errno));
+      nm_warn(strerror(errnum));
       break;
     case ELFU_NOTA_FILE:
       nm_warn_p("is not an ordinary file", "Warning: ");
@@ -267,33 +391,120 @@ static void nm_print_err() {
   }
 }
 
-static int nm_process_file(const char* name, bool print_filename) {
-  int exit_code = EXIT_SUCCESS;
+/*!
+ * Open and map the object \a name, reporting any error.
+ * @param pre The file if it was read ahead, \c nullptr to open it. It keeps ownership of
+ * its descriptor and data, which must outlive the object.
+ * @param fd[out] The file descriptor opened for the object, \c -1 on failure or if it
+ * comes from \a pre.
+ * @return The object, \c nullptr on failure.
+ */
+static elfu_t* nm_open_object(const char* name, const nm_prefetched_t* pre, int* fd) {
   elfu_t* obj = nullptr;
 
   g_filename = name;
 
-  const int fd = open(name, O_RDONLY);
-  if (fd < 0) {
-    if (errno == ENOENT)
+  NM_PHASE_BEGIN(NM_PHASE_OPEN);
+  *fd = pre ? -1 : open(name, O_RDONLY);
+  const auto file_fd = pre ? pre->fd : *fd;
+  if (file_fd < 0 || (pre && pre->err)) {
+    const auto err = pre ? pre->err : errno;
+    if (file_fd < 0 && err == ENOENT)
       nm_warn("No such file");
     else
-      nm_err(strerror(errno));
-    goto err;
+      nm_err(strerror(err));
+    return nullptr;
   }
 
-  if ((obj = elfu_new(fd)) == nullptr) {
-    nm_print_err();
+  if (pre && pre->data)
+    obj = elfu_new_from_memory(pre->data, pre->size);
+  else
+    obj = elfu_new_with_flags(file_fd, flag_map);
+  if (!obj)
+    nm_print_err(elfu_get_err(), errno);
+  NM_PHASE_END(NM_PHASE_OPEN);
+
+  return obj;
+}
+
+// List \a obj to stdout, replaying the output of an identical object with --dedup.
+static nm_list_err_t nm_list_object(const elfu_t* obj) {
+  // The formats with a header only name the object there, the symbols can be replayed.
+  if (!g_dedup || !nm_formatters[g_opts.format].header)
+    return nm_list(obj, &g_opts, &g_stdout);
+
+  const auto key = nm_dedup_key(obj);
+  if (!nm_list_header(obj, &g_opts, &g_stdout))
+    return NM_LIST_SINK_FAILED;
+
+  const auto entry = nm_dedup_find(g_dedup, key, obj);
+  if (entry) {
+    if (entry->len && !g_stdout.write(g_stdout.ctx, entry->data, entry->len))
+      return NM_LIST_SINK_FAILED;
+    return (nm_list_err_t)entry->status;
+  }
+
+  auto opts = g_opts;
+  opts.no_header = true;
+  const auto sink = nm_dedup_record(g_dedup, key, g_opts.file, &g_stdout);
+  const auto ret = nm_list(obj, &opts, sink ? sink : &g_stdout);
+  nm_dedup_commit(g_dedup, ret, ret == NM_LIST_OK || ret == NM_LIST_NO_SYMBOLS);
+  return ret;
+}
+
+static int nm_process_file(const char* name,
+                           const nm_prefetched_t* pre,
+                           bool print_filename) {
+  int exit_code = EXIT_SUCCESS;
+  nm_list_ctx_t ctx = {};
+  int fd;
+
+  auto obj = nm_open_object(name, pre, &fd);
+  if (!obj)
     goto err;
+
+  g_opts.file = name;
+  g_opts.print_filename = print_filename;
+
+  if (!flag_lookup && !flag_find) {
+    // Write errors are not reported, like the other modes.
+    switch (nm_list_object(obj)) {
+      case NM_LIST_NO_SYMBOLS:
+        nm_err("no symbols");
+        break;
+      case NM_LIST_OUT_OF_MEMORY:
+        nm_err(strerror(ENOMEM));
+        goto err;
+      case NM_LIST_TOO_LARGE:
+        nm_err(strerror(EOVERFLOW));
+        goto err;
+      default:
+        break;
+    }
+    goto done;
   }
 
-  if (print_filename) {
-    ad_puts("\n");
-    ad_puts(name);
-    ad_puts(":\n");
+  if (!nm_list_ctx_init(&ctx, obj, &g_opts)) {
+    nm_err(strerror(ENOMEM));
+    goto err;
   }
 
-  if (!nm_list_symbols(obj))
+  bool has_symbols;
+  if (flag_lookup)
+    has_symbols = nm_lookup_symbols(obj, &ctx.sections);
+  else {
+    const auto header = nm_formatters[g_opts.format].header;
+    if (header) {
+      header(&g_out, &ctx.fmt);
+      nm_out_flush(&g_out);
+    }
+    bool all_found;
+    has_symbols = nm_find_symbols(obj, &ctx.fmt, &all_found);
+    // Scripts check the exports through the exit status.
+    if (has_symbols && !all_found)
+      exit_code = EXIT_FAILURE;
+  }
+  if (!has_symbols)
     nm_err("no symbols");
 
   goto done;
@@ -301,6 +512,11 @@ static int nm_process_file(const char* name, bool print_filename) {
 err:
   exit_code = EXIT_FAILURE;
 done:
+#ifdef NM_STATS
+  if (flag_stats)
+    nm_stats_report(name);
+#endif
+  nm_list_ctx_destroy(&ctx);
   elfu_reset_err();
   if (fd != -1)
     close(fd);
@@ -309,32 +525,883 @@ done:
   return exit_code;
 }
 
+// Lists several files in order, the next ones being read ahead meanwhile.
+static int nm_process_files(char** files, const size_t count) {
+  int exit_code = EXIT_SUCCESS;
+
+  // Without the cache, every file is simply listed.
+  if (flag_dedup)
+    g_dedup = nm_dedup_new();
+
+  // Without the pipeline, the files are opened one after the other.
+  auto prefetch = flag_prefetch ? nm_prefetch_new(files, count, flag_prefetch) : nullptr;
+  if (!prefetch) {
+    for (size_t i = 0; i < count; i++)
+      exit_code += nm_process_file(files[i], nullptr, true);
+    goto done;
+  }
+
+  nm_prefetched_t file;
+  while (nm_prefetch_next(prefetch, &file)) {
+    exit_code += nm_process_file(file.name, &file, true);
+    nm_prefetched_release(&file);
+  }
+  nm_prefetch_destroy(&prefetch);
+
+done:
+  nm_dedup_destroy(&g_dedup);
+  return exit_code;
+}
+
+#define NM_RESOLVE_MAX_WORKERS 64
+
+typedef struct {
+  char** files;
+  size_t nfiles;
+  atomic_size_t next;
+  atomic_bool oom;
+
+  nm_symmap_t* map;
+
+  // Per file status, reported by the main thread once the workers are done.
+  int* open_errno;
+  elfu_err_t* errs;
+  bool* has_symbols;
+  bool* alias;  // The file is one given earlier (a symbolic or hard link), it is skipped
+} nm_resolve_ctx_t;
+
+// Symbols the linker provides itself, references to them are always satisfied.
+static bool nm_linker_defined(const char* name) {
+  static const char* const names[] = {
+      "_GLOBAL_OFFSET_TABLE_", "_DYNAMIC", "_PROCEDURE_LINKAGE_TABLE_", "__ehdr_start",
+      "__executable_start", "_etext", "etext", "__etext", "_edata", "edata", "_end",
+      "end", "__bss_start", "__dso_handle", "__TMC_END__", "__GNU_EH_FRAME_HDR",
+      "__init_array_start", "__init_array_end", "__fini_array_start", "__fini_array_end",
+      "__preinit_array_start", "__preinit_array_end", "__rela_iplt_start",
+      "__rela_iplt_end",
+  };
+
+  // Section bounds, for any section whose name is a C identifier.
+  if (strncmp(name, "__start_", 8) == 0 || strncmp(name, "__stop_", 7) == 0)
+    return true;
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strcmp(name, names[i]) == 0)
+      return true;
+  }
+  return false;
+}
+
+/*!
+ * Record the global symbols of \a obj in \a map.
+ * @return The number of entries in the symbol table, \c -1 on allocation failure.
+ */
+static ssize_t nm_resolve_object(nm_symmap_t* map, const elfu_t* obj, const u32 file) {
+  elfu_section_t symtab;
+  elfu_sym_iter_t iter;
+  if (!nm_list_symtab(obj, &g_opts, &symtab) || !elfu_get_sym_iter(obj, &symtab, &iter))
+    return 0;
+
+  elfu_sym_t s;
+  while (elfu_sym_iter_next(&iter, &s)) {
+    const auto type = ELF64_ST_TYPE(s.sym.st_info);
+    const auto bind = ELF64_ST_BIND(s.sym.st_info);
+
+    if (type == STT_FILE || type == STT_SECTION)
+      continue;
+    if (bind != STB_GLOBAL && bind != STB_WEAK && bind != STB_GNU_UNIQUE)
+      continue;
+
+    // Every object defining a version has a marker symbol for it, GLIBC_2.2.5 in
+    // libc.so.6 and libm.so.6 alike.
+    if (s.sym.st_shndx == SHN_ABS && elfu_sym_iter_defines_version(&iter, s.name))
+      continue;
+
+    nm_symmap_kind_t kind;
+    if (s.sym.st_shndx == SHN_UNDEF) {
+      // Unresolved weak references are legal, and the linker defines some symbols.
+      if (bind == STB_WEAK || nm_linker_defined(s.name))
+        continue;
+      kind = NM_SYMMAP_REF;
+    } else if (bind == STB_GLOBAL && s.sym.st_shndx != SHN_COMMON)
+      kind = NM_SYMMAP_DEF;
+    else
+      kind = NM_SYMMAP_WEAK_DEF;
+
+    if (!nm_symmap_add(map, s.name, file, kind))
+      return -1;
+  }
+
+  return (ssize_t)iter.total;
+}
+
+static void* nm_resolve_worker(void* arg) {
+  nm_resolve_ctx_t* ctx = arg;
+
+  for (;;) {
+    const auto file = atomic_fetch_add(&ctx->next, 1);
+    if (file >= ctx->nfiles)
+      break;
+    if (ctx->alias[file])
+      continue;
+
+    const int fd = open(ctx->files[file], O_RDONLY);
+    if (fd < 0) {
+      ctx->open_errno[file] = errno;
+      continue;
+    }
+
+    auto obj = elfu_new_with_flags(fd, flag_map);
+    if (obj) {
+      const auto total = nm_resolve_object(ctx->map, obj, (u32)file);
+      if (total < 0)
+        atomic_store(&ctx->oom, true);
+      ctx->has_symbols[file] = (total > 1);
+    }
+    ctx->errs[file] = elfu_get_err();
+    if (ctx->errs[file] == ELFU_SYS_ERR)
+      ctx->open_errno[file] = errno;
+
+    elfu_reset_err();
+    elfu_destroy(&obj);
+    close(fd);
+  }
+
+  return nullptr;
+}
+
+static int nm_cmp_entry_name(const nm_key_t* a, const nm_key_t* b, const void* ctx) {
+  nm_symmap_entry_t* const* entries = ctx;
+
+  if (a->prefix != b->prefix)
+    return (a->prefix < b->prefix) ? -1 : 1;
+  return nm_strcmp(entries[a->index]->name, entries[b->index]->name);
+}
+
+// Format \a v in decimal at the end of \a buffer, returns the start of the number.
+static const char* nm_dec(char buffer[static 24], u64 v) {
+  char* p = buffer + 23;
+
+  *p = 0;
+  do {
+    *--p = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  return p;
+}
+
+static int nm_resolve_report(const nm_resolve_ctx_t* ctx) {
+  size_t count = 0;
+  nm_symmap_entry_t** entries = nm_symmap_entries(ctx->map, &count);
+  nm_key_t* keys = malloc((count ? count : 1) * sizeof(nm_key_t));
+  if (!entries || !keys) {
+    free(entries);
+    free(keys);
+    return -1;
+  }
+
+  for (size_t i = 0; i < count; i++)
+    keys[i] = (nm_key_t){.prefix = nm_strprefix(entries[i]->name), .index = i};
+  heapsort(keys, count, nm_cmp_entry_name, entries);
+
+  int problems = 0;
+  for (size_t i = 0; i < count; i++) {
+    const auto e = entries[keys[i].index];
+    if (e->nrefs == 0 || e->ndefs != 0 || e->nweak != 0)
+      continue;
+
+    nm_out_puts(&g_out, nm_display_name(e->name));
+    nm_out_puts(&g_out, ": undefined reference in ");
+    nm_out_puts(&g_out, ctx->files[e->first_ref]);
+    if (e->nrefs > 1) {
+      nm_out_puts(&g_out, " and ");
+      char dec[24];
+      nm_out_puts(&g_out, nm_dec(dec, e->nrefs - 1));
+      nm_out_puts(&g_out, " other reference(s)");
+    }
+    nm_out_putc(&g_out, '\n');
+    problems++;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const auto e = entries[keys[i].index];
+    if (e->ndefs < 2)
+      continue;
+
+    // Workers insert in any order, sort the files for a deterministic report.
+    for (size_t a = 1; a < e->ndefs; a++) {
+      const auto v = e->defs[a];
+      auto b = a;
+      for (; b > 0 && e->defs[b - 1] > v; b--)
+        e->defs[b] = e->defs[b - 1];
+      e->defs[b] = v;
+    }
+    // Several versions of a name in one object don't conflict, like memcpy@GLIBC_2.2.5
+    // and memcpy@@GLIBC_2.14.
+    size_t ndefs = 0;
+    for (size_t d = 0; d < e->ndefs; d++) {
+      if (ndefs == 0 || e->defs[ndefs - 1] != e->defs[d])
+        e->defs[ndefs++] = e->defs[d];
+    }
+    if (ndefs < 2)
+      continue;
+
+    nm_out_puts(&g_out, nm_display_name(e->name));
+    nm_out_puts(&g_out, ": multiple definition in ");
+    for (size_t d = 0; d < ndefs; d++) {
+      if (d)
+        nm_out_puts(&g_out, ", ");
+      nm_out_puts(&g_out, ctx->files[e->defs[d]]);
+    }
+    nm_out_putc(&g_out, '\n');
+    problems++;
+  }
+
+  nm_out_flush(&g_out);
+  free(keys);
+  free(entries);
+  return problems;
+}
+
+static int nm_cmp_file_id(const nm_key_t* a, const nm_key_t* b, const void* ctx) {
+  const dev_t* devs = ctx;
+
+  if (a->prefix != b->prefix)
+    return (a->prefix < b->prefix) ? -1 : 1;
+  if (devs[a->index] != devs[b->index])
+    return (devs[a->index] < devs[b->index]) ? -1 : 1;
+  return (a->index < b->index) ? -1 : (a->index > b->index);
+}
+
+/*!
+ * Flag in \a alias the files that are the same as an earlier one, a library is often
+ * given along with its symbolic links.
+ * @return Whether the operation was successful, it only fails on allocation failure.
+ */
+static bool nm_resolve_aliases(char** files, const size_t nfiles, bool* alias) {
+  nm_key_t* keys = malloc((nfiles ? nfiles : 1) * sizeof(nm_key_t));
+  dev_t* devs = malloc((nfiles ? nfiles : 1) * sizeof(dev_t));
+  if (!keys || !devs) {
+    free(keys);
+    free(devs);
+    return false;
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < nfiles; i++) {
+    struct stat st;
+    // Errors are reported when the file is opened.
+    if (stat(files[i], &st) != 0 || !S_ISREG(st.st_mode))
+      continue;
+    devs[i] = st.st_dev;
+    keys[n++] = (nm_key_t){.prefix = st.st_ino, .index = (u32)i};
+  }
+  heapsort(keys, n, nm_cmp_file_id, devs);
+
+  for (size_t i = 1; i < n; i++) {
+    const auto prev = keys[i - 1].index;
+    const auto cur = keys[i].index;
+    alias[cur] = keys[i].prefix == keys[i - 1].prefix && devs[cur] == devs[prev];
+  }
+
+  free(keys);
+  free(devs);
+  return true;
+}
+
+/*!
+ * Fill a global name table from every file with parallel workers, then report the
+ * references no object defines and the names with several strong definitions.
+ */
+static int nm_resolve_files(char** files, const size_t nfiles) {
+  int exit_code = EXIT_SUCCESS;
+  nm_resolve_ctx_t ctx = {
+      .files = files,
+      .nfiles = nfiles,
+      .map = nm_symmap_new(),
+      .open_errno = calloc(nfiles, sizeof(int)),
+      .errs = calloc(nfiles, sizeof(elfu_err_t)),
+      .has_symbols = calloc(nfiles, sizeof(bool)),
+      .alias = calloc(nfiles ? nfiles : 1, sizeof(bool)),
+  };
+  pthread_t workers[NM_RESOLVE_MAX_WORKERS];
+  size_t nworkers = 0;
+
+  if (!ctx.map || !ctx.open_errno || !ctx.errs || !ctx.has_symbols || !ctx.alias ||
+      !nm_resolve_aliases(files, nfiles, ctx.alias))
+    goto oom;
+
+  const auto cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  auto wanted = (cpus > 0) ? (size_t)cpus : 1;
+  if (wanted > nfiles)
+    wanted = nfiles;
+  if (wanted > NM_RESOLVE_MAX_WORKERS)
+    wanted = NM_RESOLVE_MAX_WORKERS;
+
+  for (; nworkers < wanted; nworkers++) {
+    if (pthread_create(&workers[nworkers], nullptr, nm_resolve_worker, &ctx) != 0)
+      break;
+  }
+  // Always make progress, even if no thread could be spawned.
+  if (nworkers == 0)
+    nm_resolve_worker(&ctx);
+  for (size_t i = 0; i < nworkers; i++)
+    pthread_join(workers[i], nullptr);
+
+  if (atomic_load(&ctx.oom))
+    goto oom;
+
+  for (size_t i = 0; i < nfiles; i++) {
+    g_filename = files[i];
+    if (ctx.alias[i])
+      continue;
+    if (ctx.open_errno[i] && ctx.errs[i] == ELFU_SUCCESS) {
+      if (ctx.open_errno[i] == ENOENT)
+        nm_warn("No such file");
+      else
+        nm_err(strerror(ctx.open_errno[i]));
+      exit_code = EXIT_FAILURE;
+    } else if (ctx.errs[i] != ELFU_SUCCESS && !ctx.has_symbols[i]) {
+      nm_print_err(ctx.errs[i], ctx.open_errno[i]);
+      exit_code = EXIT_FAILURE;
+    } else if (!ctx.has_symbols[i])
+      nm_err("no symbols");
+  }
+
+  const auto problems = nm_resolve_report(&ctx);
+  if (problems < 0)
+    goto oom;
+  if (problems > 0)
+    exit_code = EXIT_FAILURE;
+  goto done;
+
+oom:
+  g_filename = files[0];
+  nm_err(strerror(ENOMEM));
+  exit_code = EXIT_FAILURE;
+done:
+  nm_symmap_destroy(&ctx.map);
+  free(ctx.open_errno);
+  free(ctx.errs);
+  free(ctx.has_symbols);
+  free(ctx.alias);
+  return exit_code;
+}
+
+typedef struct {
+  elfu_t* obj;
+  int fd;
+  nm_sections_t sections;
+  vector(nm_symbol_t) symbols;
+  nm_key_t* keys;
+  size_t count;
+} nm_diff_side_t;
+
+// Order by name, then version, the identity of a symbol across two builds.
+static int nm_cmp_diff(const nm_symbol_t* a, const nm_symbol_t* b) {
+  int cmp;
+  if (a->key.prefix != b->key.prefix)
+    return (a->key.prefix < b->key.prefix) ? -1 : 1;
+  if ((a->key.prefix & 0xff) != 0 &&
+      (cmp = nm_strcmp(a->name + sizeof(u64), b->name + sizeof(u64))) != 0)
+    return cmp;
+
+  if (!a->version || !b->version)
+    return (a->version != nullptr) - (b->version != nullptr);
+  return nm_strcmp(a->version, b->version);
+}
+
+static int nm_cmp_diff_key(const nm_key_t* a, const nm_key_t* b, const void* ctx) {
+  const nm_symbol_t* symbols = ctx;
+
+  // Most comparisons are decided by the prefixes, without loading the symbols.
+  if (a->prefix != b->prefix)
+    return (a->prefix < b->prefix) ? -1 : 1;
+  const auto cmp = nm_cmp_diff(&symbols[a->index], &symbols[b->index]);
+  if (cmp == 0)
+    return (a->index < b->index) ? -1 : 1;
+  return cmp;
+}
+
+static bool nm_diff_load(nm_diff_side_t* side, const char* name) {
+  bool has_symbols = false;
+
+  if ((side->obj = nm_open_object(name, nullptr, &side->fd)) == nullptr)
+    return false;
+
+  if (!nm_sections_build(side->obj, &side->sections)) {
+    nm_err(strerror(ENOMEM));
+    return false;
+  }
+
+  elfu_section_t sym;
+  if (nm_list_symtab(side->obj, &g_opts, &sym) &&
+      nm_process_symtab(side->obj, &side->sections, &g_opts, &sym, &side->symbols,
+                        nullptr, &has_symbols) < 0) {
+    nm_err(strerror(ENOMEM));
+    return false;
+  }
+
+  side->count = vector_len(side->symbols);
+  side->keys = malloc((side->count ? side->count : 1) * sizeof(nm_key_t));
+  if (!side->keys) {
+    nm_err(strerror(ENOMEM));
+    return false;
+  }
+
+  for (size_t i = 0; i < side->count; i++)
+    side->keys[i] = side->symbols[i].key;
+  heapsort(side->keys, side->count, nm_cmp_diff_key, side->symbols);
+
+  return true;
+}
+
+static void nm_diff_side_destroy(nm_diff_side_t* side) {
+  free(side->keys);
+  vector_destroy(side->symbols);
+  nm_sections_destroy(&side->sections);
+  elfu_destroy(&side->obj);
+  if (side->fd != -1)
+    close(side->fd);
+}
+
+static const nm_symbol_t* nm_diff_at(const nm_diff_side_t* side, const size_t i) {
+  return (i < side->count) ? &side->symbols[side->keys[i].index] : nullptr;
+}
+
+static void nm_diff_put(const char* prefix, const nm_symbol_t* s) {
+  nm_out_puts(&g_out, prefix);
+  nm_out_putc(&g_out, (char)s->type);
+  nm_out_putc(&g_out, ' ');
+  nm_symbol_put_name(&g_out, s);
+  nm_out_putc(&g_out, '\n');
+}
+
+// Both symbols share the same identity, report what changed between the two builds.
+static void nm_diff_changed(const nm_symbol_t* a, const nm_symbol_t* b) {
+  const auto version = (a->version != nullptr) != (b->version != nullptr) ||
+                       (a->version && ad_strcmp(a->version, b->version) != 0) ||
+                       a->version_hidden != b->version_hidden;
+  const auto type = a->type != b->type;
+  const auto size = a->internal.st_size != b->internal.st_size;
+
+  if (!version && !type && !size)
+    return;
+
+  char dec[24];
+  nm_out_puts(&g_out, "! ");
+  nm_symbol_put_name(&g_out, b);
+  nm_out_putc(&g_out, ':');
+  if (type) {
+    nm_out_puts(&g_out, " type ");
+    nm_out_write(&g_out, (char[]){(char)a->type, ' ', '-', '>', ' ', (char)b->type}, 6);
+  }
+  if (size) {
+    nm_out_puts(&g_out, " size ");
+    nm_out_puts(&g_out, nm_dec(dec, a->internal.st_size));
+    nm_out_puts(&g_out, " -> ");
+    nm_out_puts(&g_out, nm_dec(dec, b->internal.st_size));
+  }
+  if (version) {
+    nm_out_puts(&g_out, " version ");
+    nm_out_puts(&g_out, a->version_hidden ? "@" : "@@");
+    nm_out_puts(&g_out, a->version ? a->version : "");
+    nm_out_puts(&g_out, " -> ");
+    nm_out_puts(&g_out, b->version_hidden ? "@" : "@@");
+    nm_out_puts(&g_out, b->version ? b->version : "");
+  }
+  nm_out_putc(&g_out, '\n');
+}
+
+static size_t nm_diff_group(const nm_diff_side_t* side, size_t i) {
+  const auto first = nm_diff_at(side, i);
+  size_t n = 1;
+
+  for (const nm_symbol_t* s; (s = nm_diff_at(side, i + n)) != nullptr; n++) {
+    if (s->key.prefix != first->key.prefix || ad_strcmp(s->name, first->name) != 0)
+      break;
+  }
+  return n;
+}
+
+/*!
+ * Compare the symbol tables of two objects. Both are sorted by (name, version) and
+ * merged linearly, the report is streamed as the merge progresses:
+ *  `- T name@VER` removed, `+ T name@VER` added, `! name@VER: ...` changed type,
+ *  size or version.
+ * A name defined once on both sides is considered the same symbol even if its version
+ * changed.
+ */
+static int nm_diff_files(const char* old_name, const char* new_name) {
+  int exit_code = EXIT_FAILURE;
+  nm_diff_side_t old = {.fd = -1};
+  nm_diff_side_t new = {.fd = -1};
+
+  if (!nm_diff_load(&old, old_name) || !nm_diff_load(&new, new_name))
+    goto done;
+
+  size_t i = 0;
+  size_t j = 0;
+  while (i < old.count || j < new.count) {
+    const auto a = nm_diff_at(&old, i);
+    const auto b = nm_diff_at(&new, j);
+
+    if (!b || (a && nm_cmp_diff(a, b) < 0 && ad_strcmp(a->name, b->name) != 0)) {
+      nm_diff_put("- ", a);
+      i++;
+      continue;
+    }
+    if (!a || ad_strcmp(a->name, b->name) != 0) {
+      nm_diff_put("+ ", b);
+      j++;
+      continue;
+    }
+
+    // Same name on both sides, a single symbol on each side is the same symbol.
+    const auto na = nm_diff_group(&old, i);
+    const auto nb = nm_diff_group(&new, j);
+    if (na == 1 && nb == 1) {
+      nm_diff_changed(a, b);
+      i++;
+      j++;
+      continue;
+    }
+
+    // Versioned aliases, match them by version.
+    const auto end_a = i + na;
+    const auto end_b = j + nb;
+    while (i < end_a || j < end_b) {
+      const auto ga = (i < end_a) ? nm_diff_at(&old, i) : nullptr;
+      const auto gb = (j < end_b) ? nm_diff_at(&new, j) : nullptr;
+      const auto cmp = (!ga) ? 1 : (!gb) ? -1 : nm_cmp_diff(ga, gb);
+
+      if (cmp < 0) {
+        nm_diff_put("- ", ga);
+        i++;
+      } else if (cmp > 0) {
+        nm_diff_put("+ ", gb);
+        j++;
+      } else {
+        nm_diff_changed(ga, gb);
+        i++;
+        j++;
+      }
+    }
+  }
+
+  exit_code = nm_out_flush(&g_out) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+done:
+  nm_diff_side_destroy(&old);
+  nm_diff_side_destroy(&new);
+  return exit_code;
+}
+
 #define NM_DEFAULT_PROGRAM "a.out"
 
+/*!
+ * Run the selected mode on \a files.
+ * @param recursive Whether the files were collected by -R: the file names are always
+ * printed, and an empty tree doesn't fall back to a.out.
+ */
+static int nm_run(char** files, const size_t count, const bool recursive) {
+  // stdin can only be consumed once.
+  if (flag_lookup && count > 1) {
+    ad_puts(NM_COMMAND_USAGE);
+    return EXIT_FAILURE;
+  }
+
+  if (flag_diff) {
+    if (count != 2) {
+      ad_puts(NM_COMMAND_USAGE);
+      return EXIT_FAILURE;
+    }
+    return nm_diff_files(files[0], files[1]);
+  }
+
+  if (flag_resolve) {
+    static char* default_files[] = {NM_DEFAULT_PROGRAM};
+    return (count == 0 && !recursive) ? nm_resolve_files(default_files, 1)
+                                      : nm_resolve_files(files, count);
+  }
+
+  if (count == 0)
+    return recursive ? EXIT_SUCCESS : nm_process_file(NM_DEFAULT_PROGRAM, nullptr, false);
+  if (count == 1 && !recursive)
+    return nm_process_file(files[0], nullptr, false);
+
+  return nm_process_files(files, count);
+}
+
+static void nm_walk_warn(const char* path, int err) {
+  g_filename = path;
+  nm_err(strerror(err));
+}
+
+// Gather the objects found under the -R directories, then the [file(s)], into \a files.
+static int nm_collect_files(char** args, const size_t count, vector(char*) * files) {
+  int exit_code = EXIT_SUCCESS;
+
+  for (size_t i = 0; i < vector_len(flag_dirs); i++) {
+    if (!nm_walk(flag_dirs[i], files, nm_walk_warn))
+      exit_code = EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    char* file = strdup(args[i]);
+    if (!file || !vector_push(*files, file)) {
+      free(file);
+      nm_walk_warn(args[i], ENOMEM);
+      return EXIT_FAILURE;
+    }
+  }
+
+  return exit_code;
+}
+
+enum {
+  NM_OPT_LIMIT = UINT8_MAX + 1,
+  NM_OPT_SIZE_SORT,
+  NM_OPT_LOOKUP,
+  NM_OPT_FIND,
+  NM_OPT_RESOLVE,
+  NM_OPT_DIFF,
+  NM_OPT_FORMAT,
+  NM_OPT_PRINT_SECTION,
+  NM_OPT_MATCH,
+  NM_OPT_MMAP,
+  NM_OPT_PREFETCH,
+  NM_OPT_DEDUP,
+  NM_OPT_STATS,
+};
+
+static const opt_long_t nm_long_opts[] = {
+    {.name = "limit", .val = NM_OPT_LIMIT, .has_arg = true},
+    {.name = "numeric-sort", .val = 'n'},
+    {.name = "size-sort", .val = NM_OPT_SIZE_SORT},
+    {.name = "print-size", .val = 'S'},
+    {.name = "print-section", .val = NM_OPT_PRINT_SECTION},
+    {.name = "lookup", .val = NM_OPT_LOOKUP},
+    {.name = "find", .val = NM_OPT_FIND, .has_arg = true},
+    {.name = "resolve", .val = NM_OPT_RESOLVE},
+    {.name = "diff", .val = NM_OPT_DIFF},
+    {.name = "format", .val = NM_OPT_FORMAT, .has_arg = true},
+    {.name = "demangle", .val = 'C'},
+    {.name = "line-numbers", .val = 'l'},
+    {.name = "match", .val = NM_OPT_MATCH, .has_arg = true},
+    {.name = "mmap", .val = NM_OPT_MMAP, .has_arg = true},
+    {.name = "prefetch", .val = NM_OPT_PREFETCH, .has_arg = true},
+    {.name = "dedup", .val = NM_OPT_DEDUP},
+#ifdef NM_STATS
+    {.name = "stats", .val = NM_OPT_STATS},
+#endif
+    {},
+};
+
+static bool nm_parse_size(const char* s, size_t* out) {
+  size_t v = 0;
+
+  if (!*s)
+    return false;
+  for (; *s; s++) {
+    if (*s < '0' || *s > '9')
+      return false;
+    if (v > (SIZE_MAX - (*s - '0')) / 10)
+      return false;
+    v = v * 10 + (*s - '0');
+  }
+
+  *out = v;
+  return true;
+}
+
+/*!
+ * Parse a comma separated list of `NAME`, `NAME@VERSION` or `NAME@@VERSION` queries.
+ * The argument is split in place.
+ */
+static bool nm_parse_find(char* arg) {
+  while (arg) {
+    char* next = nullptr;
+    for (char* c = arg; *c; c++) {
+      if (*c == ',') {
+        *c = 0;
+        next = c + 1;
+        break;
+      }
+    }
+
+    nm_query_t q = {.name = arg};
+    for (char* c = arg; *c; c++) {
+      if (*c == '@') {
+        *c = 0;
+        q.default_only = (c[1] == '@');
+        q.version = c + 1 + q.default_only;
+        break;
+      }
+    }
+
+    if (*q.name && !vector_push(flag_find, q))
+      return false;
+    arg = next;
+  }
+
+  return true;
+}
+
+/*!
+ * Parse a comma separated list of mapping hints: `populate`, `willneed` or `hugepage`.
+ */
+static bool nm_parse_map(const char* arg, u32* flags) {
+  static const struct {
+    const char* name;
+    u32 flag;
+  } hints[] = {
+      {"populate", ELFU_MAP_POPULATE},
+      {"willneed", ELFU_MAP_WILLNEED},
+      {"hugepage", ELFU_MAP_HUGEPAGE},
+  };
+
+  while (*arg) {
+    size_t len = 0;
+    while (arg[len] && arg[len] != ',')
+      len++;
+
+    size_t i = 0;
+    while (i < sizeof(hints) / sizeof(hints[0]) &&
+           (strncmp(hints[i].name, arg, len) != 0 || hints[i].name[len] != 0))
+      i++;
+    if (i == sizeof(hints) / sizeof(hints[0]))
+      return false;
+
+    *flags |= hints[i].flag;
+    arg += len + (arg[len] == ',');
+  }
+
+  return true;
+}
+
 int main(int argc, char** argv) {
-  opt_t opt = nm_opt("prugDah");
+  opt_t opt = nm_opt("prugnDaPSClR:h", nm_long_opts);
 
   int flag;
   while ((flag = opt_next(&opt, argc, argv)) != OPT_END) {
     switch (flag) {
       case 'a':
-        flag_no_filter = true;
+        g_opts.no_filter = true;
         break;
       case 'D':
-        flag_dynamic = true;
-        nm_get_symtab_fn = elfu_get_dynsymtab;
+        g_opts.dynamic = true;
         break;
       case 'g':
-        flag_only_external = true;
+        g_opts.only_external = true;
         break;
       case 'u':
-        flag_only_undefined = true;
+        g_opts.only_undefined = true;
         break;
       case 'r':
-        flag_reverse_sort = true;
+        g_opts.reverse_sort = true;
         break;
+      // Like nm, the last sort option given wins.
       case 'p':
-        flag_no_sort = true;
+        g_opts.no_sort = true;
+        g_opts.numeric_sort = false;
+        g_opts.size_sort = false;
+        break;
+      case 'n':
+        g_opts.no_sort = false;
+        g_opts.numeric_sort = true;
+        g_opts.size_sort = false;
+        break;
+      case NM_OPT_SIZE_SORT:
+        g_opts.no_sort = false;
+        g_opts.numeric_sort = false;
+        g_opts.size_sort = true;
+        break;
+      case 'S':
+        g_opts.print_size = true;
+        break;
+      case NM_OPT_PRINT_SECTION:
+        g_opts.print_section = true;
+        break;
+      case 'l':
+        g_opts.line_numbers = true;
+        break;
+      case NM_OPT_MATCH:
+        nm_match_compile(&g_match, opt.arg);
+        g_opts.match = &g_match;
+        break;
+      case 'C':
+        if (!g_opts.demangler && (g_opts.demangler = nm_demangler_new()) == nullptr) {
+          ad_dputs(STDERR_FILENO, "nm: ");
+          ad_dputs(STDERR_FILENO, strerror(ENOMEM));
+          ad_dputs(STDERR_FILENO, "\n");
+          return EXIT_FAILURE;
+        }
+        break;
+      case NM_OPT_LOOKUP:
+        flag_lookup = true;
+        break;
+      case NM_OPT_FORMAT:
+      {
+        const auto format = nm_format_by_name(opt.arg);
+        if (format < 0) {
+          g_filename = opt.arg;
+          nm_err("invalid output format");
+          return EXIT_FAILURE;
+        }
+        g_opts.format = (nm_format_t)format;
+        break;
+      }
+      case 'P':
+        g_opts.format = NM_FORMAT_POSIX;
+        break;
+      case NM_OPT_DIFF:
+        flag_diff = true;
+        break;
+      case NM_OPT_RESOLVE:
+        flag_resolve = true;
+        break;
+      case NM_OPT_FIND:
+        if (!nm_parse_find((char*)opt.arg)) {
+          ad_dputs(STDERR_FILENO, "nm: ");
+          ad_dputs(STDERR_FILENO, strerror(ENOMEM));
+          ad_dputs(STDERR_FILENO, "\n");
+          return EXIT_FAILURE;
+        }
+        break;
+#ifdef NM_STATS
+      case NM_OPT_STATS:
+        flag_stats = true;
+        break;
+#endif
+      case NM_OPT_MMAP:
+        if (!nm_parse_map(opt.arg, &flag_map)) {
+          g_filename = opt.arg;
+          nm_err("invalid mapping hint");
+          return EXIT_FAILURE;
+        }
+        break;
+      case NM_OPT_DEDUP:
+        flag_dedup = true;
+        break;
+      case NM_OPT_PREFETCH:
+        if (!nm_parse_size(opt.arg, &flag_prefetch)) {
+          g_filename = opt.arg;
+          nm_err("invalid number");
+          return EXIT_FAILURE;
+        }
+        break;
+      case NM_OPT_LIMIT:
+        if (!nm_parse_size(opt.arg, &g_opts.limit)) {
+          g_filename = opt.arg;
+          nm_err("invalid number");
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'R':
+        if (!vector_push(flag_dirs, opt.arg)) {
+          nm_walk_warn(opt.arg, ENOMEM);
+          return EXIT_FAILURE;
+        }
         break;
       case 'h':
       default:
@@ -346,16 +1413,27 @@ int main(int argc, char** argv) {
   argc -= opt.argc;
   argv += opt.argc;
 
-  if (argc == 0)
-    return nm_process_file(NM_DEFAULT_PROGRAM, false);
-  if (argc == 1)
-    return nm_process_file(argv[0], false);
+  // The addresses are resolved to symbols only.
+  if (flag_lookup)
+    g_opts.line_numbers = false;
 
-  int exit_code = EXIT_SUCCESS;
-  if (argc > 1) {
-    for (int i = 0; i < argc; i++)
-      exit_code += nm_process_file(argv[i], true);
+  // Like nm, nothing is listed whatever the files: undefined symbols have no size.
+  if (g_opts.size_sort && g_opts.only_undefined && !flag_lookup && !flag_find &&
+      !flag_resolve && !flag_diff) {
+    ad_dputs(STDERR_FILENO,
+             "nm: Using the --size-sort and --undefined-only options together\n"
+             "nm: will produce no output, since undefined symbols have no size.\n");
+    return EXIT_SUCCESS;
   }
 
+  if (!flag_dirs)
+    return nm_run(argv, (size_t)argc, false);
+
+  vector(char*) files = nullptr;
+  int exit_code = nm_collect_files(argv, (size_t)argc, &files);
+  exit_code += nm_run(files, vector_len(files), true);
+  nm_walk_destroy(&files);
+  vector_destroy(flag_dirs);
+
   return exit_code;
 }
@@ -0,0 +1,138 @@
+#include <nm/nm.h>
+#include <string.h>
+
+// Glob syntax: `*` any run, `?` any character, `[a-z]` / `[!a-z]` a class, `\` escapes
+// the next character. Names are plain strings, `/` has no special meaning.
+
+static bool is_meta(const char c) {
+  return c == '*' || c == '?' || c == '[';
+}
+
+// Match `c` against the class at `p`, just after its `[`.
+// Returns the position after the closing `]`, nullptr if there is none.
+static const char* match_class(const char* p, const u8 c, bool* matched) {
+  const auto negate = (*p == '!' || *p == '^');
+  if (negate)
+    p++;
+
+  bool found = false;
+  // A `]` right after the opening bracket is part of the class.
+  for (bool first = true; *p && (first || *p != ']'); first = false) {
+    u8 lo = (u8)*p++;
+    if (lo == '\\' && *p)
+      lo = (u8)*p++;
+
+    u8 hi = lo;
+    if (p[0] == '-' && p[1] && p[1] != ']') {
+      p++;
+      hi = (u8)*p++;
+      if (hi == '\\' && *p)
+        hi = (u8)*p++;
+    }
+    if (lo <= c && c <= hi)
+      found = true;
+  }
+  if (*p != ']')
+    return nullptr;
+
+  *matched = (found != negate);
+  return p + 1;
+}
+
+// Iterative, only the last star is backtracked to: a later star can absorb anything an
+// earlier one would have.
+static bool match_glob(const char* p, const char* s) {
+  const char* star_p = nullptr;
+  const char* star_s = nullptr;
+
+  for (;;) {
+    if (*p == '*') {
+      while (*p == '*')
+        p++;
+      if (!*p)
+        return true;
+      star_p = p;
+      star_s = s;
+      continue;
+    }
+
+    if (*s) {
+      bool ok;
+      const char* next = p + 1;
+      switch (*p) {
+        case '?':
+          ok = true;
+          break;
+        case '[':
+          // An unterminated class is a plain `[`.
+          if ((next = match_class(p + 1, (u8)*s, &ok)) == nullptr) {
+            ok = (*s == '[');
+            next = p + 1;
+          }
+          break;
+        case '\\':
+          if (p[1]) {
+            ok = (*s == p[1]);
+            next = p + 2;
+            break;
+          }
+          [[fallthrough]];
+        default:
+          ok = (*p == *s);
+          break;
+      }
+      if (ok) {
+        p = next;
+        s++;
+        continue;
+      }
+    } else if (!*p)
+      return true;
+
+    // Mismatch, let the last star absorb one more character.
+    if (!star_p || !*star_s)
+      return false;
+    p = star_p;
+    s = ++star_s;
+  }
+}
+
+void nm_match_compile(nm_match_t* m, const char* pattern) {
+  *m = (nm_match_t){.pattern = pattern, .literal = pattern};
+
+  for (const char* c = pattern; *c && !m->glob; c++)
+    m->glob = is_meta(*c);
+  if (!m->glob) {
+    m->literal_len = strlen(pattern);
+    return;
+  }
+
+  // Longest run of plain characters outside of the classes.
+  const char* c = pattern;
+  while (*c) {
+    if (*c == '[') {
+      bool unused;
+      const auto end = match_class(c + 1, 0, &unused);
+      c = end ? end : c + 1;
+      continue;
+    }
+    if (is_meta(*c) || *c == '\\') {
+      c += (*c == '\\' && c[1]) ? 2 : 1;
+      continue;
+    }
+
+    const auto start = c;
+    while (*c && !is_meta(*c) && *c != '\\')
+      c++;
+    if ((size_t)(c - start) > m->literal_len) {
+      m->literal = start;
+      m->literal_len = (size_t)(c - start);
+    }
+  }
+}
+
+bool nm_match(const nm_match_t* m, const char* name) {
+  if (m->literal_len && !nm_strfind(name, m->literal, m->literal_len))
+    return false;
+  return !m->glob || match_glob(m->pattern, name);
+}
@@ -1,15 +1,62 @@
 #include <nm/opt.h>
 #include <stddef.h>
 
-opt_t nm_opt(const char* flags) {
-  opt_t opt = {};
+opt_t nm_opt(const char* flags, const opt_long_t* longs) {
+  opt_t opt = {.longs = longs};
 
-  for (size_t i = 0; flags[i]; i++)
-    opt.lut[(unsigned char)flags[i]] = true;
+  for (size_t i = 0; flags[i]; i++) {
+    const auto c = (unsigned char)flags[i];
+    opt.lut[c] = true;
+    if (flags[i + 1] == ':') {
+      opt.lut_arg[c] = true;
+      i++;
+    }
+  }
 
   return opt;
 }
 
+static bool opt_long_match(const char* arg, const char* name, const char** value) {
+  size_t i = 0;
+  for (; name[i]; i++) {
+    if (arg[i] != name[i])
+      return false;
+  }
+
+  if (arg[i] == '=') {
+    *value = arg + i + 1;
+    return true;
+  }
+  return arg[i] == 0;
+}
+
+static int opt_next_long(opt_t* o, int argc, char** argv) {
+  const auto arg = argv[o->argc++] + 2;
+
+  for (size_t i = 0; o->longs && o->longs[i].name; i++) {
+    const auto l = &o->longs[i];
+    const char* value = nullptr;
+
+    if (!opt_long_match(arg, l->name, &value))
+      continue;
+
+    if (!l->has_arg)
+      return value ? OPT_UNKNOWN : l->val;
+
+    // --name=value or --name value
+    if (!value) {
+      if (o->argc == argc)
+        return OPT_UNKNOWN;
+      value = argv[o->argc++];
+    }
+
+    o->arg = value;
+    return l->val;
+  }
+
+  return OPT_UNKNOWN;
+}
+
 int opt_next(opt_t* o, int argc, char** argv) {
   if (o->argc == 0)
     o->argc = 1;
@@ -24,19 +71,32 @@ int opt_next(opt_t* o, int argc, char** argv) {
     o->argc++;
     goto end;
   }
+  if (arg[1] == '-')
+    return opt_next_long(o, argc, argv);
 
   if (o->argp == 0)
     o->argp = 1;
   const auto opt = arg[o->argp++];
-  if (!arg[o->argp]) {
+  const auto value = arg + o->argp;
+  if (!*value || o->lut_arg[(unsigned char)opt]) {
     o->argc++;
-    o->argp = -1;
+    o->argp = 0;
   }
 
   if (!o->lut[(unsigned char)opt])
     return OPT_UNKNOWN;
+  if (!o->lut_arg[(unsigned char)opt])
+    return opt;
+
+  // -Rvalue or -R value
+  if (*value)
+    o->arg = value;
+  else if (o->argc < argc)
+    o->arg = argv[o->argc++];
+  else
+    return OPT_UNKNOWN;
   return opt;
 
 end:
   return OPT_END;
-}
\ No newline at end of file
+}
@@ -0,0 +1,60 @@
+#include <errno.h>
+#include <nm/out.h>
+#include <nm/stats.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool write_fd(const int fd, const char* data, const size_t len) {
+  size_t done = 0;
+
+  while (done < len) {
+    const auto w = write(fd, data + done, len - done);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return false;
+    done += (size_t)w;
+  }
+  return true;
+}
+
+bool nm_sink_fd(void* ctx, const void* data, const size_t len) {
+  return write_fd(*(const int*)ctx, data, len);
+}
+
+bool nm_out_flush(nm_out_t* out) {
+  if (out->len == 0)
+    return true;
+
+  const auto written = out->sink ? out->sink->write(out->sink->ctx, out->data, out->len)
+                                 : write_fd(out->fd, out->data, out->len);
+  if (!written) {
+    out->len = 0;
+    out->failed = true;
+    return false;
+  }
+  NM_STAT_ADD(written, out->len);
+
+  out->len = 0;
+  return true;
+}
+
+void nm_out_write(nm_out_t* out, const void* data, size_t len) {
+  const u8* p = data;
+
+  while (len) {
+    if (out->len == NM_OUT_SIZE && !nm_out_flush(out))
+      return;
+
+    const auto room = NM_OUT_SIZE - out->len;
+    const auto n = (len < room) ? len : room;
+    memcpy(out->data + out->len, p, n);
+    out->len += n;
+    p += n;
+    len -= n;
+  }
+}
+
+void nm_out_puts(nm_out_t* out, const char* s) {
+  nm_out_write(out, s, strlen(s));
+}
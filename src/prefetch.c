@@ -0,0 +1,500 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <nm/prefetch.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+
+// The files are taken in order, file `i` is read ahead in the slot `i % depth`: once a
+// file is taken, its slot starts on the file `depth` positions further.
+//
+// With io_uring, a slot issues the open and the statx of its file together, then reads
+// the whole file once its size is known. Completions are reaped whenever the caller waits
+// for a file that isn't ready yet, and the following operations are submitted at the same
+// time: the kernel works on the next files while the current one is listed.
+//
+// The ring is set up with the raw system calls, the few operations used don't need
+// liburing. Where io_uring is missing or forbidden (old kernels, seccomp), each file is
+// opened and read with pread when it is taken.
+
+typedef enum {
+  SLOT_IDLE,
+  SLOT_OPENING,  // openat and statx in flight
+  SLOT_READING,
+  SLOT_READY,
+} slot_state_t;
+
+typedef struct {
+  slot_state_t state;
+  size_t file;
+  u32 pending;  // Operations in flight
+
+  struct statx stx;
+  bool has_stx;
+  size_t done;  // Bytes read so far
+
+  nm_prefetched_t out;
+} prefetch_slot_t;
+
+enum {
+  OP_OPEN,
+  OP_STATX,
+  OP_READ,
+};
+
+// user_data of an operation: the file index and the operation.
+#define op_data(file, op) (((u64)(file) << 2) | (op))
+
+typedef struct {
+  int fd;
+  u32 entries;
+
+  void* sq_ring;
+  size_t sq_ring_size;
+  void* cq_ring;  // Same mapping as sq_ring with IORING_FEAT_SINGLE_MMAP
+  size_t cq_ring_size;
+  struct io_uring_sqe* sqes;
+  size_t sqes_size;
+
+  _Atomic u32* sq_head;
+  _Atomic u32* sq_tail;
+  u32 sq_mask;
+  u32* sq_array;
+  _Atomic u32* cq_head;
+  _Atomic u32* cq_tail;
+  u32 cq_mask;
+  struct io_uring_cqe* cqes;
+
+  u32 queued;    // Filled and not yet submitted
+  u32 inflight;  // Submitted and not yet completed
+} uring_t;
+
+struct _nm_prefetch_t {
+  char** files;
+  size_t nfiles;
+  size_t depth;
+  size_t next;     // The next file to take
+  size_t started;  // The next file to start reading ahead
+
+  prefetch_slot_t* slots;
+
+  bool has_ring;
+  uring_t ring;
+};
+
+/* io_uring */
+
+static int uring_enter(const uring_t* r, const u32 submit, const u32 wait) {
+  const u32 flags = wait ? IORING_ENTER_GETEVENTS : 0;
+  return (int)syscall(__NR_io_uring_enter, r->fd, submit, wait, flags, nullptr, 0);
+}
+
+static void uring_destroy(uring_t* r) {
+  if (r->sqes)
+    munmap(r->sqes, r->sqes_size);
+  if (r->cq_ring && r->cq_ring != r->sq_ring)
+    munmap(r->cq_ring, r->cq_ring_size);
+  if (r->sq_ring)
+    munmap(r->sq_ring, r->sq_ring_size);
+  if (r->fd >= 0)
+    close(r->fd);
+  *r = (uring_t){.fd = -1};
+}
+
+// Whether the kernel supports every operation of the pipeline.
+static bool uring_probe(const uring_t* r) {
+  constexpr size_t nops = IORING_OP_READ + 1;
+  struct io_uring_probe* probe =
+      calloc(1, sizeof(struct io_uring_probe) + nops * sizeof(struct io_uring_probe_op));
+  if (!probe)
+    return false;
+
+  bool supported =
+      syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PROBE, probe, nops) == 0;
+  const u8 ops[] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ};
+  for (size_t i = 0; supported && i < sizeof(ops); i++) {
+    supported =
+        ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+  }
+
+  free(probe);
+  return supported;
+}
+
+static bool uring_init(uring_t* r, const u32 entries) {
+  *r = (uring_t){.fd = -1};
+
+  struct io_uring_params params = {};
+  r->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (r->fd < 0)
+    return false;
+  r->entries = params.sq_entries;
+
+  r->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+  r->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  const auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single && r->cq_ring_size > r->sq_ring_size)
+    r->sq_ring_size = r->cq_ring_size;
+
+  r->sq_ring = mmap(nullptr, r->sq_ring_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  if (r->sq_ring == MAP_FAILED) {
+    r->sq_ring = nullptr;
+    goto err;
+  }
+
+  r->cq_ring = r->sq_ring;
+  if (!single) {
+    r->cq_ring = mmap(nullptr, r->cq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    if (r->cq_ring == MAP_FAILED) {
+      r->cq_ring = nullptr;
+      goto err;
+    }
+  }
+
+  r->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  r->sqes = mmap(nullptr, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 r->fd, IORING_OFF_SQES);
+  if (r->sqes == MAP_FAILED) {
+    r->sqes = nullptr;
+    goto err;
+  }
+
+  u8* sq = r->sq_ring;
+  r->sq_head = (_Atomic u32*)(sq + params.sq_off.head);
+  r->sq_tail = (_Atomic u32*)(sq + params.sq_off.tail);
+  r->sq_mask = *(u32*)(sq + params.sq_off.ring_mask);
+  r->sq_array = (u32*)(sq + params.sq_off.array);
+
+  u8* cq = r->cq_ring;
+  r->cq_head = (_Atomic u32*)(cq + params.cq_off.head);
+  r->cq_tail = (_Atomic u32*)(cq + params.cq_off.tail);
+  r->cq_mask = *(u32*)(cq + params.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+  if (!uring_probe(r))
+    goto err;
+  return true;
+
+err:
+  uring_destroy(r);
+  return false;
+}
+
+// Submit the queued operations, and wait for at least one completion if `wait`.
+static bool uring_submit(uring_t* r, const bool wait) {
+  for (;;) {
+    const auto ret = uring_enter(r, r->queued, wait ? 1 : 0);
+    if (ret >= 0) {
+      r->inflight += (u32)ret;
+      r->queued -= (u32)ret;
+      return true;
+    }
+    if (errno != EINTR && errno != EAGAIN)
+      return false;
+  }
+}
+
+static struct io_uring_sqe* uring_sqe(uring_t* r) {
+  const auto tail = atomic_load_explicit(r->sq_tail, memory_order_relaxed);
+  // Never happens with the ring sized for two operations per slot, but a full queue
+  // only has to be submitted to make room.
+  if (tail - atomic_load_explicit(r->sq_head, memory_order_acquire) == r->entries &&
+      !uring_submit(r, false))
+    return nullptr;
+
+  const auto index = tail & r->sq_mask;
+  struct io_uring_sqe* sqe = &r->sqes[index];
+  *sqe = (struct io_uring_sqe){};
+  r->sq_array[index] = index;
+  return sqe;
+}
+
+static void uring_push(uring_t* r) {
+  const auto tail = atomic_load_explicit(r->sq_tail, memory_order_relaxed);
+  atomic_store_explicit(r->sq_tail, tail + 1, memory_order_release);
+  r->queued++;
+}
+
+/* slots */
+
+static prefetch_slot_t* slot_of(const nm_prefetch_t* p, const size_t file) {
+  return &p->slots[file % p->depth];
+}
+
+static bool slot_wants_read(const prefetch_slot_t* slot,
+                            const u64 size,
+                            const bool regular) {
+  return slot->out.fd >= 0 && regular && size > 0 && size <= NM_PREFETCH_MAX_SIZE;
+}
+
+static bool slot_queue_read(nm_prefetch_t* p, prefetch_slot_t* slot) {
+  auto sqe = uring_sqe(&p->ring);
+  if (!sqe)
+    return false;
+
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = slot->out.fd;
+  sqe->addr = (u64)(uintptr_t)(slot->out.data + slot->done);
+  sqe->len = (u32)(slot->out.size - slot->done);
+  sqe->off = slot->done;
+  sqe->user_data = op_data(slot->file, OP_READ);
+  uring_push(&p->ring);
+
+  slot->pending++;
+  return true;
+}
+
+static void slot_start(nm_prefetch_t* p, const size_t file) {
+  const auto slot = slot_of(p, file);
+  *slot = (prefetch_slot_t){
+      .state = SLOT_IDLE,
+      .file = file,
+      .out = {.name = p->files[file], .fd = -1},
+  };
+  if (!p->has_ring)
+    return;
+
+  auto sqe = uring_sqe(&p->ring);
+  if (!sqe)
+    return;
+  sqe->opcode = IORING_OP_OPENAT;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (u64)(uintptr_t)p->files[file];
+  sqe->open_flags = O_RDONLY | O_CLOEXEC;
+  sqe->user_data = op_data(file, OP_OPEN);
+  uring_push(&p->ring);
+  slot->pending++;
+  slot->state = SLOT_OPENING;
+
+  if ((sqe = uring_sqe(&p->ring)) == nullptr)
+    return;
+  sqe->opcode = IORING_OP_STATX;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (u64)(uintptr_t)p->files[file];
+  sqe->len = STATX_TYPE | STATX_SIZE;
+  sqe->off = (u64)(uintptr_t)&slot->stx;
+  sqe->user_data = op_data(file, OP_STATX);
+  uring_push(&p->ring);
+  slot->pending++;
+}
+
+// The open and the statx of the slot completed.
+static void slot_opened(nm_prefetch_t* p, prefetch_slot_t* slot) {
+  slot->state = SLOT_READY;
+  const auto stx = &slot->stx;
+  if (!slot->has_stx || !slot_wants_read(slot, stx->stx_size, S_ISREG(stx->stx_mode)))
+    return;
+
+  slot->out.size = slot->stx.stx_size;
+  if ((slot->out.data = malloc(slot->out.size)) == nullptr)
+    return;
+  if (!slot_queue_read(p, slot)) {
+    free(slot->out.data);
+    slot->out.data = nullptr;
+    return;
+  }
+  slot->state = SLOT_READING;
+}
+
+static void slot_read(nm_prefetch_t* p, prefetch_slot_t* slot, const int res) {
+  if (res == -EINTR || res == -EAGAIN) {
+    if (slot_queue_read(p, slot))
+      return;
+  } else if (res > 0) {
+    slot->done += (size_t)res;
+    if (slot->done < slot->out.size && slot_queue_read(p, slot))
+      return;
+  }
+
+  slot->state = SLOT_READY;
+  if (res < 0) {
+    slot->out.err = -res;
+    free(slot->out.data);
+    slot->out.data = nullptr;
+  } else
+    slot->out.size = slot->done;  // The file shrank since statx
+}
+
+static void slot_complete(nm_prefetch_t* p, const struct io_uring_cqe* cqe) {
+  const auto slot = slot_of(p, (size_t)(cqe->user_data >> 2));
+  slot->pending--;
+
+  switch (cqe->user_data & 3) {
+    case OP_OPEN:
+      if (cqe->res < 0)
+        slot->out.err = -cqe->res;
+      else
+        slot->out.fd = cqe->res;
+      break;
+    case OP_STATX:
+      slot->has_stx = (cqe->res == 0);
+      break;
+    case OP_READ:
+      slot_read(p, slot, cqe->res);
+      return;
+    default:
+      return;
+  }
+
+  if (slot->pending == 0)
+    slot_opened(p, slot);
+}
+
+static void reap(nm_prefetch_t* p) {
+  auto r = &p->ring;
+  auto head = atomic_load_explicit(r->cq_head, memory_order_relaxed);
+  const auto tail = atomic_load_explicit(r->cq_tail, memory_order_acquire);
+
+  for (; head != tail; head++) {
+    const auto cqe = r->cqes[head & r->cq_mask];
+    r->inflight--;
+    slot_complete(p, &cqe);
+  }
+  atomic_store_explicit(r->cq_head, head, memory_order_release);
+}
+
+// Open and read the file of the slot without io_uring.
+static void slot_load(prefetch_slot_t* slot) {
+  // Whatever the ring was doing for the slot is abandoned, its buffer with it: the kernel
+  // may still write to it. The descriptor can be closed, a pending read holds its own
+  // reference to the file.
+  if (slot->out.fd >= 0)
+    close(slot->out.fd);
+  slot->out = (nm_prefetched_t){.name = slot->out.name, .fd = -1};
+  slot->done = 0;
+  slot->state = SLOT_READY;
+  if ((slot->out.fd = open(slot->out.name, O_RDONLY | O_CLOEXEC)) < 0) {
+    slot->out.err = errno;
+    return;
+  }
+
+  struct stat st;
+  if (fstat(slot->out.fd, &st) < 0 ||
+      !slot_wants_read(slot, st.st_size, S_ISREG(st.st_mode)))
+    return;
+  if ((slot->out.data = malloc(st.st_size)) == nullptr)
+    return;
+
+  while (slot->done < (size_t)st.st_size) {
+    const auto rd = pread(slot->out.fd, slot->out.data + slot->done,
+                          (size_t)st.st_size - slot->done, (off_t)slot->done);
+    if (rd < 0 && errno == EINTR)
+      continue;
+    if (rd < 0) {
+      slot->out.err = errno;
+      free(slot->out.data);
+      slot->out.data = nullptr;
+      return;
+    }
+    if (rd == 0)
+      break;
+    slot->done += (size_t)rd;
+  }
+  slot->out.size = slot->done;
+}
+
+nm_prefetch_t* nm_prefetch_new(char** files, const size_t nfiles, size_t depth) {
+  if (depth == 0)
+    depth = 1;
+  if (depth > nfiles)
+    depth = nfiles ? nfiles : 1;
+
+  nm_prefetch_t* p = calloc(1, sizeof(nm_prefetch_t));
+  if (!p)
+    return nullptr;
+  *p = (nm_prefetch_t){
+      .files = files,
+      .nfiles = nfiles,
+      .depth = depth,
+      .slots = calloc(depth, sizeof(prefetch_slot_t)),
+      .ring = {.fd = -1},
+  };
+  if (!p->slots) {
+    free(p);
+    return nullptr;
+  }
+
+  // Two operations per slot at most, the open and the statx.
+  p->has_ring = uring_init(&p->ring, (u32)(2 * depth));
+  for (; p->started < nfiles && p->started < depth; p->started++)
+    slot_start(p, p->started);
+  if (p->has_ring && !uring_submit(&p->ring, false)) {
+    // Nothing was submitted, the slots are loaded when they are taken.
+    uring_destroy(&p->ring);
+    p->has_ring = false;
+  }
+
+  return p;
+}
+
+bool nm_prefetch_next(nm_prefetch_t* p, nm_prefetched_t* file) {
+  if (p->next == p->nfiles)
+    return false;
+
+  const auto slot = slot_of(p, p->next);
+  while (p->has_ring && slot->state != SLOT_READY && slot->state != SLOT_IDLE) {
+    if (!uring_submit(&p->ring, true)) {
+      p->has_ring = false;
+      break;
+    }
+    reap(p);
+  }
+  // Without the ring, or if it failed, the file is loaded right now.
+  if (slot->state != SLOT_READY)
+    slot_load(slot);
+
+  *file = slot->out;
+  slot->state = SLOT_IDLE;
+  p->next++;
+
+  if (p->started < p->nfiles) {
+    slot_start(p, p->started++);
+    if (p->has_ring && !uring_submit(&p->ring, false))
+      p->has_ring = false;
+  }
+  return true;
+}
+
+void nm_prefetched_release(nm_prefetched_t* file) {
+  if (file->fd >= 0)
+    close(file->fd);
+  free(file->data);
+  *file = (nm_prefetched_t){.fd = -1};
+}
+
+void nm_prefetch_destroy(nm_prefetch_t** p) {
+  if (!p || !*p)
+    return;
+
+  const auto pf = *p;
+  if (pf->ring.fd >= 0) {
+    // The kernel still writes to the buffers of the operations in flight.
+    while (pf->has_ring && pf->ring.inflight && uring_submit(&pf->ring, true))
+      reap(pf);
+    if (pf->ring.inflight || pf->ring.queued) {
+      // Leak the buffers rather than let the kernel write to freed memory.
+      uring_destroy(&pf->ring);
+      free(pf);
+      *p = nullptr;
+      return;
+    }
+  }
+
+  for (size_t i = pf->next; i < pf->started; i++) {
+    const auto slot = slot_of(pf, i);
+    nm_prefetched_release(&slot->out);
+  }
+  uring_destroy(&pf->ring);
+  free(pf->slots);
+  free(pf);
+  *p = nullptr;
+}
@@ -0,0 +1,130 @@
+#include <nm/nm.h>
+#include <stdlib.h>
+#include <string.h>
+
+static nm_sym_type_t section_type(const elfu_section_t* section, const char* name) {
+  const auto type = section->hdr.sh_type;
+  const auto flags = section->hdr.sh_flags;
+
+  const auto ro = (flags & SHF_WRITE) == 0;
+  const auto data = (flags & SHF_ALLOC) != 0;
+  const auto code = (flags & SHF_EXECINSTR) != 0;
+
+  if (type == SHT_PROGBITS && code) {
+    // .text section
+    return SYM_CODE_L;
+  }
+
+  // .bss section
+  if (type == SHT_NOBITS && (!ro && data))
+    return SYM_BSS_L;
+  // data sections
+  if (!ro && data)
+    return SYM_INITD_L;
+  if (data && ro)
+    return SYM_RD_ONLY_DATA_L;
+  if (strncmp(name, ".debug", 6) == 0)
+    return SYM_DEBUG;
+  if (!code && !data && ro)
+    return SYM_RD_ONLY;
+  return SYM_UNKNOWN;
+}
+
+// Sections headers are stripped or corrupted, fall back to the loadable segments.
+static bool segments_build(const elfu_t* obj, nm_sections_t* sections) {
+  const size_t count = obj->ehdr.e_phnum;
+  if (count == 0)
+    return true;
+  if ((sections->segments = malloc(count * sizeof(nm_segment_t))) == nullptr)
+    return false;
+
+  elfu_phdr_t phdr;
+  for (size_t i = 0; i < count && elfu_get_phdr(obj, i, &phdr); i++) {
+    if (phdr.p_type != PT_LOAD && phdr.p_type != PT_TLS)
+      continue;
+    const auto tls = (phdr.p_type == PT_TLS);
+    sections->segments[sections->nsegments++] = (nm_segment_t){
+        .addr = tls ? 0 : phdr.p_vaddr,
+        .filesz = phdr.p_filesz,
+        .memsz = phdr.p_memsz,
+        // The PT_TLS segment is only readable, its copies are not.
+        .flags = tls ? (PF_R | PF_W) : phdr.p_flags,
+        .tls = tls,
+    };
+  }
+
+  return true;
+}
+
+bool nm_sections_build(const elfu_t* obj, nm_sections_t* sections) {
+  const size_t count = obj->ehdr.e_shnum;
+
+  *sections = (nm_sections_t){};
+  if (count == 0)
+    return segments_build(obj, sections);
+  if ((sections->entries = malloc(count * sizeof(nm_section_t))) == nullptr)
+    return false;
+  sections->count = count;
+
+  size_t readable = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    const auto entry = &sections->entries[i];
+    *entry = (nm_section_t){.name = "", .type = SYM_UNKNOWN};
+
+    elfu_section_t section;
+    if (!elfu_get_section(obj, i, &section))
+      continue;
+    readable++;
+
+    const auto name = elfu_strptr(obj, obj->ehdr.e_shstrndx, section.hdr.sh_name);
+    if (name)
+      entry->name = name;
+    entry->addr = section.hdr.sh_addr;
+    entry->size = section.hdr.sh_size;
+    entry->type = section_type(&section, entry->name);
+  }
+
+  return readable != 0 || segments_build(obj, sections);
+}
+
+nm_sym_type_t nm_sections_type(const nm_sections_t* sections, const size_t index) {
+  // Obviously not a valid section index
+  if (index != SHN_UNDEF && index >= SHN_LORESERVE)
+    return SYM_UNKNOWN;
+
+  // Really, really special case, when nm (bfd) encounters a symbol for which his section
+  // doesn't exist, it classifies it as absolute.
+  if (index > sections->count)
+    return SYM_ABSOLUTE_L;
+  if (index == sections->count)
+    return SYM_UNKNOWN;
+
+  return sections->entries[index].type;
+}
+
+nm_sym_type_t nm_segments_type(const nm_sections_t* sections,
+                               const u64 addr,
+                               const bool tls) {
+  for (size_t i = 0; i < sections->nsegments; i++) {
+    const auto segment = &sections->segments[i];
+    if (segment->tls != tls || addr < segment->addr ||
+        addr - segment->addr >= segment->memsz)
+      continue;
+
+    if (segment->flags & PF_X)
+      return SYM_CODE_L;
+    if (segment->flags & PF_W)
+      return (addr - segment->addr >= segment->filesz) ? SYM_BSS_L : SYM_INITD_L;
+    return SYM_RD_ONLY_DATA_L;
+  }
+
+  // Like a symbol whose section doesn't exist.
+  return SYM_ABSOLUTE_L;
+}
+
+void nm_sections_destroy(nm_sections_t* sections) {
+  free(sections->entries);
+  free(sections->segments);
+  *sections = (nm_sections_t){};
+}
@@ -1,21 +1,47 @@
 #include <nm/nm.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define leftchild(r) (2 * (r) + 1)
 #define rightchild(r) (2 * (r) + 2)
 #define parent(r) ((r) - 1 / 2)
 
-static int compare(const nm_symbol_t* arr, const size_t a, const size_t b, const cmp_fn cmp) {
-  return cmp(&arr[a], &arr[b]);
+static int compare(const nm_key_t* arr,
+                   const size_t a,
+                   const size_t b,
+                   const cmp_fn cmp,
+                   const void* ctx) {
+  return cmp(&arr[a], &arr[b], ctx);
 }
 
-static void swap(nm_symbol_t* arr, const size_t a, const size_t b) {
+static void swap(nm_key_t* arr, const size_t a, const size_t b) {
   const auto tmp = arr[a];
   arr[a] = arr[b];
   arr[b] = tmp;
 }
 
-void heapsort(nm_symbol_t* arr, const size_t n, const cmp_fn cmp) {
+// Sift `root` down a heap of `end` elements. With `dir` set to 1 the heap is a max-heap,
+// with -1 a min-heap.
+static void sift_down(nm_key_t* arr,
+                      size_t root,
+                      const size_t end,
+                      const int dir,
+                      const cmp_fn cmp,
+                      const void* ctx) {
+  while (leftchild(root) < end) {
+    auto child = leftchild(root);
+    if (child + 1 < end && dir * compare(arr, child, child + 1, cmp, ctx) < 0)
+      child++;
+    if (dir * compare(arr, root, child, cmp, ctx) < 0) {
+      swap(arr, root, child);
+      root = child;
+    } else
+      break;
+  }
+}
+
+void heapsort(nm_key_t* arr, const size_t n, const cmp_fn cmp, const void* ctx) {
   auto start = n / 2;
   auto end = n;
 
@@ -27,16 +53,73 @@ void heapsort(nm_symbol_t* arr, const size_t n, const cmp_fn cmp) {
       swap(arr, end, 0);
     }
 
-    auto root = start;
-    while (leftchild(root) < end) {
-      auto child = leftchild(root);
-      if (child + 1 < end && compare(arr, child, child + 1, cmp) < 0)
-        child++;
-      if (compare(arr, root, child, cmp) < 0) {
-        swap(arr, root, child);
-        root = child;
-      } else
-        break;
+    sift_down(arr, start, end, 1, cmp, ctx);
+  }
+}
+
+void heap_build(nm_key_t* arr, const size_t n, const cmp_fn cmp, const void* ctx) {
+  for (auto start = n / 2; start > 0; start--)
+    sift_down(arr, start - 1, n, -1, cmp, ctx);
+}
+
+nm_key_t heap_pop(nm_key_t* arr, size_t* n, const cmp_fn cmp, const void* ctx) {
+  const auto top = arr[0];
+
+  arr[0] = arr[--*n];
+  sift_down(arr, 0, *n, -1, cmp, ctx);
+
+  return top;
+}
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (sizeof(u64) * 8 / RADIX_BITS)
+
+#define digit(v, pass) (((v) >> ((pass) * RADIX_BITS)) & (RADIX_BUCKETS - 1))
+
+bool radixsort(nm_rkey_t* arr, const size_t n) {
+  if (n < 2)
+    return true;
+
+  nm_rkey_t* tmp = malloc(n * sizeof(nm_rkey_t));
+  if (!tmp)
+    return false;
+
+  // All the histograms are computed in a single pass over the keys.
+  size_t hist[RADIX_PASSES][RADIX_BUCKETS] = {};
+  for (size_t i = 0; i < n; i++) {
+    for (size_t pass = 0; pass < RADIX_PASSES; pass++)
+      hist[pass][digit(arr[i].value, pass)]++;
+  }
+
+  auto src = arr;
+  auto dst = tmp;
+  for (size_t pass = 0; pass < RADIX_PASSES; pass++) {
+    const auto counts = hist[pass];
+
+    // Every key shares this digit, the pass wouldn't move anything. This skips most of
+    // the high bytes of addresses and sizes.
+    if (counts[digit(arr[0].value, pass)] == n)
+      continue;
+
+    size_t offset = 0;
+    for (size_t b = 0; b < RADIX_BUCKETS; b++) {
+      const auto c = counts[b];
+      counts[b] = offset;
+      offset += c;
     }
+
+    for (size_t i = 0; i < n; i++)
+      dst[counts[digit(src[i].value, pass)]++] = src[i];
+
+    const auto t = src;
+    src = dst;
+    dst = t;
   }
-}
\ No newline at end of file
+
+  if (src != arr)
+    memcpy(arr, src, n * sizeof(nm_rkey_t));
+  free(tmp);
+
+  return true;
+}
@@ -0,0 +1,70 @@
+#include <nm/stats.h>
+
+#ifdef NM_STATS
+
+#include <nm/out.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+thread_local nm_stats_t g_nm_stats = {};
+
+uint64_t nm_stats_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void put_field(nm_out_t* out, const char* key, uint64_t v) {
+  char buffer[24];
+  char* p = buffer + sizeof(buffer);
+
+  do {
+    *--p = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+
+  nm_out_putc(out, ' ');
+  nm_out_puts(out, key);
+  nm_out_putc(out, '=');
+  nm_out_write(out, p, (size_t)(buffer + sizeof(buffer) - p));
+}
+
+void nm_stats_report(const char* file) {
+  static const char* phases[NM_PHASE_COUNT] = {
+      [NM_PHASE_OPEN] = "open_us",
+      [NM_PHASE_SYMTAB] = "symtab_us",
+      [NM_PHASE_SORT] = "sort_us",
+      [NM_PHASE_DISPLAY] = "display_us",
+  };
+  static nm_out_t out = {.fd = STDERR_FILENO};
+  const auto s = &g_nm_stats;
+
+  nm_out_puts(&out, "nm: stats: ");
+  nm_out_puts(&out, file);
+  nm_out_putc(&out, ':');
+  for (size_t i = 0; i < NM_PHASE_COUNT; i++)
+    put_field(&out, phases[i], s->phase_ns[i] / 1000);
+  put_field(&out, "get_section", s->get_section);
+  put_field(&out, "strptr", s->strptr);
+  put_field(&out, "compares", s->compares);
+  put_field(&out, "written", s->written);
+
+  // Process wide, in KiB on Linux. The page faults are the ones since the last report.
+  static uint64_t minflt = 0;
+  static uint64_t majflt = 0;
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    put_field(&out, "peak_rss_kb", (uint64_t)usage.ru_maxrss);
+    put_field(&out, "minflt", (uint64_t)usage.ru_minflt - minflt);
+    put_field(&out, "majflt", (uint64_t)usage.ru_majflt - majflt);
+    minflt = (uint64_t)usage.ru_minflt;
+    majflt = (uint64_t)usage.ru_majflt;
+  }
+  nm_out_putc(&out, '\n');
+  nm_out_flush(&out);
+
+  *s = (nm_stats_t){};
+}
+
+#endif
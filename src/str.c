@@ -0,0 +1,163 @@
+#include <nm/nm.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STR_VEC_WIDTH 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define STR_VEC_WIDTH 16
+#endif
+
+// Strings handed to the comparator live in the mmapped string tables, we must never
+// let a vector load cross into a page we don't know is mapped.
+#define STR_PAGE_SIZE 4096
+
+#define page_safe(p, n) \
+  ((((uintptr_t)(p)) & (STR_PAGE_SIZE - 1)) <= (uintptr_t)(STR_PAGE_SIZE - (n)))
+
+u64 nm_strprefix(const char* s) {
+  u64 prefix = 0;
+  size_t i = 0;
+
+  for (; i < sizeof(u64) && s[i]; i++)
+    prefix = (prefix << 8) | (u8)s[i];
+  for (; i < sizeof(u64); i++)
+    prefix <<= 8;
+
+  return prefix;
+}
+
+u32 nm_strhash(const char* s, u32* len) {
+  // FNV-1a
+  u32 h = 2166136261u;
+  u32 i = 0;
+
+  for (; s[i]; i++)
+    h = (h ^ (u8)s[i]) * 16777619u;
+
+  *len = i;
+  return h;
+}
+
+#ifdef STR_VEC_WIDTH
+
+static u32 vec_mismatch(const char* a, const char* b) {
+#if STR_VEC_WIDTH == 32
+  const auto va = _mm256_loadu_si256((const __m256i*)a);
+  const auto vb = _mm256_loadu_si256((const __m256i*)b);
+  const auto eq = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+  const auto nul = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, _mm256_setzero_si256()));
+  return ~eq | nul;
+#else
+  const auto va = _mm_loadu_si128((const __m128i*)a);
+  const auto vb = _mm_loadu_si128((const __m128i*)b);
+  const auto eq = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+  const auto nul = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(va, _mm_setzero_si128()));
+  return (~eq | nul) & 0xffff;
+#endif
+}
+
+// Positions of the vector at `s` where both the first and the last byte of the needle
+// match, `nul` gets the terminators of the first load.
+static u32 vec_candidates(const char* s, const char* needle, const size_t len, u32* nul) {
+#if STR_VEC_WIDTH == 32
+  const auto va = _mm256_loadu_si256((const __m256i*)s);
+  const auto vb = _mm256_loadu_si256((const __m256i*)(s + len - 1));
+  const auto first = _mm256_cmpeq_epi8(va, _mm256_set1_epi8(needle[0]));
+  const auto last = _mm256_cmpeq_epi8(vb, _mm256_set1_epi8(needle[len - 1]));
+  *nul = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, _mm256_setzero_si256()));
+  return (u32)_mm256_movemask_epi8(_mm256_and_si256(first, last));
+#else
+  const auto va = _mm_loadu_si128((const __m128i*)s);
+  const auto vb = _mm_loadu_si128((const __m128i*)(s + len - 1));
+  const auto first = _mm_cmpeq_epi8(va, _mm_set1_epi8(needle[0]));
+  const auto last = _mm_cmpeq_epi8(vb, _mm_set1_epi8(needle[len - 1]));
+  *nul = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(va, _mm_setzero_si128()));
+  return (u32)_mm_movemask_epi8(_mm_and_si128(first, last));
+#endif
+}
+
+#endif
+
+// Stops at the first mismatch, the terminator of `s` included.
+static bool str_match_at(const char* s, const char* needle, const size_t len) {
+  size_t i = 0;
+  while (i < len && s[i] == needle[i])
+    i++;
+  return i == len;
+}
+
+__attribute__((no_sanitize_address)) bool nm_strfind(const char* s,
+                                                     const char* needle,
+                                                     const size_t len) {
+  if (!len)
+    return true;
+
+  for (;;) {
+#ifdef STR_VEC_WIDTH
+    // Both loads must stay in the page of `s`, the one holding the needle's last byte
+    // may start past the terminator.
+    if (len < STR_PAGE_SIZE - STR_VEC_WIDTH && page_safe(s, STR_VEC_WIDTH + len - 1)) {
+      u32 nul;
+      auto mask = vec_candidates(s, needle, len, &nul);
+      // Only the positions before the terminator are part of the string.
+      if (nul)
+        mask &= (nul & -nul) - 1;
+
+      for (; mask; mask &= mask - 1) {
+        if (str_match_at(s + __builtin_ctz(mask), needle, len))
+          return true;
+      }
+      if (nul)
+        return false;
+
+      s += STR_VEC_WIDTH;
+      continue;
+    }
+
+    for (size_t i = 0; i < STR_VEC_WIDTH; i++, s++) {
+      if (!*s)
+        return false;
+      if (str_match_at(s, needle, len))
+        return true;
+    }
+#else
+    if (!*s)
+      return false;
+    if (str_match_at(s, needle, len))
+      return true;
+    s++;
+#endif
+  }
+}
+
+// The vector loads may read past the terminator (never past the page), which the
+// address sanitizer would rightfully flag on string literals.
+__attribute__((no_sanitize_address)) int nm_strcmp(const char* a, const char* b) {
+  for (;;) {
+#ifdef STR_VEC_WIDTH
+    if (page_safe(a, STR_VEC_WIDTH) && page_safe(b, STR_VEC_WIDTH)) {
+      const auto mask = vec_mismatch(a, b);
+      if (mask) {
+        const auto i = __builtin_ctz(mask);
+        return (int)(u8)a[i] - (int)(u8)b[i];
+      }
+
+      a += STR_VEC_WIDTH;
+      b += STR_VEC_WIDTH;
+      continue;
+    }
+
+    // Close to a page boundary, step byte by byte until both pointers are clear of it.
+    for (size_t i = 0; i < STR_VEC_WIDTH; i++, a++, b++) {
+      if (*a != *b || !*a)
+        return (int)(u8)*a - (int)(u8)*b;
+    }
+#else
+    if (*a != *b || !*a)
+      return (int)(u8)*a - (int)(u8)*b;
+    a++;
+    b++;
+#endif
+  }
+}
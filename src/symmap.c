@@ -0,0 +1,214 @@
+#include <nm/nm.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Global name table shared by the resolution workers. The table is split into shards
+// selected by the high bits of the name hash, each with its own lock, so that workers
+// inserting different names rarely contend. Names are copied into per shard arenas: the
+// memory used is proportional to the number of unique names, not to the objects.
+
+#define SYMMAP_SHARD_BITS 6
+#define SYMMAP_SHARDS (1 << SYMMAP_SHARD_BITS)
+#define SYMMAP_MIN_SLOTS 256
+#define SYMMAP_ARENA_BLOCK (64 * 1024)
+
+typedef struct _symmap_block_t {
+  struct _symmap_block_t* next;
+  size_t used;
+  size_t size;
+  char data[];
+} symmap_block_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+
+  u32* slots;  // `index + 1` into entries, zero means empty
+  nm_symmap_entry_t* entries;
+  u32* hashes;
+  size_t count;
+  size_t cap;
+
+  symmap_block_t* arena;
+} symmap_shard_t;
+
+typedef struct _nm_symmap_t {
+  symmap_shard_t shards[SYMMAP_SHARDS];
+} nm_symmap_t;
+
+nm_symmap_t* nm_symmap_new() {
+  nm_symmap_t* map = calloc(1, sizeof(nm_symmap_t));
+  if (!map)
+    return nullptr;
+
+  for (size_t i = 0; i < SYMMAP_SHARDS; i++)
+    pthread_mutex_init(&map->shards[i].lock, nullptr);
+
+  return map;
+}
+
+static const char* symmap_copy_name(symmap_shard_t* shard, const char* name, const u32 len) {
+  auto block = shard->arena;
+
+  if (!block || block->size - block->used < len + 1) {
+    const size_t size = (len + 1 > SYMMAP_ARENA_BLOCK) ? len + 1 : SYMMAP_ARENA_BLOCK;
+    if ((block = malloc(sizeof(symmap_block_t) + size)) == nullptr)
+      return nullptr;
+
+    *block = (symmap_block_t){.next = shard->arena, .size = size};
+    shard->arena = block;
+  }
+
+  char* copy = block->data + block->used;
+  memcpy(copy, name, len + 1);
+  block->used += len + 1;
+
+  return copy;
+}
+
+static bool symmap_grow(symmap_shard_t* shard) {
+  const auto cap = shard->cap ? shard->cap * 2 : SYMMAP_MIN_SLOTS;
+
+  u32* slots = calloc(cap, sizeof(u32));
+  nm_symmap_entry_t* entries = realloc(shard->entries, (cap / 2) * sizeof(nm_symmap_entry_t));
+  if (entries)
+    shard->entries = entries;
+  u32* hashes = realloc(shard->hashes, (cap / 2) * sizeof(u32));
+  if (hashes)
+    shard->hashes = hashes;
+
+  if (!slots || !entries || !hashes) {
+    free(slots);
+    return false;
+  }
+
+  for (size_t i = 0; i < shard->count; i++) {
+    auto slot = hashes[i] & (cap - 1);
+    while (slots[slot])
+      slot = (slot + 1) & (cap - 1);
+    slots[slot] = i + 1;
+  }
+
+  free(shard->slots);
+  shard->slots = slots;
+  shard->cap = cap;
+
+  return true;
+}
+
+static nm_symmap_entry_t* symmap_find_or_insert(symmap_shard_t* shard,
+                                                const char* name,
+                                                const u32 hash,
+                                                const u32 len) {
+  if (shard->count >= shard->cap / 2 && !symmap_grow(shard))
+    return nullptr;
+
+  auto slot = hash & (shard->cap - 1);
+  while (shard->slots[slot]) {
+    const auto i = shard->slots[slot] - 1;
+    const auto e = &shard->entries[i];
+    if (shard->hashes[i] == hash && e->len == len && memcmp(e->name, name, len) == 0)
+      return e;
+    slot = (slot + 1) & (shard->cap - 1);
+  }
+
+  const auto copy = symmap_copy_name(shard, name, len);
+  if (!copy)
+    return nullptr;
+
+  const auto i = shard->count++;
+  shard->slots[slot] = i + 1;
+  shard->hashes[i] = hash;
+  shard->entries[i] = (nm_symmap_entry_t){
+      .name = copy,
+      .len = len,
+      .first_ref = UINT32_MAX,
+  };
+
+  return &shard->entries[i];
+}
+
+bool nm_symmap_add(nm_symmap_t* map,
+                   const char* name,
+                   const u32 file,
+                   const nm_symmap_kind_t kind) {
+  u32 len;
+  const auto hash = nm_strhash(name, &len);
+  const auto shard = &map->shards[hash >> (32 - SYMMAP_SHARD_BITS)];
+
+  bool ret = false;
+  pthread_mutex_lock(&shard->lock);
+
+  const auto e = symmap_find_or_insert(shard, name, hash, len);
+  if (!e)
+    goto done;
+
+  switch (kind) {
+    case NM_SYMMAP_REF:
+      e->nrefs++;
+      if (file < e->first_ref)
+        e->first_ref = file;
+      break;
+    case NM_SYMMAP_WEAK_DEF:
+      e->nweak++;
+      break;
+    case NM_SYMMAP_DEF: {
+      u32* defs = realloc(e->defs, (e->ndefs + 1) * sizeof(u32));
+      if (!defs)
+        goto done;
+      defs[e->ndefs++] = file;
+      e->defs = defs;
+      break;
+    }
+  }
+  ret = true;
+
+done:
+  pthread_mutex_unlock(&shard->lock);
+  return ret;
+}
+
+nm_symmap_entry_t** nm_symmap_entries(const nm_symmap_t* map, size_t* count) {
+  size_t n = 0;
+  for (size_t i = 0; i < SYMMAP_SHARDS; i++)
+    n += map->shards[i].count;
+
+  nm_symmap_entry_t** entries = malloc((n ? n : 1) * sizeof(nm_symmap_entry_t*));
+  if (!entries)
+    return nullptr;
+
+  n = 0;
+  for (size_t i = 0; i < SYMMAP_SHARDS; i++) {
+    const auto shard = &map->shards[i];
+    for (size_t j = 0; j < shard->count; j++)
+      entries[n++] = &shard->entries[j];
+  }
+
+  *count = n;
+  return entries;
+}
+
+void nm_symmap_destroy(nm_symmap_t** map) {
+  if (!map || !*map)
+    return;
+
+  for (size_t i = 0; i < SYMMAP_SHARDS; i++) {
+    const auto shard = &(*map)->shards[i];
+
+    for (size_t j = 0; j < shard->count; j++)
+      free(shard->entries[j].defs);
+    for (auto block = shard->arena; block;) {
+      const auto next = block->next;
+      free(block);
+      block = next;
+    }
+
+    free(shard->slots);
+    free(shard->entries);
+    free(shard->hashes);
+    pthread_mutex_destroy(&shard->lock);
+  }
+
+  free(*map);
+  *map = nullptr;
+}
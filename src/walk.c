@@ -0,0 +1,179 @@
+#include <dirent.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <nm/walk.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// A directory is read with getdents64 in batches of NM_WALK_BUFFER_SIZE bytes, the type
+// of each entry comes with it on most filesystems: only the regular files are opened, to
+// check their magic. The whole directory is read and sorted before walking into its
+// subdirectories, so a single descriptor is open at a time.
+
+#define NM_WALK_BUFFER_SIZE (32 * 1024)
+
+// The record of getdents64, not exposed by the libc headers without _GNU_SOURCE.
+typedef struct {
+  u64 d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+} walk_dirent_t;
+
+typedef struct {
+  char* path;
+  size_t name;  // Offset of the entry name in path
+  u8 type;      // DT_*
+} walk_entry_t;
+
+static int walk_cmp(const nm_key_t* a, const nm_key_t* b, const void* ctx) {
+  const walk_entry_t* entries = ctx;
+
+  if (a->prefix != b->prefix)
+    return (a->prefix < b->prefix) ? -1 : 1;
+  const auto ea = &entries[a->index];
+  const auto eb = &entries[b->index];
+  return strcmp(ea->path + ea->name, eb->path + eb->name);
+}
+
+static char* walk_join(const char* dir, const char* name, size_t* offset) {
+  auto len = strlen(dir);
+  while (len > 1 && dir[len - 1] == '/')
+    len--;
+  const auto sep = (dir[len - 1] != '/');
+  const auto name_len = strlen(name);
+
+  char* path = malloc(len + sep + name_len + 1);
+  if (!path)
+    return nullptr;
+  memcpy(path, dir, len);
+  if (sep)
+    path[len] = '/';
+  memcpy(path + len + sep, name, name_len + 1);
+  *offset = len + sep;
+  return path;
+}
+
+// Whether the file starts with the ELF magic.
+static bool walk_is_elf(const char* path) {
+  const auto fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK);
+  if (fd < 0)
+    return false;
+
+  u8 magic[SELFMAG];
+  const auto rd = pread(fd, magic, sizeof(magic), 0);
+  close(fd);
+  return rd == SELFMAG && memcmp(magic, ELFMAG, SELFMAG) == 0;
+}
+
+// Read the entries of the directory \a dir, but `.` and `..`.
+static bool walk_read(const char* dir, vector(walk_entry_t) * entries, int* err) {
+  const auto fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    *err = errno;
+    return false;
+  }
+
+  bool ok = true;
+  u8 buffer[NM_WALK_BUFFER_SIZE];
+  for (;;) {
+    const auto n = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      if (n < 0) {
+        *err = errno;
+        ok = false;
+      }
+      break;
+    }
+
+    for (long pos = 0; pos < n;) {
+      const walk_dirent_t* d = (const void*)(buffer + pos);
+      pos += d->d_reclen;
+
+      const auto name = d->d_name;
+      if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+        continue;
+
+      walk_entry_t e = {.type = d->d_type};
+      if ((e.path = walk_join(dir, name, &e.name)) == nullptr ||
+          !vector_push(*entries, e)) {
+        free(e.path);
+        *err = ENOMEM;
+        ok = false;
+        goto done;
+      }
+    }
+  }
+
+done:
+  close(fd);
+  return ok;
+}
+
+static bool walk_dir(const char* dir, vector(char*) * files, nm_walk_warn_fn warn) {
+  vector(walk_entry_t) entries = nullptr;
+  nm_key_t* keys = nullptr;
+  int err = 0;
+  bool ok = walk_read(dir, &entries, &err);
+  if (!ok)
+    warn(dir, err);
+
+  const auto count = vector_len(entries);
+  if (count && (keys = malloc(count * sizeof(nm_key_t))) == nullptr) {
+    warn(dir, ENOMEM);
+    ok = false;
+    goto done;
+  }
+  for (size_t i = 0; i < count; i++) {
+    const auto e = &entries[i];
+    keys[i] = (nm_key_t){.prefix = nm_strprefix(e->path + e->name), .index = (u32)i};
+  }
+  heapsort(keys, count, walk_cmp, entries);
+
+  for (size_t i = 0; i < count; i++) {
+    const auto e = &entries[keys[i].index];
+
+    // Some filesystems don't fill the type in.
+    if (e->type == DT_UNKNOWN) {
+      struct stat st;
+      if (lstat(e->path, &st) == 0)
+        e->type = S_ISDIR(st.st_mode)   ? DT_DIR
+                  : S_ISREG(st.st_mode) ? DT_REG
+                                        : DT_UNKNOWN;
+    }
+
+    if (e->type == DT_DIR)
+      ok &= walk_dir(e->path, files, warn);
+    else if (e->type == DT_REG && walk_is_elf(e->path)) {
+      if (!vector_push(*files, e->path)) {
+        warn(dir, ENOMEM);
+        ok = false;
+        goto done;
+      }
+      e->path = nullptr;
+    }
+  }
+
+done:
+  for (size_t i = 0; i < count; i++)
+    free(entries[i].path);
+  vector_destroy(entries);
+  free(keys);
+  return ok;
+}
+
+bool nm_walk(const char* dir, vector(char*) * files, nm_walk_warn_fn warn) {
+  return walk_dir(dir, files, warn);
+}
+
+void nm_walk_destroy(vector(char*) * files) {
+  for (size_t i = 0; i < vector_len(*files); i++)
+    free((*files)[i]);
+  vector_destroy(*files);
+  *files = nullptr;
+}